@@ -0,0 +1,276 @@
+#include "CuTest.h"
+#include "hcc.h"
+#include "hconfig.h"
+#include "clexer.h"
+#include "cparser.h"
+#include "ssc.h"
+#include "type.h"
+#include "symbol.h"
+#include "atom.h"
+#include "layout.h"
+#include "error.h"
+
+/*
+ * struct layout through the whole front end: source is written to a temporary file,
+ * parsed and checked, then the record types are looked up by tag before the symbol
+ * tables are freed.
+ */
+
+static char layout_source[L_tmpnam];
+
+static void layout_begin(CuTest *tc, const char* source)
+{
+    t_scanner_context sc;
+    char* include_path[1] = {"."};
+    FILE* f = NULL;
+
+    CuAssertPtrNotNull(tc, tmpnam(layout_source));
+    f = fopen(layout_source, "w");
+    CuAssertPtrNotNull(tc, f);
+    fputs(source, f);
+    fclose(f);
+
+    sc.filename = layout_source;
+    sc.include_pathes = include_path;
+    sc.number_of_include_pathes = 1;
+
+    initialize_clexer(&sc);
+    initialize_parser();
+    type_system_initialize();
+    static_semantic_check(translation_unit());
+}
+
+static void layout_end(void)
+{
+    free_clexer();
+    free_symbol_tables();
+    remove(layout_source);
+}
+
+static t_type* record_of(CuTest *tc, const char* tag)
+{
+    t_symbol* sym = find_symbol(atom_string(tag), sym_table_types);
+
+    CuAssertPtrNotNull(tc, sym);
+    return sym->type;
+}
+
+static int offset_of(CuTest *tc, const char* tag, const char* name)
+{
+    t_record_field* field = find_field(record_of(tc, tag), atom_string(name));
+
+    CuAssertPtrNotNull(tc, field);
+    return field->offset;
+}
+
+void testlayoutfields(CuTest *tc)
+{
+    layout_begin(tc,
+        "struct s { char c; int i; short h; double d; char t; };\n"
+        "union u { char c; double d; int a[3]; };\n"
+        "struct b { char c; int f : 3; int g : 30; unsigned : 0; char e; };\n");
+
+    CuAssertIntEquals(tc, 0, offset_of(tc, "s", "c"));
+    CuAssertIntEquals(tc, 4, offset_of(tc, "s", "i"));
+    CuAssertIntEquals(tc, 8, offset_of(tc, "s", "h"));
+    CuAssertIntEquals(tc, 16, offset_of(tc, "s", "d"));
+    CuAssertIntEquals(tc, 24, offset_of(tc, "s", "t"));
+    CuAssertIntEquals(tc, 32, record_of(tc, "s")->size);
+
+    CuAssertIntEquals(tc, 16, record_of(tc, "u")->size);
+    CuAssertIntEquals(tc, 0, offset_of(tc, "u", "a"));
+
+    CuAssertIntEquals(tc, 0, offset_of(tc, "b", "f"));
+    CuAssertIntEquals(tc, 4, offset_of(tc, "b", "g"));
+    CuAssertIntEquals(tc, 8, offset_of(tc, "b", "e"));
+    CuAssertIntEquals(tc, 12, record_of(tc, "b")->size);
+
+    layout_end();
+}
+
+void testlayoutarraysize(CuTest *tc)
+{
+    layout_begin(tc,
+        "#define N 32\n"
+        "enum { NEG = -1, A1 = 5, A2, A3 = A2 * 2 };\n"
+        "struct a { char c; int x[N*4]; short s; };\n"
+        "struct e { char x[A3]; char y[A2]; char z[NEG + 3]; };\n"
+        "struct c { char x[(N > 4) ? 2 : 3]; char y[-(-2)]; char z[N / 8 % 3 << 1]; char w; };\n");
+
+    CuAssertIntEquals(tc, 516, offset_of(tc, "a", "s"));
+    CuAssertIntEquals(tc, 520, record_of(tc, "a")->size);
+
+    CuAssertIntEquals(tc, 12, offset_of(tc, "e", "y"));
+    CuAssertIntEquals(tc, 18, offset_of(tc, "e", "z"));
+    CuAssertIntEquals(tc, 20, record_of(tc, "e")->size);
+
+    CuAssertIntEquals(tc, 2, offset_of(tc, "c", "y"));
+    CuAssertIntEquals(tc, 4, offset_of(tc, "c", "z"));
+    CuAssertIntEquals(tc, 6, offset_of(tc, "c", "w"));
+
+    layout_end();
+}
+
+void testlayoutunknownsize(CuTest *tc)
+{
+    FILE* report = tmpfile();
+    char text[4096];
+    size_t n = 0;
+
+    CuAssertPtrNotNull(tc, report);
+    g_layout_report_output = report;
+
+    /* casts are not folded by the checker; such records have unknown size and are not reported */
+    layout_begin(tc,
+        "enum { S = (int)4, T };\n"
+        "struct d { int v[(int)4]; char k; };\n"
+        "struct f { struct d d; char k; };\n"
+        "struct t { char v[T]; };\n"
+        "struct w { int b : (int)4; };\n"
+        "struct k { char k; };\n");
+
+    CuAssertIntEquals(tc, -1, record_of(tc, "d")->size);
+    CuAssertIntEquals(tc, -1, record_of(tc, "f")->size);
+    CuAssertIntEquals(tc, -1, record_of(tc, "t")->size);
+    CuAssertIntEquals(tc, -1, record_of(tc, "w")->size);
+    CuAssertIntEquals(tc, 1, record_of(tc, "k")->size);
+
+    layout_report_emit(layout_source);
+    g_layout_report_output = NULL;
+    layout_end();
+
+    rewind(report);
+    n = fread(text, 1, sizeof(text) - 1, report);
+    text[n] = '\0';
+    fclose(report);
+
+    CuAssertTrue(tc, strstr(text, "{\"name\":\"k\"") != NULL);
+    CuAssertTrue(tc, strstr(text, "{\"name\":\"d\"") == NULL);
+    CuAssertTrue(tc, strstr(text, "{\"name\":\"f\"") == NULL);
+    CuAssertTrue(tc, strstr(text, "{\"name\":\"t\"") == NULL);
+    CuAssertTrue(tc, strstr(text, "{\"name\":\"w\"") == NULL);
+}
+
+void testlayoutanonymousmember(CuTest *tc)
+{
+    t_record_field* field = NULL;
+
+    layout_begin(tc,
+        "struct b { char c; union { int i; double d; }; char t; struct { short p, q; }; int z; };\n"
+        "typedef struct { int x; } T;\n"
+        "struct n { char c; T; int m; };\n"
+        "struct big { int f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16;\n"
+        "    struct { char a; union { int deep; char e; }; }; int tail; };\n");
+
+    /* anonymous members are laid out like named ones */
+    field = record_of(tc, "b")->u.tag->fields->next;
+    CuAssertTrue(tc, IS_ANONYMOUS_MEMBER(field));
+    CuAssertIntEquals(tc, 8, field->offset);
+    CuAssertIntEquals(tc, 16, offset_of(tc, "b", "t"));
+    CuAssertIntEquals(tc, 18, field->next->next->offset);
+    CuAssertIntEquals(tc, 24, offset_of(tc, "b", "z"));
+    CuAssertIntEquals(tc, 32, record_of(tc, "b")->size);
+    CuAssertIntEquals(tc, 8, record_of(tc, "b")->align);
+
+    /* their fields are found through the enclosing record, at offsets inside the member */
+    CuAssertIntEquals(tc, 0, offset_of(tc, "b", "d"));
+    CuAssertIntEquals(tc, 2, offset_of(tc, "b", "q"));
+
+    /* a typedef name of an untagged struct declares no member */
+    CuAssertPtrEquals(tc, NULL, find_field(record_of(tc, "n"), atom_string("x")));
+    CuAssertIntEquals(tc, 8, record_of(tc, "n")->size);
+
+    /* large records index the fields of nested anonymous members */
+    CuAssertPtrNotNull(tc, record_of(tc, "big")->u.tag->field_index);
+    CuAssertIntEquals(tc, 0, offset_of(tc, "big", "deep"));
+    CuAssertIntEquals(tc, 76, offset_of(tc, "big", "tail"));
+    CuAssertPtrEquals(tc, NULL, find_field(record_of(tc, "big"), atom_string("nosuch")));
+
+    layout_end();
+}
+
+void testlayoutmanyfields(CuTest *tc)
+{
+    char source[2048];
+    char name[16];
+    char* p = source;
+    t_type* record = NULL;
+    int i = 0;
+
+    /* the index is grown as fields are added, an anonymous member counts its own fields */
+    p += sprintf(p, "struct many {");
+    for (i = 0; i < 40; i ++)
+    {
+        p += sprintf(p, " int f%d;", i);
+    }
+    p += sprintf(p, " struct { int g0, g1, g2; }; char last; };\n");
+
+    layout_begin(tc, source);
+
+    record = record_of(tc, "many");
+    CuAssertIntEquals(tc, 44, record->u.tag->field_count);
+    CuAssertTrue(tc, record->u.tag->field_index_size >= 88);
+
+    for (i = 0; i < 40; i ++)
+    {
+        sprintf(name, "f%d", i);
+        CuAssertIntEquals(tc, i * 4, offset_of(tc, "many", name));
+    }
+
+    CuAssertIntEquals(tc, 8, offset_of(tc, "many", "g2"));
+    CuAssertIntEquals(tc, 172, offset_of(tc, "many", "last"));
+    CuAssertPtrEquals(tc, NULL, find_field(record, atom_string("f40")));
+
+    layout_end();
+}
+
+void testlayoutsizeof(CuTest *tc)
+{
+    layout_begin(tc,
+        "struct r { char c; double d; };\n"
+        "enum { N = sizeof(int) * 2 };\n"
+        "struct s { char b[sizeof(long)]; char p[sizeof(char *)]; char q[sizeof(struct r)];\n"
+        "    char n[N]; int w : sizeof(short); };\n"
+        "struct u { struct incomplete* p; char x[sizeof(struct incomplete)]; };\n");
+
+    /* sizeof a type whose size is known is folded */
+    CuAssertIntEquals(tc, 4, offset_of(tc, "s", "p"));
+    CuAssertIntEquals(tc, 8, offset_of(tc, "s", "q"));
+    CuAssertIntEquals(tc, 24, offset_of(tc, "s", "n"));
+    CuAssertIntEquals(tc, 36, record_of(tc, "s")->size);
+    CuAssertIntEquals(tc, 2, find_field(record_of(tc, "s"), atom_string("w"))->bits);
+
+    CuAssertIntEquals(tc, -1, record_of(tc, "u")->size);
+
+    layout_end();
+}
+
+void testlayoutnotconstant(CuTest *tc)
+{
+    int errors = get_error_count();
+
+    /* names which are no enumerators make no constant */
+    layout_begin(tc,
+        "enum { A = undeclared };\n"
+        "enum e { B = A };\n"
+        "struct a { char x[undeclared]; int b : undeclared; char k; };\n"
+        "int v;\n"
+        "enum { C = v };\n");
+
+    CuAssertIntEquals(tc, errors + 9, get_error_count());
+
+    layout_end();
+}
+
+CuSuite* layouttestgetsuite()
+{
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testlayoutfields);
+    SUITE_ADD_TEST(suite, testlayoutarraysize);
+    SUITE_ADD_TEST(suite, testlayoutunknownsize);
+    SUITE_ADD_TEST(suite, testlayoutanonymousmember);
+    SUITE_ADD_TEST(suite, testlayoutmanyfields);
+    SUITE_ADD_TEST(suite, testlayoutsizeof);
+    SUITE_ADD_TEST(suite, testlayoutnotconstant);
+    return suite;
+}
@@ -0,0 +1,461 @@
+#include "CuTest.h"
+#include "hcc.h"
+#include "hconfig.h"
+#include "clexer.h"
+#include "error.h"
+
+/*
+ * diagnostics of the lexer: source is written to a temporary file and lexed, what the lexer
+ * reports goes to the error log, which is read back when the file is done.
+ */
+
+static char lexer_source[L_tmpnam];
+static char lexer_log[L_tmpnam];
+static char lexer_report[16384];
+
+static void lexer_begin(CuTest *tc, const char* source)
+{
+    t_scanner_context sc;
+    char* include_path[1] = {"."};
+    FILE* f = NULL;
+
+    CuAssertPtrNotNull(tc, tmpnam(lexer_source));
+    CuAssertPtrNotNull(tc, tmpnam(lexer_log));
+    f = fopen(lexer_source, "w");
+    CuAssertPtrNotNull(tc, f);
+    fputs(source, f);
+    fclose(f);
+
+    sc.filename = lexer_source;
+    sc.include_pathes = include_path;
+    sc.number_of_include_pathes = 1;
+
+    log_initialize(lexer_log);
+    initialize_clexer(&sc);
+}
+
+/*
+ * what was reported while the file was lexed
+ */
+static char* lexer_end(void)
+{
+    FILE* f = NULL;
+    size_t n = 0;
+
+    free_clexer();
+    log_terminate();
+
+    f = fopen(lexer_log, "rb");
+    if (f)
+    {
+        n = fread(lexer_report, 1, sizeof(lexer_report) - 1, f);
+        fclose(f);
+    }
+    lexer_report[n] = '\0';
+
+    remove(lexer_source);
+    remove(lexer_log);
+
+    return lexer_report;
+}
+
+/*
+ * tell whether the report has message at line of the source
+ */
+static int reported_at(char* report, const char* message, int line)
+{
+    char expected[L_tmpnam + 256];
+
+    sprintf(expected, "in file %s on line %d : %s", lexer_source, line, message);
+    return strstr(report, expected) != NULL;
+}
+
+void testlexerdiagnosticline(CuTest *tc)
+{
+    char* report = NULL;
+
+    lexer_begin(tc, "a\nb\nc = 09;\n");
+
+    /* the bad literal is scanned while peeking, the parser is still on line 1 */
+    CuAssertIntEquals(tc, TK_ID, get_token());
+    CuAssertIntEquals(tc, TK_CONST_INTEGER, peek_token_at(4));
+    CuAssertIntEquals(tc, 1, coord.line);
+
+    report = lexer_end();
+    CuAssertTrue(tc, reported_at(report, "illegal oct digit detected!", 3));
+}
+
+void testlexerprelexdiagnosticline(CuTest *tc)
+{
+    char* report = NULL;
+
+    /* nothing is consumed while the whole unit is scanned up front */
+    lexer_begin(tc, "int x = 09;\ndouble d =\n    1e999;\nint y = 0x1g;\n");
+    prelex_translation_unit();
+
+    report = lexer_end();
+    CuAssertTrue(tc, reported_at(report, "illegal oct digit detected!", 1));
+    CuAssertTrue(tc, reported_at(report, "float value out of range!", 3));
+    CuAssertTrue(tc, reported_at(report, "invalid integer constant suffix detected!", 4));
+}
+
+/*
+ * the report of the file lexed on the parser thread or through the pipeline, with the number
+ * of errors counted; the name of the source is left out
+ */
+static char* lexer_run(CuTest *tc, const char* source, int pipelined, int* errors)
+{
+    char* report = NULL;
+    char* name = NULL;
+    int before = 0;
+
+    g_pipeline_lexer = pipelined;
+    lexer_begin(tc, source);
+    before = get_error_count();
+
+    while (get_token() != TK_END)
+    {
+    }
+
+    *errors = get_error_count() - before;
+    report = lexer_end();
+    g_pipeline_lexer = 0;
+
+    while ((name = strstr(report, lexer_source)) != NULL)
+    {
+        memmove(name, name + strlen(lexer_source), strlen(name + strlen(lexer_source)) + 1);
+    }
+
+    return report;
+}
+
+void testlexerpipelinediagnostics(CuTest *tc)
+{
+    const char* source = "#define A 1\n#define A 2\nint x = 09;\ndouble d =\n    1e999;\nint y = 0x1g;\nint z = 99999999999999999999;\n";
+    char expected[4096];
+    int expected_errors = 0;
+    int errors = 0;
+
+    strcpy(expected, lexer_run(tc, source, 0, &expected_errors));
+    CuAssertIntEquals(tc, 3, expected_errors);
+    CuAssertTrue(tc, strstr(expected, "on line 7 : overflow detected for decimal integer!") != NULL);
+
+    /* the producer thread only records them, the parser thread reports them in the same order */
+    CuAssertStrEquals(tc, expected, lexer_run(tc, source, 1, &errors));
+    CuAssertIntEquals(tc, expected_errors, errors);
+}
+
+/*
+ * numeric literals, one per line: their kinds and values
+ */
+#define LEXER_LITERALS 2048
+
+static char lexer_literal_text[LEXER_LITERALS][80];
+static int lexer_kinds[LEXER_LITERALS];
+static t_lexeme_value lexer_values[LEXER_LITERALS];
+
+static char* lexer_literals(CuTest *tc, int count, int* errors)
+{
+    static char source[LEXER_LITERALS * 81];
+    char* p = source;
+    int before = 0;
+    int i = 0;
+
+    for (i = 0; i < count; i ++)
+    {
+        p += sprintf(p, "%s\n", lexer_literal_text[i]);
+    }
+
+    lexer_begin(tc, source);
+    before = get_error_count();
+    for (i = 0; i < count; i ++)
+    {
+        lexer_kinds[i] = get_token();
+        lexer_values[i] = *HCC_LEXEME(lexeme_handle);
+    }
+    CuAssertIntEquals(tc, TK_END, get_token());
+    *errors = get_error_count() - before;
+
+    return lexer_end();
+}
+
+typedef struct
+{
+    char* literal;
+    int kind;
+    unsigned long long value;
+    char* warning;
+} t_integer_literal;
+
+void testlexerintegerliterals(CuTest *tc)
+{
+    static const t_integer_literal integers[] =
+    {
+        {"0", TK_CONST_INTEGER, 0, NULL},
+        {"12345678", TK_CONST_INTEGER, 12345678ULL, NULL},
+        {"1234567890123456", TK_CONST_INTEGER, 1234567890123456ULL, NULL},
+        {"12345678901234567890", TK_CONST_INTEGER, 12345678901234567890ULL, NULL},
+        {"18446744073709551615", TK_CONST_INTEGER, 18446744073709551615ULL, NULL},
+        {"18446744073709551616", TK_CONST_INTEGER, 0, "overflow detected for decimal integer!"},
+        {"99999999999999999999", TK_CONST_INTEGER, 0, "overflow detected for decimal integer!"},
+        {"100000000000000000000000", TK_CONST_INTEGER, 0, "overflow detected for decimal integer!"},
+        {"0x0", TK_CONST_INTEGER, 0, NULL},
+        {"0x12345678", TK_CONST_INTEGER, 0x12345678ULL, NULL},
+        {"0x9aBcDeF0", TK_CONST_INTEGER, 0x9ABCDEF0ULL, NULL},
+        {"0X123456789abcdef0", TK_CONST_INTEGER, 0x123456789ABCDEF0ULL, NULL},
+        {"0xFFFFFFFFFFFFFFFF", TK_CONST_INTEGER, 0xFFFFFFFFFFFFFFFFULL, NULL},
+        {"0x00000000FFFFFFFFFFFFFFFF", TK_CONST_INTEGER, 0xFFFFFFFFFFFFFFFFULL, NULL},
+        {"0x10000000000000000", TK_CONST_INTEGER, 0, "overflow detected for hex integer!"},
+        {"0x1FFFFFFFFFFFFFFFF", TK_CONST_INTEGER, 0, "overflow detected for hex integer!"},
+        {"0x000000010000000000000000", TK_CONST_INTEGER, 0, "overflow detected for hex integer!"},
+        {"0x123456789", TK_CONST_INTEGER, 0x123456789ULL, NULL},
+        {"0777", TK_CONST_INTEGER, 0777ULL, NULL},
+        {"012345670123", TK_CONST_INTEGER, 012345670123ULL, NULL},
+        {"01777777777777777777777", TK_CONST_INTEGER, 01777777777777777777777ULL, NULL},
+        {"0001777777777777777777777", TK_CONST_INTEGER, 01777777777777777777777ULL, NULL},
+        {"02000000000000000000000", TK_CONST_INTEGER, 0, "overflow detected for oct integer!"}
+    };
+    int count = sizeof(integers) / sizeof(integers[0]);
+    char* report = NULL;
+    int errors = 0;
+    int i = 0;
+
+    for (i = 0; i < count; i ++)
+    {
+        strcpy(lexer_literal_text[i], integers[i].literal);
+    }
+    report = lexer_literals(tc, count, &errors);
+
+    CuAssertIntEquals(tc, 0, errors);
+    for (i = 0; i < count; i ++)
+    {
+        CuAssertIntEquals(tc, integers[i].kind, lexer_kinds[i]);
+        if (integers[i].warning)
+        {
+            CuAssertTrue(tc, reported_at(report, integers[i].warning, i + 1));
+        }
+        else
+        {
+            CuAssertTrue(tc, integers[i].value == lexer_values[i].integer_value);
+            CuAssertTrue(tc, !reported_at(report, "", i + 1));
+        }
+    }
+}
+
+void testlexerintegersuffix(CuTest *tc)
+{
+    static char* suffixes[] =
+    {
+        "", "u", "U", "l", "L", "ul", "uL", "Ul", "UL", "lu", "lU", "Lu", "LU",
+        "ll", "LL", "ull", "uLL", "Ull", "ULL", "llu", "llU", "LLu", "LLU",
+        "i64", "I64", "ui64", "Ui64", "i64u", "I64U"
+    };
+    static const int kinds[] =
+    {
+        TK_CONST_INTEGER, TK_CONST_UNSIGNED_INTEGER, TK_CONST_UNSIGNED_INTEGER,
+        TK_CONST_LONG_INTEGER, TK_CONST_LONG_INTEGER,
+        TK_CONST_UNSIGNED_LONG_INTEGER, TK_CONST_UNSIGNED_LONG_INTEGER,
+        TK_CONST_UNSIGNED_LONG_INTEGER, TK_CONST_UNSIGNED_LONG_INTEGER,
+        TK_CONST_UNSIGNED_LONG_INTEGER, TK_CONST_UNSIGNED_LONG_INTEGER,
+        TK_CONST_UNSIGNED_LONG_INTEGER, TK_CONST_UNSIGNED_LONG_INTEGER,
+        TK_CONST_LONG_LONG, TK_CONST_LONG_LONG,
+        TK_CONST_UNSIGNED_LONG_LONG, TK_CONST_UNSIGNED_LONG_LONG,
+        TK_CONST_UNSIGNED_LONG_LONG, TK_CONST_UNSIGNED_LONG_LONG,
+        TK_CONST_UNSIGNED_LONG_LONG, TK_CONST_UNSIGNED_LONG_LONG,
+        TK_CONST_UNSIGNED_LONG_LONG, TK_CONST_UNSIGNED_LONG_LONG,
+        TK_CONST_LONG_LONG, TK_CONST_LONG_LONG,
+        TK_CONST_UNSIGNED_LONG_LONG, TK_CONST_UNSIGNED_LONG_LONG,
+        TK_CONST_UNSIGNED_LONG_LONG, TK_CONST_UNSIGNED_LONG_LONG
+    };
+    static char* invalid[] =
+    {
+        "lL", "Ll", "lll", "LLL", "uu", "lul", "ulu", "llul", "llL", "i64l", "li64", "i6", "i32", "g", "x"
+    };
+    static char* numbers[] = {"42", "052", "0x2a", "0X2A"};
+    int valid_count = sizeof(suffixes) / sizeof(suffixes[0]);
+    int invalid_count = sizeof(invalid) / sizeof(invalid[0]);
+    char* report = NULL;
+    int errors = 0;
+    int count = 0;
+    int i = 0, j = 0;
+
+    for (j = 0; j < 4; j ++)
+    {
+        for (i = 0; i < valid_count; i ++)
+        {
+            sprintf(lexer_literal_text[count ++], "%s%s", numbers[j], suffixes[i]);
+        }
+    }
+    report = lexer_literals(tc, count, &errors);
+
+    CuAssertIntEquals(tc, 0, errors);
+    for (i = 0; i < count; i ++)
+    {
+        CuAssertIntEquals(tc, kinds[i % valid_count], lexer_kinds[i]);
+        CuAssertTrue(tc, 42 == lexer_values[i].integer_value);
+    }
+
+    count = 0;
+    for (j = 0; j < 4; j ++)
+    {
+        for (i = 0; i < invalid_count; i ++)
+        {
+            sprintf(lexer_literal_text[count ++], "%s%s", numbers[j], invalid[i]);
+        }
+    }
+    report = lexer_literals(tc, count, &errors);
+
+    CuAssertIntEquals(tc, count, errors);
+    for (i = 0; i < count; i ++)
+    {
+        CuAssertTrue(tc, reported_at(report, "invalid integer constant suffix detected!", i + 1));
+    }
+}
+
+/*
+ * the literals i .. count - 1 are doubles converted exactly as strtod does
+ */
+static void lexer_check_doubles(CuTest *tc, int i, int count)
+{
+    char message[128];
+
+    for (; i < count; i ++)
+    {
+        sprintf(message, "%s", lexer_literal_text[i]);
+        CuAssertIntEquals_Msg(tc, message, TK_CONST_DOUBLE, lexer_kinds[i]);
+        CuAssert(tc, message, (double)lexer_values[i].double_value == strtod(lexer_literal_text[i], NULL));
+    }
+}
+
+void testlexerfloatliterals(CuTest *tc)
+{
+    static char* doubles[] =
+    {
+        /* the exact powers of ten and the edges of the pow5.h table, then past them */
+        "0.0", "1.", ".5", "1e22", "1e23", "9007199254740992e22", "9007199254740993e22",
+        "1e64", "1e-64", "1.7e64", "1.7e-64", "18446744073709551615e64", "18446744073709551615e-64",
+        "9e64", "9e-64", "1e65", "1e-65", "123456789e-73", "123456789e56", "1e-66", "1e66",
+        "0.000000000000000000000000000000000000000000000000000000000000000001",
+        "1000000000000000000000000000000000000000000000000000000000000000000.0",
+        /* rounding to even and just away from it */
+        "9007199254740993e0", "9007199254740993.0", "9007199254740995e0", "9007199254740994.9999999",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203126",
+        /* the first product of the significand and 5^q is too short to round these */
+        "86965637951891628e45", "3693064457534673e-28", "3694636845605773499e36",
+        "2.2250738585072011e-308", "2.2250738585072014e-308", "1.7976931348623157e308",
+        "4.9406564584124654e-324", "123456789012345678901234567890.123456789e-20",
+        "0.1", "0.2", "0.3", "3.141592653589793238462643383279", "2.718281828459045235360287471352",
+        "1E10", "1e+10", "1e-10", "1.5E-5", "00012.5e001"
+    };
+    static char* floats[] = {"1.5f", "1.5F", "1e3f", "0.1f", "3.4028234664e38F", "1e-46f"};
+    static char* long_doubles[] = {"1.5l", "1.5L", "0.1L", ".5e-3L"};
+    int double_count = sizeof(doubles) / sizeof(doubles[0]);
+    int float_count = sizeof(floats) / sizeof(floats[0]);
+    int long_double_count = sizeof(long_doubles) / sizeof(long_doubles[0]);
+    char* report = NULL;
+    int errors = 0;
+    int count = 0;
+    int i = 0;
+
+    for (i = 0; i < double_count; i ++)
+    {
+        strcpy(lexer_literal_text[count ++], doubles[i]);
+    }
+    for (i = 0; i < float_count; i ++)
+    {
+        strcpy(lexer_literal_text[count ++], floats[i]);
+    }
+    for (i = 0; i < long_double_count; i ++)
+    {
+        strcpy(lexer_literal_text[count ++], long_doubles[i]);
+    }
+    strcpy(lexer_literal_text[count ++], "1e309");
+    strcpy(lexer_literal_text[count ++], "1e-400");
+    report = lexer_literals(tc, count, &errors);
+
+    CuAssertIntEquals(tc, 0, errors);
+    lexer_check_doubles(tc, 0, double_count);
+    for (i = double_count; i < double_count + float_count; i ++)
+    {
+        CuAssertIntEquals(tc, TK_CONST_FLOAT, lexer_kinds[i]);
+        CuAssertTrue(tc, lexer_values[i].float_value == (float)strtod(lexer_literal_text[i], NULL));
+    }
+    for (; i < count - 2; i ++)
+    {
+        CuAssertIntEquals(tc, TK_CONST_LONG_DOUBLE, lexer_kinds[i]);
+        CuAssertTrue(tc, (double)lexer_values[i].double_value == strtod(lexer_literal_text[i], NULL));
+    }
+    lexer_check_doubles(tc, count - 2, count);
+    CuAssertTrue(tc, reported_at(report, "float value out of range!", count - 1));
+    CuAssertTrue(tc, reported_at(report, "float value out of range!", count));
+
+    /* what is left after a float is no suffix */
+    count = 0;
+    strcpy(lexer_literal_text[count ++], "1.5ff");
+    strcpy(lexer_literal_text[count ++], "1.5fl");
+    strcpy(lexer_literal_text[count ++], "1.5lf");
+    strcpy(lexer_literal_text[count ++], "1.5LL");
+    strcpy(lexer_literal_text[count ++], "1.5u");
+    strcpy(lexer_literal_text[count ++], "1e5x");
+    report = lexer_literals(tc, count, &errors);
+
+    CuAssertIntEquals(tc, count, errors);
+    for (i = 0; i < count; i ++)
+    {
+        CuAssertTrue(tc, reported_at(report, "invalid float constant suffix detected!", i + 1));
+    }
+}
+
+void testlexerfloatroundtrip(CuTest *tc)
+{
+    unsigned long long state = 88172645463325252ULL;
+    unsigned long long bits = 0;
+    double value = 0;
+    int count = 0;
+    int errors = 0;
+
+#define LEXER_RANDOM() (state = state * 6364136223846793005ULL + 1442695040888963407ULL, state >> 11)
+
+    /* significands of up to twenty digits, exponents inside the table and beyond it */
+    while (count < LEXER_LITERALS / 2)
+    {
+        unsigned long long w = ((LEXER_RANDOM() << 11) ^ LEXER_RANDOM()) >> (LEXER_RANDOM() % 64);
+        int q = (int)(LEXER_RANDOM() % 181) - 90;
+
+        sprintf(lexer_literal_text[count ++], "%llue%d", w, q);
+    }
+
+    /* the shortest and the longer spellings of doubles over their whole range */
+    while (count < LEXER_LITERALS)
+    {
+        bits = (LEXER_RANDOM() << 11) ^ LEXER_RANDOM();
+        bits &= ~(1ULL << 63);
+        memcpy(&value, &bits, sizeof(value));
+        if ((bits >> 52) == 0x7FF)
+        {
+            continue;
+        }
+
+        sprintf(lexer_literal_text[count ++], "%.*e", (int)(LEXER_RANDOM() % 20), value);
+    }
+
+#undef LEXER_RANDOM
+
+    lexer_literals(tc, count, &errors);
+    CuAssertIntEquals(tc, 0, errors);
+    lexer_check_doubles(tc, 0, count);
+}
+
+CuSuite* lexertestgetsuite()
+{
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testlexerdiagnosticline);
+    SUITE_ADD_TEST(suite, testlexerprelexdiagnosticline);
+    SUITE_ADD_TEST(suite, testlexerpipelinediagnostics);
+    SUITE_ADD_TEST(suite, testlexerintegerliterals);
+    SUITE_ADD_TEST(suite, testlexerintegersuffix);
+    SUITE_ADD_TEST(suite, testlexerfloatliterals);
+    SUITE_ADD_TEST(suite, testlexerfloatroundtrip);
+    return suite;
+}
@@ -0,0 +1,211 @@
+#include "CuTest.h"
+#include "preprocessor/nhash.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * the hash tables of the preprocessor: open addressing with linear probing, where a deletion
+ * shifts the rest of the probe chain back into the hole
+ */
+
+#define NHASH_NAMES 64
+
+typedef struct {
+    hash_item_header head;
+    int deleted;
+} t_nhash_item;
+
+static t_nhash_item nhash_items[NHASH_NAMES];
+static char nhash_names[NHASH_NAMES][16];
+static int nhash_present[NHASH_NAMES];
+
+static void nhash_delete(void* item)
+{
+    ((t_nhash_item*)item)->deleted ++;
+}
+
+/*
+ * the slot where name is looked up first in a table of size slots
+ */
+static size_t nhash_home(char* name, size_t size)
+{
+    HTT probe;
+    t_nhash_item item;
+    size_t u, home = 0;
+
+    HTT_init(&probe, nhash_delete);
+    HTT_put(&probe, &item, name);
+    for (u = 0; u < probe.size; u ++)
+    {
+        if (probe.slot[u].item == &item.head)
+        {
+            home = probe.slot[u].hash & (size - 1);
+        }
+    }
+    HTT_kill(&probe);
+
+    return home;
+}
+
+/*
+ * the slot which holds the item n
+ */
+static int nhash_slot(HTT* htt, int n)
+{
+    size_t u;
+
+    for (u = 0; u < htt->size; u ++)
+    {
+        if (htt->slot[u].item == &nhash_items[n].head)
+        {
+            return (int)u;
+        }
+    }
+
+    return -1;
+}
+
+static void nhash_put(CuTest *tc, HTT* htt, int n)
+{
+    nhash_items[n].deleted = 0;
+    CuAssertPtrEquals(tc, NULL, HTT_put(htt, &nhash_items[n], nhash_names[n]));
+    nhash_present[n] = 1;
+}
+
+/*
+ * every name still in the table is found, and the deleted ones are gone
+ */
+static void nhash_check(CuTest *tc, HTT* htt, int names)
+{
+    int n;
+    size_t count = 0;
+
+    for (n = 0; n < names; n ++)
+    {
+        if (nhash_present[n])
+        {
+            CuAssertPtrEquals(tc, &nhash_items[n], HTT_get(htt, nhash_names[n]));
+            CuAssertIntEquals(tc, 0, nhash_items[n].deleted);
+            count ++;
+        }
+        else
+        {
+            CuAssertPtrEquals(tc, NULL, HTT_get(htt, nhash_names[n]));
+        }
+    }
+    CuAssertIntEquals(tc, (int)count, (int)htt->count);
+}
+
+static void nhash_del(CuTest *tc, HTT* htt, int n, int names)
+{
+    CuAssertIntEquals(tc, 1, HTT_del(htt, nhash_names[n]));
+    CuAssertIntEquals(tc, 1, nhash_items[n].deleted);
+    nhash_present[n] = 0;
+    CuAssertIntEquals(tc, 0, HTT_del(htt, nhash_names[n]));
+    nhash_check(tc, htt, names);
+}
+
+void testnhashdeletewrap(CuTest *tc)
+{
+    /* three names at home in the last slot, two in the one before, one each in 0 and 1 */
+    static const size_t homes[7] = {15, 15, 15, 14, 14, 0, 1};
+    static const int order[7] = {0, 5, 3, 2, 6, 1, 4};
+    HTT htt;
+    int n = 0, i = 0;
+
+    memset(nhash_present, 0, sizeof(nhash_present));
+    for (n = 0; n < 7; n ++)
+    {
+        do
+        {
+            sprintf(nhash_names[n], "n%d", i ++);
+        } while (nhash_home(nhash_names[n], 16) != homes[n]);
+    }
+
+    HTT_init(&htt, nhash_delete);
+    for (n = 0; n < 7; n ++)
+    {
+        nhash_put(tc, &htt, n);
+    }
+    CuAssertPtrEquals(tc, &nhash_items[0], HTT_put(&htt, &nhash_items[7], nhash_names[0]));
+
+    /* the chain of slot 14 wraps past the end: 14, 15, 0 .. 4 */
+    CuAssertIntEquals(tc, 16, (int)htt.size);
+    CuAssertIntEquals(tc, 15, nhash_slot(&htt, 0));
+    CuAssertIntEquals(tc, 0, nhash_slot(&htt, 1));
+    CuAssertIntEquals(tc, 1, nhash_slot(&htt, 2));
+    CuAssertIntEquals(tc, 14, nhash_slot(&htt, 3));
+    CuAssertIntEquals(tc, 2, nhash_slot(&htt, 4));
+    CuAssertIntEquals(tc, 3, nhash_slot(&htt, 5));
+    CuAssertIntEquals(tc, 4, nhash_slot(&htt, 6));
+    nhash_check(tc, &htt, 7);
+
+    /* the first goes from the middle of the chain, the items behind it move back across the end */
+    nhash_del(tc, &htt, order[0], 7);
+    CuAssertIntEquals(tc, 15, nhash_slot(&htt, 1));
+    CuAssertIntEquals(tc, 0, nhash_slot(&htt, 2));
+    CuAssertIntEquals(tc, 1, nhash_slot(&htt, 4));
+    CuAssertIntEquals(tc, 2, nhash_slot(&htt, 5));
+    CuAssertIntEquals(tc, 3, nhash_slot(&htt, 6));
+
+    for (n = 1; n < 7; n ++)
+    {
+        nhash_del(tc, &htt, order[n], 7);
+    }
+    CuAssertIntEquals(tc, 0, (int)htt.count);
+
+    /* an item at home in slot 0 stays there when the hole is in the last slot */
+    nhash_put(tc, &htt, 0);
+    nhash_put(tc, &htt, 5);
+    nhash_put(tc, &htt, 6);
+    CuAssertIntEquals(tc, 15, nhash_slot(&htt, 0));
+    CuAssertIntEquals(tc, 0, nhash_slot(&htt, 5));
+    CuAssertIntEquals(tc, 1, nhash_slot(&htt, 6));
+    nhash_del(tc, &htt, 0, 7);
+    CuAssertIntEquals(tc, 0, nhash_slot(&htt, 5));
+    CuAssertIntEquals(tc, 1, nhash_slot(&htt, 6));
+
+    HTT_kill(&htt);
+}
+
+void testnhashdeleteresize(CuTest *tc)
+{
+    HTT htt;
+    int n = 0;
+
+    memset(nhash_present, 0, sizeof(nhash_present));
+    HTT_init(&htt, nhash_delete);
+    for (n = 0; n < NHASH_NAMES; n ++)
+    {
+        sprintf(nhash_names[n], "name%d", n);
+        nhash_put(tc, &htt, n);
+    }
+
+    /* kept at most half full */
+    CuAssertIntEquals(tc, 2 * NHASH_NAMES, (int)htt.size);
+    nhash_check(tc, &htt, NHASH_NAMES);
+
+    for (n = 0; n < NHASH_NAMES; n += 3)
+    {
+        nhash_del(tc, &htt, n, NHASH_NAMES);
+    }
+    for (n = 0; n < NHASH_NAMES; n += 3)
+    {
+        nhash_put(tc, &htt, n);
+    }
+    nhash_check(tc, &htt, NHASH_NAMES);
+
+    HTT_kill(&htt);
+    for (n = 0; n < NHASH_NAMES; n ++)
+    {
+        CuAssertIntEquals(tc, 1, nhash_items[n].deleted);
+    }
+}
+
+CuSuite* nhashtestgetsuite()
+{
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testnhashdeletewrap);
+    SUITE_ADD_TEST(suite, testnhashdeleteresize);
+    return suite;
+}
@@ -0,0 +1,650 @@
+#include "CuTest.h"
+#include "hcc.h"
+#include "hconfig.h"
+#include "clexer.h"
+#include "error.h"
+#include "preprocessor/cpp.h"
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#endif
+
+/*
+ * the preprocessor through the lexer: files are written to a temporary directory, each
+ * translation unit is lexed and its tokens spelled out, separated by spaces. translation
+ * units of a test run one after another, as they do in a session of the driver.
+ */
+
+static char* token_spellings[] = {
+#define TK(a, b) b,
+#include "tokendef.h"
+#undef TK
+};
+
+static char pp_dir[L_tmpnam];
+static char pp_path[L_tmpnam + 64];
+static char pp_output[4096];
+
+static void pp_begin(CuTest *tc)
+{
+    CuAssertPtrNotNull(tc, tmpnam(pp_dir));
+    CuAssertIntEquals(tc, 0, mkdir(pp_dir, 0777));
+}
+
+static char* pp_file(const char* name)
+{
+    sprintf(pp_path, "%s/%s", pp_dir, name);
+    return pp_path;
+}
+
+static void pp_write(CuTest *tc, const char* name, const char* text)
+{
+    FILE* f = fopen(pp_file(name), "w");
+
+    CuAssertPtrNotNull(tc, f);
+    fputs(text, f);
+    fclose(f);
+}
+
+static void pp_remove(const char* name)
+{
+    remove(pp_file(name));
+}
+
+/*
+ * tokens of the translation unit name, include_pathes are relative to the directory
+ */
+static char* pp_run(const char* name, char** include_pathes, int count)
+{
+    t_scanner_context sc;
+    char* pathes[4];
+    char main_file[L_tmpnam + 64];
+    char* p = pp_output;
+    int token = TK_NULL;
+    int i = 0;
+
+    for (i = 0; i < count; i ++)
+    {
+        pathes[i] = (char*)malloc(strlen(pp_dir) + strlen(include_pathes[i]) + 2);
+        sprintf(pathes[i], "%s/%s", pp_dir, include_pathes[i]);
+    }
+
+    strcpy(main_file, pp_file(name));
+    sc.filename = main_file;
+    sc.include_pathes = pathes;
+    sc.number_of_include_pathes = count;
+
+    initialize_clexer(&sc);
+    *p = '\0';
+
+    while ((token = get_token()) != TK_END)
+    {
+        t_lexeme_value* value = HCC_LEXEME(lexeme_handle);
+
+        if (p != pp_output)
+        {
+            *p ++ = ' ';
+        }
+
+        if (token >= TK_CONST_INTEGER && token <= TK_CONST_UNSIGNED_LONG_LONG)
+        {
+            p += sprintf(p, "%llu", value->integer_value);
+        }
+        else if (token == TK_ID || token == TK_CONST_STRING_LITERAL || token == TK_CONST_CHAR_LITERAL ||
+            (token >= TK_COMMA && token <= TK_ELLIPSE))
+        {
+            p += sprintf(p, "%s", value->string_value);
+        }
+        else
+        {
+            p += sprintf(p, "%s", token_spellings[token]);
+        }
+    }
+
+    free_clexer();
+
+    for (i = 0; i < count; i ++)
+    {
+        free(pathes[i]);
+    }
+
+    return pp_output;
+}
+
+static void pp_end(void)
+{
+    finalize_clexer();
+    remove(pp_dir);
+}
+
+void testppincludecache(CuTest *tc)
+{
+    char* include_pathes[2] = {"d1", "d2"};
+
+    pp_begin(tc);
+    CuAssertIntEquals(tc, 0, mkdir(pp_file("d1"), 0777));
+    CuAssertIntEquals(tc, 0, mkdir(pp_file("d2"), 0777));
+    pp_write(tc, "d2/h.h", "#define V 2\n");
+    pp_write(tc, "m.c", "#include \"h.h\"\nx = V;\n");
+
+    CuAssertStrEquals(tc, "x = 2 ;", pp_run("m.c", include_pathes, 2));
+
+    /* the failed lookup in d1 is forgotten once d1 changes, even within the same second */
+    pp_write(tc, "d1/h.h", "#define V 1\n");
+    CuAssertStrEquals(tc, "x = 1 ;", pp_run("m.c", include_pathes, 2));
+
+    pp_remove("d1/h.h");
+    CuAssertStrEquals(tc, "x = 2 ;", pp_run("m.c", include_pathes, 2));
+
+    pp_remove("d2/h.h");
+    pp_remove("m.c");
+    pp_remove("d1");
+    pp_remove("d2");
+    pp_end();
+}
+
+void testppknownfile(CuTest *tc)
+{
+    char* include_pathes[1] = {"."};
+
+    pp_begin(tc);
+    pp_write(tc, "h.h", "#ifndef G\n#define G\n#define V 1\n#endif\n");
+    pp_write(tc, "m.c", "#include \"h.h\"\nx = V;\n");
+    pp_write(tc, "n.c", "#define G\n#include \"h.h\"\nx = V;\n");
+
+    CuAssertStrEquals(tc, "x = 1 ;", pp_run("m.c", include_pathes, 1));
+
+    /* rewritten with the same size, likely within the same second: its old guardian no longer applies */
+    pp_write(tc, "h.h", "#ifndef H\n#define H\n#define V 2\n#endif\n");
+    CuAssertStrEquals(tc, "x = 2 ;", pp_run("n.c", include_pathes, 1));
+
+    pp_remove("h.h");
+    pp_remove("m.c");
+    pp_remove("n.c");
+    pp_end();
+}
+
+static unsigned char pp_image[8192];
+
+static long pp_read_image(CuTest *tc, const char* name)
+{
+    FILE* f = fopen(pp_file(name), "rb");
+    long size = 0;
+
+    CuAssertPtrNotNull(tc, f);
+    size = (long)fread(pp_image, 1, sizeof(pp_image), f);
+    fclose(f);
+    CuAssertTrue(tc, size > 0 && size < (long)sizeof(pp_image));
+
+    return size;
+}
+
+static void pp_write_image(CuTest *tc, const char* name, long size)
+{
+    FILE* f = fopen(pp_file(name), "wb");
+
+    CuAssertPtrNotNull(tc, f);
+    fwrite(pp_image, 1, size, f);
+    fclose(f);
+}
+
+/*
+ * offset of the bytes in the image, -1 if they are not there
+ */
+static long pp_find(long size, const unsigned char* bytes, long length)
+{
+    long i = 0;
+
+    for (i = 0; i + length <= size; i ++)
+    {
+        if (!memcmp(pp_image + i, bytes, length))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void testppprefixstale(CuTest *tc)
+{
+    char* include_pathes[1] = {"."};
+    char prefix[L_tmpnam + 64];
+
+    pp_begin(tc);
+    pp_write(tc, "p.h", "#define V 1\n");
+    pp_write(tc, "pre.h", "#include \"p.h\"\n");
+    pp_write(tc, "m.c", "x = V;\n");
+    strcpy(prefix, pp_file("pre.h"));
+    g_prefix_header = prefix;
+
+    CuAssertStrEquals(tc, "x = 1 ;", pp_run("m.c", include_pathes, 1));
+    CuAssertStrEquals(tc, "x = 1 ;", pp_run("m.c", include_pathes, 1));
+
+    /* same size, likely the same second: the image is out of date all the same */
+    pp_write(tc, "p.h", "#define V 2\n");
+    CuAssertStrEquals(tc, "x = 2 ;", pp_run("m.c", include_pathes, 1));
+
+    g_prefix_header = NULL;
+    pp_remove("pre.h.hph");
+    pp_remove("pre.h");
+    pp_remove("p.h");
+    pp_remove("m.c");
+    pp_end();
+}
+
+void testppprefixcorrupt(CuTest *tc)
+{
+    /* record of F in the macro table: name, narg (one argument + 1), vaarg, length of its value */
+    static const unsigned char record[] = {2, 0, 0, 0, 'F', 0, 2, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0};
+    char* include_pathes[1] = {"."};
+    char prefix[L_tmpnam + 64];
+    long size = 0;
+    long cut = 0;
+    long at = 0;
+
+    pp_begin(tc);
+    pp_write(tc, "pre.h", "#define F(a) a\n#define G 7\n");
+    pp_write(tc, "m.c", "x = F(G);\n");
+    strcpy(prefix, pp_file("pre.h"));
+    g_prefix_header = prefix;
+
+    CuAssertStrEquals(tc, "x = 7 ;", pp_run("m.c", include_pathes, 1));
+    size = pp_read_image(tc, "pre.h.hph");
+
+    /* a cut image is rebuilt wherever it is cut */
+    for (cut = 0; cut < size; cut += 7)
+    {
+        pp_read_image(tc, "pre.h.hph");
+        pp_write_image(tc, "pre.h.hph", cut);
+        CuAssertStrEquals(tc, "x = 7 ;", pp_run("m.c", include_pathes, 1));
+    }
+
+    /* an argument of F past its parameters */
+    size = pp_read_image(tc, "pre.h.hph");
+    at = pp_find(size, record, sizeof(record));
+    CuAssertTrue(tc, at >= 0);
+    pp_image[at + sizeof(record) + 1] = 1;
+    pp_write_image(tc, "pre.h.hph", size);
+    CuAssertStrEquals(tc, "x = 7 ;", pp_run("m.c", include_pathes, 1));
+    pp_read_image(tc, "pre.h.hph");
+    CuAssertIntEquals(tc, 0, pp_image[at + sizeof(record) + 1]);
+
+    /* a vaarg flag which is neither 0 nor 1 */
+    pp_image[at + 10] = 2;
+    pp_write_image(tc, "pre.h.hph", size);
+    CuAssertStrEquals(tc, "x = 7 ;", pp_run("m.c", include_pathes, 1));
+    pp_read_image(tc, "pre.h.hph");
+    CuAssertIntEquals(tc, 0, pp_image[at + 10]);
+
+    g_prefix_header = NULL;
+    pp_remove("pre.h.hph");
+    pp_remove("pre.h");
+    pp_remove("m.c");
+    pp_end();
+}
+
+void testpperror(CuTest *tc)
+{
+    char* include_pathes[1] = {"."};
+    int errors = 0;
+
+    pp_begin(tc);
+    pp_write(tc, "m.c", "#define A 1\n#define A 2\n#if\n#endif\nx = A;\n");
+    errors = get_error_count();
+
+    /* errors of the preprocessor are counted, and lexing goes on after them */
+    CuAssertStrEquals(tc, "x = 1 ;", pp_run("m.c", include_pathes, 1));
+    CuAssertIntEquals(tc, errors + 2, get_error_count());
+
+    pp_remove("m.c");
+    pp_end();
+}
+
+void testppmodule(CuTest *tc)
+{
+    char* include_pathes[1] = {"."};
+
+    pp_begin(tc);
+    g_header_modules = 1;
+    pp_write(tc, "h.h", "#ifndef H\n#define H\n#undef U\n#define D 1\nh = M;\n#endif\n");
+    pp_write(tc, "g.h", "#pragma once\n#include \"h.h\"\n#define E D\n");
+    pp_write(tc, "m1.c", "#define M 1\n#define U 9\n#include \"h.h\"\n#include \"h.h\"\nx = M D U;\n");
+    pp_write(tc, "m2.c", "#define M 2\n#include \"h.h\"\nx = M D U;\n");
+    pp_write(tc, "m3.c", "#define D 1\n#include \"g.h\"\n#include \"g.h\"\nx = M D E;\n");
+
+    /* a module is replayed only where the macros it uses are the same; its delta applies */
+    CuAssertStrEquals(tc, "h = 1 ; x = 1 1 U ;", pp_run("m1.c", include_pathes, 1));
+    CuAssertStrEquals(tc, "h = 1 ; x = 1 1 U ;", pp_run("m1.c", include_pathes, 1));
+    CuAssertStrEquals(tc, "h = 2 ; x = 2 1 U ;", pp_run("m2.c", include_pathes, 1));
+    CuAssertStrEquals(tc, "h = 2 ; x = 2 1 U ;", pp_run("m2.c", include_pathes, 1));
+    CuAssertStrEquals(tc, "h = 1 ; x = 1 1 U ;", pp_run("m1.c", include_pathes, 1));
+
+    /* through another module, with an identical definition beforehand */
+    CuAssertStrEquals(tc, "h = M ; x = M 1 1 ;", pp_run("m3.c", include_pathes, 1));
+    CuAssertStrEquals(tc, "h = M ; x = M 1 1 ;", pp_run("m3.c", include_pathes, 1));
+
+    g_header_modules = 0;
+    pp_remove("h.h");
+    pp_remove("g.h");
+    pp_remove("m1.c");
+    pp_remove("m2.c");
+    pp_remove("m3.c");
+    pp_end();
+}
+
+void testppmoduleredefine(CuTest *tc)
+{
+    char* include_pathes[1] = {"."};
+
+    pp_begin(tc);
+    g_header_modules = 1;
+    pp_write(tc, "h.h", "#ifndef H\n#define H\n#define BUFSZ 64\n#endif\n");
+    pp_write(tc, "m1.c", "#include \"h.h\"\nx = BUFSZ;\n");
+    pp_write(tc, "m2.c", "#define BUFSZ 128\n#include \"h.h\"\nx = BUFSZ;\n");
+
+    /* the header redefines BUFSZ unidentically: the definition found first stays, as without modules */
+    CuAssertStrEquals(tc, "x = 64 ;", pp_run("m1.c", include_pathes, 1));
+    CuAssertStrEquals(tc, "x = 128 ;", pp_run("m2.c", include_pathes, 1));
+    CuAssertStrEquals(tc, "x = 64 ;", pp_run("m1.c", include_pathes, 1));
+
+    g_header_modules = 0;
+    pp_remove("h.h");
+    pp_remove("m1.c");
+    pp_remove("m2.c");
+    pp_end();
+}
+
+void testppskip(CuTest *tc)
+{
+    char* include_pathes[1] = {"."};
+
+    pp_begin(tc);
+
+    /* what hides a directive in compiled-out code, and what does not */
+    pp_write(tc, "m.c",
+        "#if 0\n"
+        "'unterminated\n"
+        "\"#endif\"\n"
+        "/* #endif\n"
+        "#else */\n"
+        "// #endif \\\n"
+        "#endif\n"
+        "y = 0;\n"
+        "x ?\?/\n"
+        "#endif\n"
+        "z = 0;\n"
+        "#\\\n"
+        "endif\n"
+        "a = 1;\n"
+        "#if 0\n"
+        "# if 1\n"
+        "#else\n"
+        "#  endif\n"
+        "b = 0;\n"
+        "/* c */ #else\n"
+        "b = 2;\n"
+        "#endif\n"
+        "#if 1\n"
+        "c = 3;\n"
+        "#elif 1\n"
+        "c = 0;\n"
+        "#else\n"
+        "c = 0;\n"
+        "#endif\n");
+
+    CuAssertStrEquals(tc, "a = 1 ; b = 2 ; c = 3 ;", pp_run("m.c", include_pathes, 1));
+
+    pp_remove("m.c");
+    pp_end();
+}
+
+void testppmemo(CuTest *tc)
+{
+    char* include_pathes[1] = {"."};
+
+    pp_begin(tc);
+
+    /* a remembered expansion of A is dropped whenever a macro it went through changes */
+    pp_write(tc, "m.c",
+        "#define N 1\n"
+        "#define A N\n"
+        "a = A; a = A;\n"
+        "#undef N\n"
+        "b = A;\n"
+        "#define N 2\n"
+        "c = A; c = A;\n"
+        "#undef A\n"
+        "d = A;\n"
+        "#define A 4\n"
+        "e = A;\n");
+
+    CuAssertStrEquals(tc, "a = 1 ; a = 1 ; b = N ; c = 2 ; c = 2 ; d = A ; e = 4 ;",
+        pp_run("m.c", include_pathes, 1));
+
+    pp_remove("m.c");
+    pp_end();
+}
+
+void testpppaste(CuTest *tc)
+{
+    char* include_pathes[1] = {"."};
+
+    pp_begin(tc);
+
+    /* each paste twice: the second one goes through the pasted pairs remembered by the first */
+    pp_write(tc, "m.c",
+        "#define P(a, b) a ## b\n"
+        "#define Q(a, b) P(a, b) P(a, b)\n"
+        "Q(+, =) Q(<<, =) Q(-, >) Q(&, &) Q(x, 1) Q(1, 2)\n"
+        "P(?, .) P(_y, _t) P(_y, _t)\n");
+
+    CuAssertStrEquals(tc, "+= += <<= <<= -> -> && && x1 x1 12 12 ? . _y_t _y_t",
+        pp_run("m.c", include_pathes, 1));
+
+    pp_remove("m.c");
+    pp_end();
+}
+
+void testpprestore(CuTest *tc)
+{
+    char* include_pathes[1] = {"."};
+
+    pp_begin(tc);
+    pp_write(tc, "r1.c",
+        "#undef NULL\n"
+        "#define NULL 3\n"
+        "#undef wchar_t\n"
+        "#define LEAK 1\n"
+        "#assert leak(yes)\n"
+        "n = NULL; w = wchar_t;\n");
+    pp_write(tc, "r2.c",
+        "n = NULL; w = wchar_t; l = LEAK;\n"
+        "#if #leak(yes)\n"
+        "a = 1;\n"
+        "#endif\n");
+
+    /* what a translation unit changes in the initial tables is gone in the next one */
+    CuAssertStrEquals(tc, "n = 3 ; w = wchar_t ;", pp_run("r1.c", include_pathes, 1));
+    CuAssertStrEquals(tc, "n = ( ( void * ) 0 ) ; w = int ; l = LEAK ;", pp_run("r2.c", include_pathes, 1));
+    CuAssertStrEquals(tc, "n = 3 ; w = wchar_t ;", pp_run("r1.c", include_pathes, 1));
+    CuAssertStrEquals(tc, "n = ( ( void * ) 0 ) ; w = int ; l = LEAK ;", pp_run("r2.c", include_pathes, 1));
+
+    pp_remove("r1.c");
+    pp_remove("r2.c");
+    pp_end();
+}
+
+void testpprun(CuTest *tc)
+{
+    char* include_pathes[1] = {"."};
+
+    pp_begin(tc);
+
+    /*
+     * runs of names, numbers and blanks longer than eight bytes, broken by what is not in them;
+     * the names of the fifth line are read eight bytes at a time up to the splice
+     */
+    pp_write(tc, "m.c",
+        "abcdefghijklmnop$qrstuvwx = $abcdefghijklmnopqrstuvw + abcdefghijklmnopqrstuvwxyz$;\n"
+        "ABCDEFGH_ijklmnop\t \t        \t=\t\t\t\t\t\t\t\t\t1234567890123;\n"
+        "abcdefghijklm\\\nnopqrstuvwxyz = 1234567890\\\n123;\n"
+        "abcdefghijklm?\?/\nnopqrstuvwxyz$ = abcdefghijklm?\?/\n$$;\n"
+        "abcdefghijklmnop\\\nqrstuvwxyz = abcdefghijklmno?\?/\npqrstuvwxyz;\n"
+        "abcdefghijklm\\\n\\\n\\\n");
+
+    CuAssertStrEquals(tc,
+        "abcdefghijklmnop$qrstuvwx = $abcdefghijklmnopqrstuvw + abcdefghijklmnopqrstuvwxyz$ ; "
+        "ABCDEFGH_ijklmnop = 1234567890123 ; "
+        "abcdefghijklmnopqrstuvwxyz = 1234567890123 ; "
+        "abcdefghijklmnopqrstuvwxyz$ = abcdefghijklm$$ ; "
+        "abcdefghijklmnopqrstuvwxyz = abcdefghijklmnopqrstuvwxyz ; "
+        "abcdefghijklm",
+        pp_run("m.c", include_pathes, 1));
+
+    pp_remove("m.c");
+    pp_end();
+}
+
+/*
+ * write name: blanks up to size bytes, with head at the start and tail at the very end
+ */
+static void pp_write_padded(CuTest *tc, const char* name, const char* head, const char* tail, size_t size)
+{
+    char* text = (char*)malloc(size + 1);
+
+    memset(text, ' ', size);
+    memcpy(text, head, strlen(head));
+    memcpy(text + size - strlen(tail), tail, strlen(tail));
+    text[size] = '\0';
+    pp_write(tc, name, text);
+    free(text);
+}
+
+void testpprunend(CuTest *tc)
+{
+    char* include_pathes[1] = {"."};
+    size_t sizes[4] = {4096, 4099, 65536, 65541};
+    int i = 0;
+
+    pp_begin(tc);
+
+    /* a file is read or mapped whole: its last run stops at the end of the buffer */
+    for (i = 0; i < 4; i ++)
+    {
+        pp_write_padded(tc, "m.c", "a = 1;\n", "\nabcdefghijklmnopqrstuvwxyz$0123456789", sizes[i]);
+        CuAssertStrEquals(tc, "a = 1 ; abcdefghijklmnopqrstuvwxyz$0123456789", pp_run("m.c", include_pathes, 1));
+
+        pp_write_padded(tc, "m.c", "a = 1;\n", "\nb = 12345678901234567", sizes[i]);
+        CuAssertStrEquals(tc, "a = 1 ; b = 12345678901234567", pp_run("m.c", include_pathes, 1));
+
+        pp_write_padded(tc, "m.c", "a = 12345678901234", "", sizes[i]);
+        CuAssertStrEquals(tc, "a = 12345678901234", pp_run("m.c", include_pathes, 1));
+    }
+
+    /* nor does it go on into the file which included it */
+    pp_write(tc, "t.h", "abcdefghijklmnopq");
+    pp_write(tc, "m.c", "#include \"t.h\"\nrstuvwxyz0123456;\n");
+    CuAssertStrEquals(tc, "abcdefghijklmnopq rstuvwxyz0123456 ;", pp_run("m.c", include_pathes, 1));
+
+    pp_remove("t.h");
+    pp_remove("m.c");
+    pp_end();
+}
+
+/*
+ * write name: macros M0 .. M299 defined among K0 .. K9, then all of M undefined again but for
+ * M5, which is defined anew; the first 64 names of M are used when uses is set
+ */
+static void pp_write_undefs(CuTest *tc, const char* name, int uses)
+{
+    static char text[16384];
+    char* p = text;
+    int i = 0;
+
+    for (i = 0; i < 300; i ++)
+    {
+        p += sprintf(p, "#define M%d %d\n", i, i);
+        if (i % 30 == 0)
+        {
+            p += sprintf(p, "#define K%d %d\n", i / 30, i / 30);
+        }
+    }
+    for (i = 0; i < 300; i ++)
+    {
+        p += sprintf(p, "#undef M%d\n", i);
+    }
+    p += sprintf(p, "#define M5 55\nk = K0 K1 K2 K3 K4 K5 K6 K7 K8 K9 M5 NULL;\n");
+    for (i = 0; uses && i < 64; i ++)
+    {
+        p += sprintf(p, "M%d ", i);
+    }
+    pp_write(tc, name, text);
+}
+
+/*
+ * lookups of macro names and those ruled out by the name filter while name is preprocessed
+ */
+static char* pp_count(const char* name, char** include_pathes, unsigned long* lookups, unsigned long* filtered)
+{
+    char* output = NULL;
+
+    *lookups = macro_lookups;
+    *filtered = macro_lookups_filtered;
+    output = pp_run(name, include_pathes, 1);
+    *lookups = macro_lookups - *lookups;
+    *filtered = macro_lookups_filtered - *filtered;
+
+    return output;
+}
+
+void testppfilterundef(CuTest *tc)
+{
+    char* include_pathes[1] = {"."};
+    char expected[4096];
+    char* p = expected;
+    unsigned long lookups = 0, filtered = 0, uses_lookups = 0, uses_filtered = 0;
+    int i = 0;
+
+    pp_begin(tc);
+
+    /* the name filter is rebuilt on the way: what is still defined must be found */
+    pp_write_undefs(tc, "m.c", 0);
+    CuAssertStrEquals(tc, "k = 0 1 2 3 4 5 6 7 8 9 55 ( ( void * ) 0 ) ;", pp_run("m.c", include_pathes, 1));
+    pp_count("m.c", include_pathes, &lookups, &filtered);
+
+    /* and the names undefined before the rebuild are ruled out without a look at the table */
+    pp_write_undefs(tc, "m.c", 1);
+    p += sprintf(p, "k = 0 1 2 3 4 5 6 7 8 9 55 ( ( void * ) 0 ) ;");
+    for (i = 0; i < 64; i ++)
+    {
+        p += i == 5 ? sprintf(p, " 55") : sprintf(p, " M%d", i);
+    }
+    CuAssertStrEquals(tc, expected, pp_count("m.c", include_pathes, &uses_lookups, &uses_filtered));
+    CuAssertIntEquals(tc, 64, (int)(uses_lookups - lookups));
+    CuAssertIntEquals(tc, 63, (int)(uses_filtered - filtered));
+
+    pp_remove("m.c");
+    pp_end();
+}
+
+CuSuite* preprocessortestgetsuite()
+{
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testppincludecache);
+    SUITE_ADD_TEST(suite, testppknownfile);
+    SUITE_ADD_TEST(suite, testppprefixstale);
+    SUITE_ADD_TEST(suite, testppprefixcorrupt);
+    SUITE_ADD_TEST(suite, testpperror);
+    SUITE_ADD_TEST(suite, testppmodule);
+    SUITE_ADD_TEST(suite, testppmoduleredefine);
+    SUITE_ADD_TEST(suite, testppskip);
+    SUITE_ADD_TEST(suite, testppmemo);
+    SUITE_ADD_TEST(suite, testpppaste);
+    SUITE_ADD_TEST(suite, testpprestore);
+    SUITE_ADD_TEST(suite, testpprun);
+    SUITE_ADD_TEST(suite, testpprunend);
+    SUITE_ADD_TEST(suite, testppfilterundef);
+    return suite;
+}
@@ -0,0 +1,249 @@
+#include "CuTest.h"
+#include "hcc.h"
+#include "hconfig.h"
+#include "clexer.h"
+#include "atom.h"
+
+/*
+ * pre-lexed translation units and the token files written from them: source is written to a
+ * temporary file and lexed, the token stream is dumped and replayed.
+ */
+
+static char token_source[L_tmpnam];
+static char token_file[L_tmpnam];
+
+static void token_begin(CuTest *tc, const char* source)
+{
+    t_scanner_context sc;
+    char* include_path[1] = {"."};
+    FILE* f = NULL;
+
+    CuAssertPtrNotNull(tc, tmpnam(token_source));
+    CuAssertPtrNotNull(tc, tmpnam(token_file));
+    f = fopen(token_source, "w");
+    CuAssertPtrNotNull(tc, f);
+    fputs(source, f);
+    fclose(f);
+
+    sc.filename = token_source;
+    sc.include_pathes = include_path;
+    sc.number_of_include_pathes = 1;
+
+    initialize_clexer(&sc);
+    prelex_translation_unit();
+}
+
+static void token_end(void)
+{
+    free_clexer();
+    remove(token_source);
+    remove(token_file);
+}
+
+/*
+ * line of the first token spelled as name, 0 if there is none
+ */
+static int line_of(const char* name)
+{
+    int token = TK_NULL;
+
+    while ((token = get_token()) != TK_END)
+    {
+        if (token == TK_ID && HCC_LEXEME_STRING() == atom_string(name))
+        {
+            return coord.line;
+        }
+    }
+
+    return 0;
+}
+
+void testtokenfilefarlocation(CuTest *tc)
+{
+    /* lines past the bits of a packed location are kept aside */
+    token_begin(tc, "int a;\n#line 2000000\nint b;\nint c;\n#line 7\nint d;\n");
+
+    CuAssertIntEquals(tc, 2000000, line_of("b"));
+    CuAssertIntEquals(tc, 2000001, line_of("c"));
+    CuAssertIntEquals(tc, 7, line_of("d"));
+    CuAssertIntEquals(tc, 0, dump_translation_unit(token_file));
+    free_clexer();
+
+    CuAssertIntEquals(tc, 0, replay_translation_unit(token_file));
+    CuAssertIntEquals(tc, 1, line_of("a"));
+    CuAssertIntEquals(tc, 2000000, line_of("b"));
+    CuAssertIntEquals(tc, 2000001, line_of("c"));
+    CuAssertIntEquals(tc, 7, line_of("d"));
+
+    token_end();
+}
+
+static unsigned char image[4096];
+static long image_size;
+
+static void write_image(CuTest *tc, long size)
+{
+    FILE* f = fopen(token_file, "wb");
+
+    CuAssertPtrNotNull(tc, f);
+    fwrite(image, 1, size, f);
+    fclose(f);
+}
+
+static void read_image(CuTest *tc)
+{
+    FILE* f = fopen(token_file, "rb");
+
+    CuAssertPtrNotNull(tc, f);
+    image_size = (long)fread(image, 1, sizeof(image), f);
+    fclose(f);
+    CuAssertTrue(tc, image_size > 0 && image_size < (long)sizeof(image));
+}
+
+static int replay_image(CuTest *tc, long size)
+{
+    int result = 0;
+
+    write_image(tc, size);
+    result = replay_translation_unit(token_file);
+    if (!result)
+    {
+        free_clexer();
+    }
+
+    return result;
+}
+
+static void put_word(unsigned long word)
+{
+    image[image_size ++] = (unsigned char)(word & 0xFF);
+    image[image_size ++] = (unsigned char)((word >> 8) & 0xFF);
+    image[image_size ++] = (unsigned char)((word >> 16) & 0xFF);
+    image[image_size ++] = (unsigned char)((word >> 24) & 0xFF);
+}
+
+static void put_text(const char* text)
+{
+    put_word((unsigned long)strlen(text));
+    memcpy(image + image_size, text, strlen(text));
+    image_size += (long)strlen(text);
+}
+
+/*
+ * a token file of one token of kind, whose value has tag (1 atom, 3 integer in the format),
+ * followed by the end token; the magic is the one of the dumped file in image
+ */
+static void craft_image(int kind, int tag)
+{
+    image_size = 4;
+    put_word(1);
+    put_word(2);
+    put_word(2);
+    put_word(0);
+    put_word(0);
+    put_text("t.c");
+
+    image[image_size ++] = 0;
+    image[image_size ++] = (unsigned char)tag;
+    if (tag == 3)
+    {
+        put_word(5);
+        put_word(0);
+    }
+    else
+    {
+        put_text("x");
+    }
+
+    image[image_size ++] = (unsigned char)kind;
+    image[image_size ++] = (unsigned char)TK_END;
+    put_word(1);
+    put_word(0);
+    put_word(1);
+    put_word(1);
+}
+
+void testtokenfilecorrupt(CuTest *tc)
+{
+    long size = 0;
+
+    token_begin(tc, "int a = 1;\nchar* s = \"s\";\nfloat f = 1.5f;\ndouble d = 2.5;\n#line 3000000\nint b;\n");
+    CuAssertIntEquals(tc, 0, dump_translation_unit(token_file));
+    free_clexer();
+    read_image(tc);
+
+    CuAssertIntEquals(tc, 0, replay_image(tc, image_size));
+
+    /* a truncated file is rejected wherever it is cut, and so is trailing garbage */
+    for (size = 0; size < image_size; size ++)
+    {
+        CuAssertIntEquals(tc, -1, replay_image(tc, size));
+    }
+
+    image[image_size] = 0;
+    CuAssertIntEquals(tc, -1, replay_image(tc, image_size + 1));
+
+    /* a value must be what its token reads */
+    craft_image(TK_ID, 1);
+    write_image(tc, image_size);
+    CuAssertIntEquals(tc, 0, replay_translation_unit(token_file));
+    CuAssertIntEquals(tc, TK_ID, get_token());
+    CuAssertStrEquals(tc, "x", HCC_LEXEME_STRING());
+    free_clexer();
+
+    craft_image(TK_CONST_INTEGER, 3);
+    CuAssertIntEquals(tc, 0, replay_image(tc, image_size));
+
+    craft_image(TK_ID, 3);
+    CuAssertIntEquals(tc, -1, replay_image(tc, image_size));
+    craft_image(TK_CONST_STRING_LITERAL, 3);
+    CuAssertIntEquals(tc, -1, replay_image(tc, image_size));
+    craft_image(TK_CONST_INTEGER, 1);
+    CuAssertIntEquals(tc, -1, replay_image(tc, image_size));
+    craft_image(TK_ID, 0);
+    CuAssertIntEquals(tc, -1, replay_image(tc, image_size));
+
+    token_end();
+}
+
+void testtokenfilestale(CuTest *tc)
+{
+    char header[L_tmpnam];
+    char source[L_tmpnam + 32];
+    FILE* f = NULL;
+
+    CuAssertPtrNotNull(tc, tmpnam(header));
+    f = fopen(header, "w");
+    CuAssertPtrNotNull(tc, f);
+    fputs("#define N 1\n", f);
+    fclose(f);
+
+    sprintf(source, "#include \"%s\"\nint a = N;\n", header);
+    token_begin(tc, source);
+    CuAssertIntEquals(tc, 0, dump_translation_unit(token_file));
+    free_clexer();
+
+    CuAssertIntEquals(tc, 0, replay_translation_unit(token_file));
+    free_clexer();
+
+    /* a header which gave no token but a macro is a dependency all the same */
+    f = fopen(header, "w");
+    CuAssertPtrNotNull(tc, f);
+    fputs("#define N 22\n", f);
+    fclose(f);
+    CuAssertIntEquals(tc, -1, replay_translation_unit(token_file));
+
+    remove(header);
+    CuAssertIntEquals(tc, -1, replay_translation_unit(token_file));
+
+    token_end();
+}
+
+CuSuite* tokenfiletestgetsuite()
+{
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testtokenfilefarlocation);
+    SUITE_ADD_TEST(suite, testtokenfilecorrupt);
+    SUITE_ADD_TEST(suite, testtokenfilestale);
+    return suite;
+}
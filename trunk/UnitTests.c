@@ -22,6 +22,11 @@ union header {
 
 CuSuite* atomstringtestgetsuite();
 CuSuite* macrotestgetsuite();
+CuSuite* preprocessortestgetsuite();
+CuSuite* layouttestgetsuite();
+CuSuite* tokenfiletestgetsuite();
+CuSuite* lexertestgetsuite();
+CuSuite* nhashtestgetsuite();
 
 void run(void) 
 {
@@ -30,6 +35,11 @@ void run(void)
 
 	CuSuiteAddSuite(suite, atomstringtestgetsuite());
     CuSuiteAddSuite(suite, macrotestgetsuite());
+    CuSuiteAddSuite(suite, preprocessortestgetsuite());
+    CuSuiteAddSuite(suite, layouttestgetsuite());
+    CuSuiteAddSuite(suite, tokenfiletestgetsuite());
+    CuSuiteAddSuite(suite, lexertestgetsuite());
+    CuSuiteAddSuite(suite, nhashtestgetsuite());
 
 	CuSuiteRun(suite);
 	CuSuiteSummary(suite, output);
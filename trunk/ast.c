@@ -715,14 +715,14 @@ t_ast_abstract_declarator* make_ast_abstract_declarator(t_ast_pointer* pointer,
     return d;
 }
 
-t_ast_type_name* make_ast_type_name(t_ast_list* list, t_ast_abstract_declarator* abstract_declr)
+t_ast_type_name* make_ast_type_name(t_ast_declaration_specifier* specifier_qualifier_list, t_ast_abstract_declarator* abstract_declr)
 {
     t_ast_type_name* t = NULL;
     CALLOC(t, PERM);
 
-    assert(list);
+    assert(specifier_qualifier_list);
 
-    t->specifier_qualifier_list = list;
+    t->specifier_qualifier_list = specifier_qualifier_list;
     t->abstract_declarator = abstract_declr;
 
     return t;
@@ -773,7 +773,7 @@ t_ast_struct_declarator* make_ast_struct_declarator(t_ast_declarator* declarator
     return d;
 }
 
-t_ast_struct_declaration* make_ast_struct_declaration(t_ast_list* specifier_qualifier_list, t_ast_list* struct_declr_list)
+t_ast_struct_declaration* make_ast_struct_declaration(t_ast_declaration_specifier* specifier_qualifier_list, t_ast_list* struct_declr_list)
 {
 	t_ast_struct_declaration* d = NULL;
 	CALLOC(d, PERM);
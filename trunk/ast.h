@@ -657,7 +657,7 @@ typedef struct hcc_ast_struct_declaration
 {
 	t_ast_coord coord;
 
-	t_ast_list* specifier_qualifier_list;
+	t_ast_declaration_specifier* specifier_qualifier_list;
 	t_ast_list* struct_declarator_list;
 } t_ast_struct_declaration;
 
@@ -665,7 +665,7 @@ struct hcc_ast_type_name
 {
     t_ast_coord coord;
 
-    t_ast_list* specifier_qualifier_list;
+    t_ast_declaration_specifier* specifier_qualifier_list;
     t_ast_abstract_declarator* abstract_declarator;
 } ;
 
@@ -768,9 +768,9 @@ t_ast_declarator* make_ast_declarator(t_ast_pointer* pointer, t_ast_direct_decla
 t_ast_direct_abstract_declarator* make_ast_direct_abstract_declarator(t_ast_suffix_declarator* suffix_declr, t_ast_abstract_declarator* abstract_declr);
 t_ast_abstract_declarator* make_ast_abstract_declarator(t_ast_pointer* pointer, t_ast_direct_abstract_declarator* direct_abstract_declarator, t_ast_list* suffix_list);
 t_ast_struct_declarator* make_ast_struct_declarator(t_ast_declarator* declarator, t_ast_exp* const_exp);
-t_ast_struct_declaration* make_ast_struct_declaration(t_ast_list* specifier_qualifier_list, t_ast_list* struct_declr_list);
+t_ast_struct_declaration* make_ast_struct_declaration(t_ast_declaration_specifier* specifier_qualifier_list, t_ast_list* struct_declr_list);
 
-t_ast_type_name* make_ast_type_name(t_ast_list* list, t_ast_abstract_declarator* abstract_declr);
+t_ast_type_name* make_ast_type_name(t_ast_declaration_specifier* specifier_qualifier_list, t_ast_abstract_declarator* abstract_declr);
 t_ast_initializer* make_ast_initializer(t_ast_exp* assign_exp, t_ast_list* initializer_list, int comma_ending);
 t_ast_parameter_declaration* make_ast_parameter_declaration(t_ast_declaration_specifier* specifier, t_ast_direct_declarator* dir_declr, t_ast_direct_abstract_declarator* dir_abstract_declr, t_ast_all_declarator* all_declr, t_ast_pointer* ptr, t_ast_list* suffix_declr_list);
 t_ast_init_declarator* make_ast_init_declarator(t_ast_declarator* declarator, t_ast_initializer* initializer);
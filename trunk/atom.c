@@ -62,8 +62,10 @@ char* atom_string_number(const char* string, int length)
 	assert(string);
 	assert(length >= 0);
 
-	while (c = string[k++])
+	/* hash exactly length chars - string is not necessarily null terminated (see atom_int) */
+	for (; k < length; k ++)
 	{
+		c = (unsigned char)string[k];
 		hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
 	}
 
@@ -54,11 +54,10 @@ static t_ast_exp* unary_expression_folding(t_ast_exp* exp)
         case AST_OP_POS : /* + */ 
             {
                 /* nothing to do */
+                break;
             }
         case AST_OP_NEGATE : /* - */ 
             {
-                printf("%s%d\n", "type", e->type->code);
-
                 if (e->type == type_int)
                 {
                     e->u.ast_const_exp.val.i = - e->u.ast_const_exp.val.i;
@@ -77,16 +76,17 @@ static t_ast_exp* unary_expression_folding(t_ast_exp* exp)
                 }
                 
                 /* FIXME - more type checks and unsigned check */ 
+                break;
             }
         case AST_OP_INVERT : /* ~ */
             {
-                printf("%s%d\n", "type", e->type->code);
                 e->u.ast_const_exp.val.i = ~ e->u.ast_const_exp.val.i; /* [FIXME] precondition check, must be integer here */
+                break;
             }
         case AST_OP_NOT : /* ! */
             {
-                printf("%s%d\n", "type", e->type->code);
                 e->u.ast_const_exp.val.i = ! e->u.ast_const_exp.val.i; /* [TODO] type selection and fields mapping here. */
+                break;
             }
         default:
             break;
@@ -25,15 +25,20 @@ OTHER DEALINGS IN THE SOFTWARE.
 
 ****************************************************************/
 #include <math.h>
+#include <float.h>
+#include <errno.h>
 #include <assert.h>
 
 #include "clexer.h"
-#include "keywords.h"
+#include "keyhash.h"
+#include "pow5.h"
 #include "hcc.h"
 #include "hconfig.h"
 #include "assert.h"
 #include "error.h"
 #include "atom.h"
+#include "arena.h"
+#include "thread.h"
 #include "preprocessor/mem.h"
 #include "preprocessor/cpp.h"
 
@@ -67,14 +72,217 @@ static struct lexer_state ls;
 
 
 static int current_token_code;
-static int peek_token_code;
 static int cached_token_code;
 
-t_lexeme_value lexeme_value;
-t_lexeme_value peek_lexeme_value;
-t_lexeme_value cached_lexeme_value;
+t_lexeme_handle lexeme_handle;
 t_coordinate coord;
 
+static t_lexeme_value cached_lexeme_value;
+
+/*
+ * literal pool
+ * every token value is stored once for the whole translation unit and tokens carry its
+ * handle. entry 0 is the empty value of keywords, operators share one entry per token
+ * code and identifiers / literals with the same (interned) string share an entry through
+ * a direct mapped cache, so only numeric constants cost an entry per occurrence.
+ */
+t_lexeme_value* lexeme_pool;
+static int lexeme_pool_count;
+static int lexeme_pool_capacity;
+static t_lexeme_handle operator_handles[TK_NULL + 1];
+
+#define __HCC_STRING_HANDLE_CACHE_SIZE 1024
+
+static struct
+{
+	char* string;
+	t_lexeme_handle handle;
+} string_handle_cache[__HCC_STRING_HANDLE_CACHE_SIZE];
+
+static void reset_lexeme_pool();
+
+/*
+ * lookahead ring buffer
+ * peeked tokens are scanned straight into the ring slots and handed over to
+ * lexeme_handle / coord when get_token consumes them.
+ */
+typedef struct token_slot
+{
+	int code;
+	t_lexeme_handle value;
+	t_coordinate coord;
+} t_token_slot;
+
+static t_token_slot token_ring[HCC_LOOKAHEAD];
+static int ring_head;
+static int ring_count;
+
+/*
+ * destination of the token being scanned and the scanner position
+ * (the position runs ahead of coord while tokens are peeked)
+ */
+static t_lexeme_value* scan_value;
+static t_coordinate scan_coord;
+static t_coordinate cached_coord;
+
+/*
+ * pre-lexed translation unit, see prelex_translation_unit
+ * tokens are stored as a struct of arrays: token code (one byte), literal pool handle,
+ * and location packed as file index (high bits) and line (low __HCC_LOCATION_LINE_BITS bits).
+ * a location which doesn't fit is __HCC_LOCATION_FAR and kept in the far location table,
+ * ordered by token index.
+ */
+int g_prelex_translation_unit = 0;
+
+#define __HCC_LOCATION_LINE_BITS 20
+#define __HCC_LOCATION_LINE_LIMIT (1UL << __HCC_LOCATION_LINE_BITS)
+#define __HCC_LOCATION_FILE_LIMIT (1UL << (32 - __HCC_LOCATION_LINE_BITS))
+#define __HCC_LOCATION_FAR 0xFFFFFFFFUL
+#define __HCC_PACK_LOCATION(file, line) (((unsigned long)(file) << __HCC_LOCATION_LINE_BITS) | (unsigned long)(line))
+#define __HCC_LOCATION_FILE(location) ((location) >> __HCC_LOCATION_LINE_BITS)
+#define __HCC_LOCATION_LINE(location) ((location) & (__HCC_LOCATION_LINE_LIMIT - 1))
+
+typedef struct far_location
+{
+	unsigned int token;
+	unsigned int file;
+	int line;
+} t_far_location;
+
+static int prelexed;
+static unsigned char* tu_kinds;
+static unsigned int* tu_values;
+static unsigned int* tu_locations;
+static t_far_location* tu_far_locations;
+static int tu_far_count;
+static int tu_far_capacity;
+static int tu_count;
+static int tu_capacity;
+static int tu_cursor;
+
+static void unpack_location(int index, t_coordinate* position);
+
+/*
+ * token stream dump / replay, see dump_translation_unit
+ */
+int g_dump_token_stream = 0;
+int g_replay_token_stream = 0;
+
+/*
+ * precompiled prefix header, see apply_prefix_header
+ */
+char* g_prefix_header = NULL;
+
+static int prepare_prefix_header(t_scanner_context* sc);
+static void apply_prefix_header();
+
+/*
+ * header modules of ucpp, see g_header_modules
+ */
+int g_header_modules = 0;
+
+/* zero while replaying a token file - ucpp is never set up then */
+static int preprocessor_initialized;
+
+static char** tu_files;
+static int tu_file_count;
+static int tu_file_capacity;
+
+/*
+ * files the tokens were lexed from, loaded with a token file, and their stamps when it was
+ * written; a replayed token file is out of date once one of them changed
+ */
+typedef struct file_dependency
+{
+	char* name;
+	struct file_stamp stamp;
+} t_file_dependency;
+
+static t_file_dependency* tu_dependencies;
+static int tu_dependency_count;
+
+/*
+ * pipelined lexer, see g_pipeline_lexer
+ * a producer thread runs the preprocessor and token classification and publishes batches of
+ * tokens through a single producer / single consumer ring; get_token consumes them on the
+ * parser thread. interning (atom table) and PERM arena allocation stay on the parser thread,
+ * so the producer leaves lexeme strings raw and they are copied into the batch text.
+ */
+int g_pipeline_lexer = 0;
+
+#define HCC_PIPELINE_BATCH_SIZE 256
+#define HCC_PIPELINE_DEPTH 8
+
+/* a literal gives at most three diagnostics (format, range, suffix) */
+#define HCC_PIPELINE_DIAGNOSTICS 4
+
+/*
+ * diagnostic of the scanner on the producer thread, reported by the parser thread when it
+ * receives the token, as the synchronous lexer would have
+ */
+typedef struct scan_diagnostic
+{
+	int error; /* else a warning */
+	char* message;
+	long line;
+	char* filename;
+} t_scan_diagnostic;
+
+typedef struct token_record
+{
+	int code;
+	long line;
+	int text; /* offset of lexeme string in batch text, -1 if value is not a string */
+	char* filename; /* file of the token, stable copy owned by the producer */
+	t_lexeme_value value;
+	int preprocessor_errors; /* reported by ucpp itself while scanning the token */
+	int diagnostic_count;
+	t_scan_diagnostic diagnostics[HCC_PIPELINE_DIAGNOSTICS];
+} t_token_record;
+
+typedef struct token_batch
+{
+	int count;
+	t_token_record tokens[HCC_PIPELINE_BATCH_SIZE];
+	char* text;
+	int text_length;
+	int text_capacity;
+} t_token_batch;
+
+static t_token_batch pipeline_ring[HCC_PIPELINE_DEPTH];
+static volatile unsigned long pipeline_produced;
+static volatile unsigned long pipeline_consumed;
+static volatile unsigned long pipeline_stop;
+static void* pipeline_thread;
+static int pipeline_cursor;
+static char* pipeline_filename_copy;
+static char* pipeline_filename;
+
+/* file name copies made by the producer, alive until free_clexer */
+static char** pipeline_filenames;
+static int pipeline_filename_count;
+static int pipeline_filename_capacity;
+
+static int deferred_intern;
+
+/* record of the token being scanned on the producer thread, NULL when the lexer is synchronous */
+static t_token_record* scan_record;
+
+static void start_pipeline();
+static void stop_pipeline();
+static int receive_token(t_lexeme_value* value, t_coordinate* position);
+
+/*
+ * adjacent string literal builder
+ * pieces are appended to a growable buffer and the result is stored once; literals longer
+ * than __HCC_LITERAL_INTERN_LIMIT are copied to PERM arena instead of the atom table.
+ */
+#define __HCC_LITERAL_INTERN_LIMIT 256
+
+static char* literal_buffer = NULL;
+static int literal_length = 0;
+static int literal_capacity = 0;
+
 /* 
 	Lexical Map
 	
@@ -170,83 +378,12 @@ static unsigned char lexical_map[256] =
 
 };
 
-void initialize_clexer(t_scanner_context* sc)
+/*
+ * definitions made before reading each file; they are kept in the
+ * tables saved by save_tables()
+ */
+static void define_builtin_macros(void)
 {
-	int i = 0;	
-
-	assert(sc != NULL);
-
-	current_token_code = TK_NULL;
-	peek_token_code = TK_NULL;
-    cached_token_code = TK_NULL;
-
-	coord.filename = atom_string(sc->filename);
-	coord.column = 0;
-	coord.line = 0;
-
-	/* initialize static tables of preprocessor ucpp */
-	init_cpp();
-	
-	/*
-	 * non-zero if the special macros (__FILE__ and others)
-	 * should not be defined. This is a global flag since
-	 * it affects the redefinition of such macros (which are
-	 * allowed if the special macros are not defined)
-	 */
-	no_special_macros = 0;
-
-	/* 
-	 * This function initializes the macro table
-	 * and other things; it will intialize assertions if it has a non-zero
-	 * argument
-	 */
-	init_tables(1);
-	
-	
-	/* init_include_path(sc->include_pathes); */
-	
-	/*
-	these are the set of "emit" macros use to debug or produce analysis information during
-	compilation
-
-	emit_dependencies
-		set to 1 if dependencies should be emitted during
-		preprocessing
-		set to 2 if dependencies should also be emitted for
-		system include files
-	
-	emit_defines
-		set to non-zero if #define macro definitions should be
-		emitted when macros are defined
-	
-	emit_assertions
-		set to non-zero if #define macro definitions should be
-		emitted when macros are defined
-	
-	emit_output
-		the FILE * where the above items are sent if one of the
-		three emit_ variables is set to non zero
-	*/
-	emit_dependencies = 0;
-	emit_defines = 0;
-	emit_assertions = 0;
-	emit_output = 0;
-	
-	set_init_filename(sc->filename, 1);
-
-	init_lexer_state(&ls);
-	init_lexer_mode(&ls);
-	ls.flags |= HANDLE_ASSERTIONS | HANDLE_PRAGMA | LINE_NUM | CPLUSPLUS_COMMENTS;
-
-	/* [TODO] - get current dir and concatenate the names */
-	ls.input = fopen(sc->filename, "rb");
-	if (ls.input == NULL)
-	{
-		fprintf(stderr, "%s\n", "error : input file is dead");		
-	}
-
-	for (; i < sc->number_of_include_pathes; i ++) add_incpath(sc->include_pathes[i]);
-
     /*
      * [NOTICE] Inject macro from here
      * [FIX ME] These macros should be put in HCC header file.
@@ -310,596 +447,2391 @@ void initialize_clexer(t_scanner_context* sc)
     set_identifier_char('$');
 }
 
-void free_clexer()
+void initialize_clexer(t_scanner_context* sc)
 {
-	wipeout();
-	free_lexer_state(&ls);
-}
+	int i = 0;	
+	int restored;
+	int prefixed = 0;
 
-static int identify_keyword(char* id)
-{
-    tKW* p = NULL;
-    int retval = TK_ID;
-	int index = 0;
-	if (*id != '_')
+	assert(sc != NULL);
+
+	current_token_code = TK_NULL;
+    cached_token_code = TK_NULL;
+	ring_head = ring_count = 0;
+
+	/*
+	 * the prefix header image is checked (and built if needed) and its tokens loaded before
+	 * the preprocessor is set up
+	 */
+	if (g_prefix_header)
 	{
-		/* convert *id to upper case letter if needed and calc diff as index (starting 0)
-		 * deal special case "_" seperately which will generate index out of bounds (26)
-		 */
-		index = (*id &~0x20) - 'A'; 
+		prefixed = !prepare_prefix_header(sc);
 	}
 
-	/* [NON STD EXT][FIX ME]
-	 * here is a hack to support __int64 extension
-	 * otherwise this keyword will be omitted.
-	 */
-	else if (!strcmp(id, "__int64"))
+	if (!prefixed)
 	{
-		return TK_INT64;
+		reset_lexeme_pool();
 	}
-  
-    assert(id);
 
-    p = kw_table[index];
-    while (p->name)
-    {
-        if ((size_t)p->len == strlen(id) && strncmp(id, p->name, strlen(id)) == 0)
-        {
-            retval = p->token;
-            break;
-        }
+	coord.filename = atom_string(sc->filename);
+	coord.column = 0;
+	coord.line = 0;
+	scan_coord = coord;
 
-        p++;
-    }
+	/*
+	 * after the first file, the macro and assertion tables come back
+	 * from the copy saved at the end of this function; the static tables
+	 * of ucpp are kept from one file to the next
+	 */
+	restored = restore_tables();
+	preprocessor_initialized = 1;
 
-    return retval; 
-}
+	if (!restored)
+	{
+		/* initialize static tables of preprocessor ucpp */
+		init_cpp();
+
+		/*
+		 * non-zero if the special macros (__FILE__ and others)
+		 * should not be defined. This is a global flag since
+		 * it affects the redefinition of such macros (which are
+		 * allowed if the special macros are not defined)
+		 */
+		no_special_macros = 0;
 
-static int identify_integer_value(char* start, int length, int base)
-{
-    unsigned long value = 0;
-    char* current = start;
-	char* trailer = start + length;
-    int i = 0;
-    int overflow = 0;
-	int ret_val = TK_CONST_INTEGER;
-	int engage_unsign = 0;
-	int engage_long = 0;
-	int engage_long_long = 0;
+		/* 
+		 * This function initializes the macro table
+		 * and other things; it will intialize assertions if it has a non-zero
+		 * argument
+		 */
+		init_tables(1);
+	}
+	
+	
+	/* init_include_path(sc->include_pathes); */
+	
+	/*
+	these are the set of "emit" macros use to debug or produce analysis information during
+	compilation
 
-    assert(start);
+	emit_dependencies
+		set to 1 if dependencies should be emitted during
+		preprocessing
+		set to 2 if dependencies should also be emitted for
+		system include files
+	
+	emit_defines
+		set to non-zero if #define macro definitions should be
+		emitted when macros are defined
+	
+	emit_assertions
+		set to non-zero if #define macro definitions should be
+		emitted when macros are defined
+	
+	emit_output
+		the FILE * where the above items are sent if one of the
+		three emit_ variables is set to non zero
+	*/
+	emit_dependencies = 0;
+	emit_defines = 0;
+	emit_assertions = 0;
+	emit_output = 0;
 
-    for (; length > 0; length -- , current ++)
-    {
-        if (16 == base)
-        {
-            if ( (*current >= 'A' && *current <= 'F') ||
-                 (*current >= 'a' && *current <= 'f'))
-            {
-                i = (*current & ~0x20) - 'A' + 10;
-            }
-            else if (HCC_ISDECIMAL_DIGIT(*current)) 
-            {
-                i = *current - '0';
-            }
-            else
-            {
-                lexeme_error("illegal hex character detected!");
-                break;
-            }
+	/* guarded headers are recorded once and replayed in later files */
+	header_modules = g_header_modules;
+	
+	set_init_filename(sc->filename, 1);
 
-            if (value &~(~0UL >> 4))
-            {
-                overflow = 1;
-                warning("overflow detected for hex integer!");
-            }
-            else
-            {
-                value = (value<<4) + i;
-            }
-        }
-        else if (8 == base)
-        {
-            assert(HCC_ISOCT_DIGIT(*current));
-        
-            i = *current - '0';
-            if (value &~(~0UL >> 3))
-            {
-                overflow = 1;
-                warning("overflow detected for oct integer!");
-            }
-            else
-            {
-                value = (value<<3) + i;
-            }
-        }
-        else
-        {
-            assert(base == 10);
-            assert(HCC_ISDECIMAL_DIGIT(*current));
-            
-            i = *current - '0';
+	init_lexer_state(&ls);
+	init_lexer_mode(&ls);
+	/*
+	 * STAMP_CONTEXT instead of LINE_NUM: ucpp keeps newline and context tokens to itself,
+	 * line is on every token and file changes are noted in ls.context_name
+	 */
+	ls.flags |= HANDLE_ASSERTIONS | HANDLE_PRAGMA | STAMP_CONTEXT | CPLUSPLUS_COMMENTS;
 
-            if (value > (~0UL - i)/10)
-            {
-                overflow = 1;
-                warning("overflow detected for decimal integer!");
-            }
-            else
-            {
-                value = value * 10 + i;
-            }
-        }
-    }
+	/* [TODO] - get current dir and concatenate the names */
+#ifdef UCPP_MMAP
+	/* mapped (or read whole) like the included files */
+	ls.input = fopen_mmap_file(sc->filename);
+	if (ls.input != NULL)
+	{
+		set_input_file(&ls, ls.input);
+	}
+#else
+	ls.input = fopen(sc->filename, "rb");
+#endif
+	if (ls.input == NULL)
+	{
+		fprintf(stderr, "%s\n", "error : input file is dead");		
+	}
 
-    HCC_TRACE("integer value is %d\n", value);
+	for (; i < sc->number_of_include_pathes; i ++) add_incpath(sc->include_pathes[i]);
 
-	if (*trailer == 'u' || *trailer == 'U')
+	if (!restored)
 	{
-		trailer ++;
-		engage_unsign = 1;
+		define_builtin_macros();
+
+		/* later files start from this state, see restore_tables() above */
+		save_tables();
 	}
 
-	if (*trailer == 'l' || *trailer == 'L')
+	/* the tokens of the prefix header come first, and the preprocessor goes on from its state */
+	if (prefixed)
 	{
-		trailer ++;
-		
-		if (*trailer == '1' || *trailer == 'L')
-		{
-			engage_long_long = 1;
-		}
-		else
-		{
-			engage_long = 1;
-		}
+		apply_prefix_header();
 	}
 
-	if (engage_unsign)
+	/* preprocessor is set up, the producer thread owns it from here */
+	if (g_pipeline_lexer)
 	{
-		if (engage_long)
-		{
-			ret_val = TK_CONST_UNSIGNED_LONG_INTEGER;
-		}
-		else if (engage_long_long)
-		{
-			assert(!engage_long);
-			ret_val = TK_CONST_UNSIGNED_LONG_LONG;
-		}
-		else
-		{
-			ret_val = TK_CONST_UNSIGNED_INTEGER;
-		}
+		start_pipeline();
 	}
-	else
+
+	/* tokens of the file are appended to the ones of the prefix header */
+	if (prefixed)
 	{
-		if (engage_long)
-		{
-			ret_val = TK_CONST_LONG_INTEGER;
-		}
-		else if (engage_long_long)
-		{
-			assert(!engage_long);
-			ret_val = TK_CONST_LONG_LONG;
-		}
-		else
-		{
-			ret_val = TK_CONST_INTEGER;
-		}
+		prelex_translation_unit();
 	}
-
-	lexeme_value.integer_value = value;  
-
-	/* TODO - consider possible overflow here.
-	 * use the integer array to hold larger values.
-	 */
-	return ret_val;
 }
 
-static int identify_float_value(char* number, char* begin)
+static void free_token_buffer()
+{
+	free(tu_kinds);
+	free(tu_values);
+	free(tu_locations);
+	free(tu_far_locations);
+	free(tu_files);
+	free(tu_dependencies);
+	tu_kinds = NULL;
+	tu_values = tu_locations = NULL;
+	tu_far_locations = NULL;
+	tu_files = NULL;
+	tu_dependencies = NULL;
+	tu_dependency_count = 0;
+	tu_count = tu_capacity = tu_cursor = 0;
+	tu_far_count = tu_far_capacity = 0;
+	tu_file_count = tu_file_capacity = 0;
+	prelexed = 0;
+}
+
+void free_clexer()
+{
+	stop_pipeline();
+
+	if (preprocessor_initialized)
+	{
+		wipeout();
+		free_lexer_state(&ls);
+		preprocessor_initialized = 0;
+	}
+
+	free(literal_buffer);
+	literal_buffer = NULL;
+	literal_length = literal_capacity = 0;
+
+	free(lexeme_pool);
+	lexeme_pool = NULL;
+	lexeme_pool_count = lexeme_pool_capacity = 0;
+
+	free_token_buffer();
+}
+
+void finalize_clexer()
+{
+	free_saved_tables();
+	free_include_cache();
+}
+
+static void append_string_literal(char* piece)
+{
+	int length = (int)strlen(piece);
+
+	if (literal_length + length + 1 > literal_capacity)
+	{
+		while (literal_length + length + 1 > literal_capacity)
+		{
+			literal_capacity = literal_capacity ? literal_capacity * 2 : 256;
+		}
+
+		literal_buffer = (char*)realloc(literal_buffer, literal_capacity);
+		if (!literal_buffer)
+		{
+			exit(1);
+		}
+	}
+
+	memcpy(literal_buffer + literal_length, piece, length + 1);
+	literal_length += length;
+}
+
+static char* store_literal(char* text, int length)
+{
+	char* literal = NULL;
+
+	if (length <= __HCC_LITERAL_INTERN_LIMIT)
+	{
+		return atom_string_number(text, length);
+	}
+
+	literal = (char*)hcc_alloc(length + 1, PERM);
+	memcpy(literal, text, length);
+	literal[length] = '\0';
+
+	return literal;
+}
+
+static char* store_string_literal()
+{
+	/* pipeline producer - parser thread stores the literal from the batch text */
+	if (deferred_intern)
+	{
+		return literal_buffer;
+	}
+
+	return store_literal(literal_buffer, literal_length);
+}
+
+/*
+ * file name for scanner position: an atom, or in the pipeline producer a stable copy
+ * (ucpp may free its name when the file is closed)
+ */
+static char* context_filename(char* name)
+{
+	int i = 0;
+
+	if (!deferred_intern)
+	{
+		return atom_string(name);
+	}
+
+	for (; i < pipeline_filename_count; i ++)
+	{
+		if (strcmp(pipeline_filenames[i], name) == 0)
+		{
+			return pipeline_filenames[i];
+		}
+	}
+
+	if (pipeline_filename_count == pipeline_filename_capacity)
+	{
+		pipeline_filename_capacity = pipeline_filename_capacity ? pipeline_filename_capacity * 2 : 16;
+		pipeline_filenames = (char**)realloc(pipeline_filenames, pipeline_filename_capacity * sizeof(char*));
+		if (!pipeline_filenames)
+		{
+			exit(1);
+		}
+	}
+
+	pipeline_filenames[pipeline_filename_count] = (char*)malloc(strlen(name) + 1);
+	if (!pipeline_filenames[pipeline_filename_count])
+	{
+		exit(1);
+	}
+	strcpy(pipeline_filenames[pipeline_filename_count], name);
+
+	return pipeline_filenames[pipeline_filename_count ++];
+}
+
+/* lexeme string - interned, or left raw in the pipeline producer */
+static char* lexeme_string(char* name)
+{
+	return deferred_intern ? name : atom_string(name);
+}
+
+/*
+ * keyword recognition is a single probe into the perfect hash generated into keyhash.h
+ * by utility/kwgen.c, which also covers the [NON STD EXT] __int64 keyword.
+ */
+static int identify_keyword(char* id)
+{
+    assert(id);
+
+    return kw_lookup(id);
+}
+
+/*
+ * numeric literals are decoded in a single pass over the token text. runs of eight
+ * digits are converted with one SWAR multiply chain instead of eight dependent
+ * multiply-adds on little endian targets, which is where the data tables full of
+ * numbers spend their lexing time.
+ */
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__) || \
+    (defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define HCC_SWAR_LITERALS
+#endif
+
+#define __HCC_U64_MAX (~(unsigned long long)0)
+#define __HCC_SWAR_ONES 0x0101010101010101ULL
+
+#ifdef HCC_SWAR_LITERALS
+/*
+ * decode p[0..7] as eight decimal digits, returns 0 if any of them is not a digit.
+ */
+static int swar_decimal8(const char* p, unsigned long long* chunk)
+{
+    unsigned long long v;
+
+    memcpy(&v, p, 8);
+    if (((v & 0xF0F0F0F0F0F0F0F0ULL) |
+        (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) != 0x3333333333333333ULL)
+    {
+        return 0;
+    }
+
+    v -= 0x3030303030303030ULL;
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+        (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+
+    *chunk = v;
+    return 1;
+}
+
+/*
+ * decode p[0..7] as eight hex digits, returns 0 if any of them is not a hex digit.
+ */
+static int swar_hex8(const char* p, unsigned long long* chunk)
+{
+    unsigned long long v;
+    unsigned long long low;
+    unsigned long long digit;
+    unsigned long long alpha;
+
+    memcpy(&v, p, 8);
+    if (v & (__HCC_SWAR_ONES * 0x80))
+    {
+        return 0;
+    }
+
+    /* bytes in '0'..'9' and, case folded, in 'a'..'f' get their top bit set */
+    low = v & (__HCC_SWAR_ONES * 0x7F);
+    digit = ((__HCC_SWAR_ONES * (127 + 0x3A) - low) & ~v & (low + __HCC_SWAR_ONES * (127 - 0x2F)));
+    low |= __HCC_SWAR_ONES * 0x20;
+    alpha = ((__HCC_SWAR_ONES * (127 + 0x67) - low) & ~(v | (__HCC_SWAR_ONES * 0x20)) &
+        (low + __HCC_SWAR_ONES * (127 - 0x60)));
+    if (((digit | alpha) & (__HCC_SWAR_ONES * 0x80)) != __HCC_SWAR_ONES * 0x80)
+    {
+        return 0;
+    }
+
+    /* nibble values, then fold the first digit into the most significant position */
+    v = (v & (__HCC_SWAR_ONES * 0x0F)) + 9 * ((v >> 6) & __HCC_SWAR_ONES);
+    v = ((v & 0x000F000F000F000FULL) << 4) | ((v & 0x0F000F000F000F00ULL) >> 8);
+    v = ((v & 0x000000FF000000FFULL) << 8) | ((v & 0x00FF000000FF0000ULL) >> 16);
+    v = ((v & 0xFFFFULL) << 16) | ((v >> 32) & 0xFFFFULL);
+
+    *chunk = v;
+    return 1;
+}
+#endif
+
+/*
+ * accumulate the decimal digits at p into *value, setting *overflow once the value
+ * no longer fits into 64 bits. returns the first character after the digits.
+ */
+static char* scan_decimal_digits(char* p, char* end, unsigned long long* value, int* overflow)
+{
+    unsigned long long v = *value;
+    unsigned int i;
+
+#ifdef HCC_SWAR_LITERALS
+    unsigned long long chunk;
+
+    while (end - p >= 8 && swar_decimal8(p, &chunk))
+    {
+        if (v > (__HCC_U64_MAX - chunk) / 100000000)
+        {
+            *overflow = 1;
+        }
+        v = v * 100000000 + chunk;
+        p += 8;
+    }
+#endif
+
+    for (; HCC_ISDECIMAL_DIGIT(*p); p ++)
+    {
+        i = *p - '0';
+        if (v > (__HCC_U64_MAX - i) / 10)
+        {
+            *overflow = 1;
+        }
+        v = v * 10 + i;
+    }
+
+    *value = v;
+    return p;
+}
+
+static int hex_digit_value(char c)
+{
+    if (HCC_ISDECIMAL_DIGIT(c))
+    {
+        return c - '0';
+    }
+    else if ((c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f'))
+    {
+        return (c & ~0x20) - 'A' + 10;
+    }
+
+    return -1;
+}
+
+static char* scan_hex_digits(char* p, char* end, unsigned long long* value, int* overflow)
+{
+    unsigned long long v = 0;
+    int i;
+
+#ifdef HCC_SWAR_LITERALS
+    unsigned long long chunk;
+
+    while (end - p >= 8 && swar_hex8(p, &chunk))
+    {
+        if (v >> 32)
+        {
+            *overflow = 1;
+        }
+        v = (v << 32) | chunk;
+        p += 8;
+    }
+#endif
+
+    for (; (i = hex_digit_value(*p)) >= 0; p ++)
+    {
+        if (v >> 60)
+        {
+            *overflow = 1;
+        }
+        v = (v << 4) | i;
+    }
+
+    *value = v;
+    return p;
+}
+
+/*
+ * diagnostics of the scanner are reported at the token being scanned, which is ahead of
+ * coord while tokens are peeked or the unit is pre-lexed
+ */
+static void record_diagnostic(int error, char* msg)
+{
+    t_scan_diagnostic* diagnostic = NULL;
+
+    if (scan_record->diagnostic_count < HCC_PIPELINE_DIAGNOSTICS)
+    {
+        diagnostic = &scan_record->diagnostics[scan_record->diagnostic_count ++];
+        diagnostic->error = error;
+        diagnostic->message = msg;
+        diagnostic->line = scan_coord.line;
+        diagnostic->filename = scan_coord.filename;
+    }
+}
+
+static void scan_error(char* msg)
+{
+    if (scan_record)
+    {
+        record_diagnostic(1, msg);
+    }
+    else
+    {
+        lexeme_error_at(msg, &scan_coord);
+    }
+}
+
+static void scan_warning(char* msg)
+{
+    if (scan_record)
+    {
+        record_diagnostic(0, msg);
+    }
+    else
+    {
+        warning_at(msg, &scan_coord);
+    }
+}
+
+/*
+ * integer suffixes are any order of an optional u and an optional l or ll, where
+ * the two letters of ll must agree in case. [NON STD EXT] the MSVC i64 suffix
+ * is accepted as a synonym of ll so that the platform headers lex.
+ */
+static int identify_integer_suffix(char* suffix, unsigned long long value)
+{
+    int engage_unsign = 0;
+    int engage_long = 0;
+    int engage_long_long = 0;
+    int ret_val;
+
+    for (;;)
+    {
+        if ((*suffix == 'u' || *suffix == 'U') && !engage_unsign)
+        {
+            engage_unsign = 1;
+            suffix ++;
+        }
+        else if ((*suffix == 'l' || *suffix == 'L') && !engage_long && !engage_long_long)
+        {
+            if (suffix[1] == suffix[0])
+            {
+                engage_long_long = 1;
+                suffix += 2;
+            }
+            else
+            {
+                engage_long = 1;
+                suffix ++;
+            }
+        }
+        else if ((*suffix == 'i' || *suffix == 'I') && suffix[1] == '6' && suffix[2] == '4' &&
+            !engage_long && !engage_long_long)
+        {
+            engage_long_long = 1;
+            suffix += 3;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (*suffix != '\0')
+    {
+        scan_error("invalid integer constant suffix detected!");
+    }
+
+    if (engage_unsign)
+    {
+        ret_val = engage_long ? TK_CONST_UNSIGNED_LONG_INTEGER :
+            engage_long_long ? TK_CONST_UNSIGNED_LONG_LONG : TK_CONST_UNSIGNED_INTEGER;
+    }
+    else
+    {
+        ret_val = engage_long ? TK_CONST_LONG_INTEGER :
+            engage_long_long ? TK_CONST_LONG_LONG : TK_CONST_INTEGER;
+    }
+
+    HCC_TRACE("integer value is %llu\n", value);
+
+    scan_value->integer_value = value;
+
+    return ret_val;
+}
+
+/*
+ * 64 x 64 -> 128 bit multiply, kept in portable C since MSVC has no 128 bit type.
+ */
+static void multiply_u64(unsigned long long a, unsigned long long b,
+                         unsigned long long* high, unsigned long long* low)
+{
+    unsigned long long a_lo = a & 0xFFFFFFFFULL;
+    unsigned long long a_hi = a >> 32;
+    unsigned long long b_lo = b & 0xFFFFFFFFULL;
+    unsigned long long b_hi = b >> 32;
+    unsigned long long p0 = a_lo * b_lo;
+    unsigned long long p1 = a_lo * b_hi;
+    unsigned long long p2 = a_hi * b_lo;
+    unsigned long long p3 = a_hi * b_hi;
+    unsigned long long middle = (p0 >> 32) + (p1 & 0xFFFFFFFFULL) + (p2 & 0xFFFFFFFFULL);
+
+    *low = (middle << 32) | (p0 & 0xFFFFFFFFULL);
+    *high = p3 + (p1 >> 32) + (p2 >> 32) + (middle >> 32);
+}
+
+/*
+ * convert w * 10^q into the nearest double without going through strtod.
+ * exact products are handled by the classic Clinger fast path, everything else
+ * inside the range of pow5.h by the Eisel-Lemire algorithm. returns 0 for the
+ * rare inputs neither can decide (subnormals, ambiguous truncated products,
+ * exponents outside the table), the caller then falls back to strtod.
+ */
+static int decimal_to_double(unsigned long long w, int q, double* result)
+{
+    static const double exact_powers[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const unsigned long long* power;
+    unsigned long long high;
+    unsigned long long low;
+    unsigned long long second_high;
+    unsigned long long second_low;
+    unsigned long long mantissa;
+    unsigned long long bits;
+    int leading_zeros = 0;
+    int upper_bit;
+    int exponent;
+
+    if (w == 0)
+    {
+        *result = 0;
+        return 1;
+    }
+
+    if (w <= (1ULL << 53) && q >= -22 && q <= 22)
+    {
+        *result = q < 0 ? (double)w / exact_powers[-q] : (double)w * exact_powers[q];
+        return 1;
+    }
+
+    if (q < POW5_MIN_EXPONENT || q > POW5_MAX_EXPONENT)
+    {
+        return 0;
+    }
+
+    while (!(w & (1ULL << 63)))
+    {
+        w <<= 1;
+        leading_zeros ++;
+    }
+
+    /* 55 bits of precision are needed, widen with the low half of 5^q if unsure */
+    power = pow5_table[q - POW5_MIN_EXPONENT];
+    multiply_u64(w, power[0], &high, &low);
+    if ((high & 0x1FF) == 0x1FF)
+    {
+        multiply_u64(w, power[1], &second_high, &second_low);
+        low += second_high;
+        if (second_high > low)
+        {
+            high ++;
+        }
+    }
+
+    if (low == __HCC_U64_MAX && (q < -27 || q > 55))
+    {
+        return 0;
+    }
+
+    upper_bit = (int)(high >> 63);
+    mantissa = high >> (upper_bit + 9);
+    exponent = (((152170 + 65536) * q) >> 16) + 63 + upper_bit - leading_zeros + 1023;
+    if (exponent <= 0)
+    {
+        return 0;
+    }
+
+    /* round half to even is only possible where 5^q is exact */
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 &&
+        (mantissa << (upper_bit + 9)) == high)
+    {
+        mantissa &= ~1ULL;
+    }
+
+    mantissa += (mantissa & 1);
+    mantissa >>= 1;
+    if (mantissa >= (2ULL << 52))
+    {
+        mantissa = 1ULL << 52;
+        exponent ++;
+    }
+    mantissa &= ~(1ULL << 52);
+
+    if (exponent >= 0x7FF)
+    {
+        exponent = 0x7FF;
+        mantissa = 0;
+    }
+
+    bits = mantissa | ((unsigned long long)exponent << 52);
+    memcpy(result, &bits, sizeof(bits));
+
+    return 1;
+}
+
+/*
+ * number points to the start of the literal, cursor past the integer digits already
+ * accumulated into w.
+ */
+static int identify_float_value(char* number, char* cursor, char* end,
+                                unsigned long long w, int overflow)
 {
     int return_val = TK_CONST_FLOAT;
-    long double value = 0;
+    int exponent = 0;
+    int exponent_sign = 1;
+    char* fraction;
+    double value;
+
+    assert(number);
+    assert(cursor);
+
+    if ('.' == *cursor)
+    {
+        fraction = ++ cursor;
+        cursor = scan_decimal_digits(cursor, end, &w, &overflow);
+        exponent = -(int)(cursor - fraction);
+    }
+
+    if ('e' == *cursor || 'E' == *cursor)
+    {
+        int e = 0;
+
+        cursor ++;
+        if ('+' == *cursor || '-' == *cursor)
+        {
+            exponent_sign = ('-' == *cursor) ? -1 : 1;
+            cursor ++;
+        }
+
+        if (!HCC_ISDECIMAL_DIGIT(*cursor))
+        {
+            scan_error("incorrect float constant format detected!");
+            return 0;
+        }
+
+        for (; HCC_ISDECIMAL_DIGIT(*cursor); cursor ++)
+        {
+            if (e < 100000)
+            {
+                e = e * 10 + (*cursor - '0');
+            }
+        }
+
+        exponent += exponent_sign * e;
+    }
+
+    if (overflow || !decimal_to_double(w, exponent, &value))
+    {
+        errno = 0;
+        value = strtod(number, NULL);
+        if (errno == ERANGE)
+        {
+            scan_warning("float value out of range!");
+        }
+    }
+    else if (value > DBL_MAX)
+    {
+        scan_warning("float value out of range!");
+    }
+
+#ifdef HCC_TRACE_ENABLE
+    fprintf(stderr, "float value %f\n", value);
+#endif
+
+    scan_value->double_value = value;
+
+    if (*cursor == 'f' || *cursor == 'F')
+    {
+        scan_value->float_value = (float)value;
+        cursor ++;
+    }
+    else if (*cursor == 'l' || *cursor == 'L')
+    {
+        return_val = TK_CONST_LONG_DOUBLE;
+        cursor ++;
+    }
+    else
+    {
+        return_val = TK_CONST_DOUBLE;
+    }
+
+    if (*cursor != '\0')
+    {
+        scan_error("invalid float constant suffix detected!");
+    }
+
+    return return_val;
+}
+
+static int identify_numerical_value(char* number)
+{
+    char* end = number + strlen(number);
+    char* cursor;
+    unsigned long long value = 0;
+    int overflow = 0;
+
+    assert(number);
+
+    if ('0' == *number && 
+        ('x' == number[1] ||
+         'X' == number[1]))
+    {
+        cursor = scan_hex_digits(number + 2, end, &value, &overflow);
+        if (cursor == number + 2)
+        {
+            scan_error("illegal hex character detected!");
+        }
+        else if (overflow)
+        {
+            scan_warning("overflow detected for hex integer!");
+        }
+
+        return identify_integer_suffix(cursor, value);
+    }
+
+    /*
+     * decimal digits are accumulated up front even when the literal turns out to be
+     * octal or floating, the float path continues from them and octal is rescanned.
+     */
+    cursor = scan_decimal_digits(number, end, &value, &overflow);
+
+    if ('.' == *cursor || 'e' == *cursor || 'E' == *cursor)
+    {
+        return identify_float_value(number, cursor, end, value, overflow);
+    }
+
+    if ('0' == *number)
+    {
+        char* digit;
+
+        value = 0;
+        overflow = 0;
+        for (digit = number + 1; digit < cursor; digit ++)
+        {
+            if (!HCC_ISOCT_DIGIT(*digit))
+            {
+                scan_error("illegal oct digit detected!");
+                break;
+            }
+
+            if (value >> 61)
+            {
+                overflow = 1;
+            }
+            value = (value << 3) | (*digit - '0');
+        }
+
+        if (overflow)
+        {
+            scan_warning("overflow detected for oct integer!");
+        }
+    }
+    else if (overflow)
+    {
+        scan_warning("overflow detected for decimal integer!");
+    }
+
+    return identify_integer_suffix(cursor, value);
+}
+
+
+static int get_token_internal()
+{
+    int retval;
+    int r;
+
+    retval = TK_ID;
+
+    /*
+    * lex() reads the next token from the processed stream and stores it
+    * into ls->ctok.
+    * return value: non zero on error (including CPPERR_EOF, which is not
+    * quite an error); ucpp has reported the error and no token was
+    * retrieved, lexing goes on with the next one
+    */
+    while ((r = lex(&ls)) && r != CPPERR_EOF)
+    {
+        if (scan_record)
+        {
+            scan_record->preprocessor_errors ++;
+        }
+        else
+        {
+            preprocessor_error();
+        }
+    }
+
+    if (r == CPPERR_EOF)
+    {
+        return TK_END;
+    }
+
+    if (ls.context_changed)
+    {
+#ifdef HCC_TRACE_ENABLE
+        printf("new context: file '%s', line %ld\n",
+            ls.context_name, ls.ctok->line);
+#endif
+
+        scan_coord.filename = context_filename(ls.context_name);
+        ls.context_changed = 0;
+    }
+	
+    
+    /* we print each token: its numerical value, and its
+    string content; if this is a PRAGMA token, the
+    string content is in fact a compressed token list,
+    that we uncompress and print. */
+    if (ls.ctok->type == PRAGMA) 
+    {
+        unsigned char *c = (unsigned char *)(ls.ctok->name);
+
+#ifdef HCC_TRACE_ENABLE
+       printf("line %ld: <#pragma>\n", ls.line); 
+#endif
+
+        for (; *c; c ++) 
+        {
+            int t = *c;
+
+            if (STRING_TOKEN(t)) 
+            {
+            #ifdef HCC_TRACE_ENABLE
+                printf("  <%2d>  ", t);
+            #endif
+
+                for (c ++; *c != PRAGMA_TOKEN_END; c ++)
+                {
+            #ifdef HCC_TRACE_ENABLE
+                    putchar(*c);
+                    putchar('\n');
+            #endif
+                }
+            } 
+            else 
+            {
+            #ifdef HCC_TRACE_ENABLE
+                printf("  <%2d>  `%s'\n", t,
+                    operators_name[t]);
+            #endif
+            }
+        }
+
+        retval = TK_POUND;
+    } 
+    else if (ls.ctok->type == CONTEXT) 
+    {
+#ifdef HCC_TRACE_ENABLE
+        printf("new context: file '%s', line %ld\n",
+            ls.ctok->name, ls.ctok->line);
+#endif
+        
+        scan_coord.filename = context_filename(ls.ctok->name);
+        scan_coord.line = ls.ctok->line;
+
+		/* HACK! TODO */
+        retval = TK_WHITESPACE;
+    } 
+    else if (ls.ctok->type == NEWLINE) 
+    {
+#ifdef HCC_TRACE_ENABLE
+        printf("[newline]\n");
+#endif
+
+        retval = TK_NEWLINE;
+    } 
+    else 
+    {
+		/* todo - column and file name (should be set in translation unit) */
+        scan_coord.line = ls.ctok->line; 
+
+        if (STRING_TOKEN(ls.ctok->type))
+        {
+            /* NUMBER, NAME, STRING, CHAR
+             * here lexer does proper categorization for the lexeme
+             * it identifies number (integer or float), string/char literal, identifier
+             * the associated value of lexeme is stored in the literal pool,
+			 * for parser usage in next stage.
+            */
+			switch (ls.ctok->type)
+            {
+            case NUMBER :
+                {
+                    HCC_TRACE("number const : %s\n", ls.ctok->name); 
+                    retval = identify_numerical_value(ls.ctok->name);
+                    break;
+                }
+            case NAME:
+                {
+					retval = identify_keyword(ls.ctok->name);
+
+                    if (retval == TK_ID)
+                    {
+                        scan_value->string_value = lexeme_string(ls.ctok->name);
+
+                        HCC_TRACE("identifier: %s\n", scan_value->string_value);
+                    }
+                    else
+                    {
+                        HCC_TRACE("keyword: %s\n", ls.ctok->name);
+                    }
+
+                    break;
+                }
+            case STRING:
+                {
+                    HCC_TRACE("string const : %s\n", ls.ctok->name);
+
+                    /* 
+                     * left in ucpp token buffer, get_token concatenates adjacent pieces
+                     * and stores the literal once
+                     */
+                    scan_value->string_value = ls.ctok->name;
+                    retval = TK_CONST_STRING_LITERAL;
+                    break;
+                }
+            case CHAR:
+                {
+                    HCC_TRACE("char const : %s\n", ls.ctok->name);
+
+                    scan_value->string_value = lexeme_string(ls.ctok->name);
+                    retval = TK_CONST_CHAR_LITERAL;
+                    break;
+                }
+            }
+        }
+        else
+        {
+            retval = lexical_map[ls.ctok->type];
+			scan_value->string_value = lexeme_string(STRING_TOKEN(ls.ctok->type) ? ls.ctok->name
+                : operators_name[ls.ctok->type]);
+#ifdef HCC_TRACE_ENABLE
+            printf("line %ld: <%2d>  `%s'\n", ls.ctok->line,
+                ls.ctok->type,
+                STRING_TOKEN(ls.ctok->type) ? ls.ctok->name
+                : operators_name[ls.ctok->type]);
+#endif
+        }
+
+        /*
+        printf("line %ld: <%2d>  `%s'\n", ls.ctok->line,
+            ls.ctok->type,
+            STRING_TOKEN(ls.ctok->type) ? ls.ctok->name
+            : operators_name[ls.ctok->type]);
+        */
+    }
+
+    return retval;
+}
+
+/*
+ * scan next significant token into value and position
+ */
+static int scan_token(t_lexeme_value* value, t_coordinate* position)
+{
+    int token;
+
+    scan_value = value;
+
+    if (cached_token_code != TK_NULL)
+    {
+        token = cached_token_code;
+        cached_token_code = TK_NULL;
+        *value = cached_lexeme_value;
+        *position = cached_coord;
+        return token;
+    }
+
+    token = get_token_internal();
+
+    /* [TODO] - tabs (vertical and horizontal) and form feed needs? */
+    while (token == TK_NEWLINE ||
+        token == TK_CRETURN ||
+        token == TK_WHITESPACE ||
+        token == TK_POUND)
+    {
+        token = get_token_internal();
+        if (token == TK_END)
+        {
+            break;
+        }
+    }
+
+    *position = scan_coord;
+
+    /* [WORK AROUND] 
+     * work around ucpp can't concat string literals
+     * a better fix should be done in ucpp
+     */
+    if (token == TK_CONST_STRING_LITERAL)
+    {
+        literal_length = 0;
+
+        while (token == TK_CONST_STRING_LITERAL)
+        {
+            append_string_literal(value->string_value);
+
+            token = get_token_internal();
+            while (token == TK_NEWLINE ||
+                token == TK_CRETURN ||
+                token == TK_WHITESPACE)
+            {
+                token = get_token_internal();
+            }
+        }
+
+        cached_token_code = token;
+        cached_lexeme_value = *value;
+        cached_coord = scan_coord;
+
+        value->string_value = store_string_literal();
+
+        return TK_CONST_STRING_LITERAL;
+    }
+
+    return token;
+}
+
+static void* grow_array(void* array, int* capacity, int element_size)
+{
+    *capacity = *capacity ? *capacity * 2 : 1024;
+    array = realloc(array, *capacity * element_size);
+
+    if (!array)
+    {
+        exit(1);
+    }
+
+    return array;
+}
+
+static t_lexeme_handle add_lexeme_value(t_lexeme_value* value)
+{
+    if (lexeme_pool_count == lexeme_pool_capacity)
+    {
+        lexeme_pool = (t_lexeme_value*)grow_array(lexeme_pool, &lexeme_pool_capacity, sizeof(t_lexeme_value));
+    }
+
+    lexeme_pool[lexeme_pool_count] = *value;
+
+    return lexeme_pool_count ++;
+}
+
+static void reset_lexeme_pool()
+{
+    t_lexeme_value empty;
+
+    memset(&empty, 0, sizeof(empty));
+    memset(operator_handles, 0, sizeof(operator_handles));
+    memset(string_handle_cache, 0, sizeof(string_handle_cache));
+    lexeme_pool_count = 0;
+
+    /* entry 0 - value of keywords */
+    add_lexeme_value(&empty);
+}
+
+/*
+ * store the value of a scanned token in the literal pool
+ */
+static t_lexeme_handle intern_lexeme(int token, t_lexeme_value* value)
+{
+    if (token == TK_ID || token == TK_CONST_STRING_LITERAL || token == TK_CONST_CHAR_LITERAL)
+    {
+        unsigned int slot = (unsigned int)(((size_t)value->string_value >> 3) & (__HCC_STRING_HANDLE_CACHE_SIZE - 1));
+
+        if (string_handle_cache[slot].string != value->string_value)
+        {
+            string_handle_cache[slot].string = value->string_value;
+            string_handle_cache[slot].handle = add_lexeme_value(value);
+        }
+
+        return string_handle_cache[slot].handle;
+    }
+    else if (token >= TK_CONST_INTEGER && token <= TK_CONST_LONG_DOUBLE)
+    {
+        return add_lexeme_value(value);
+    }
+    else if (token >= TK_COMMA && token <= TK_ELLIPSE)
+    {
+        if (!operator_handles[token])
+        {
+            operator_handles[token] = add_lexeme_value(value);
+        }
+
+        return operator_handles[token];
+    }
+
+    return 0;
+}
+
+/*
+ * next token from the pipeline producer, or scanned on the spot
+ */
+static int next_token(t_lexeme_handle* handle, t_coordinate* position)
+{
+    t_lexeme_value value;
+    int token;
+
+    if (pipeline_thread)
+    {
+        token = receive_token(&value, position);
+    }
+    else
+    {
+        token = scan_token(&value, position);
+    }
+
+    *handle = intern_lexeme(token, &value);
+
+    return token;
+}
+
+int get_token()
+{
+    if (prelexed)
+    {
+        current_token_code = tu_kinds[tu_cursor];
+        lexeme_handle = tu_values[tu_cursor];
+        unpack_location(tu_cursor, &coord);
+
+        /* stay on TK_END which is always the last token */
+        if (tu_cursor < tu_count - 1)
+        {
+            tu_cursor ++;
+        }
+
+        return current_token_code;
+    }
+
+    if (ring_count > 0)
+    {
+        t_token_slot* slot = &token_ring[ring_head];
+
+        ring_head = (ring_head + 1) & (HCC_LOOKAHEAD - 1);
+        ring_count --;
+
+        current_token_code = slot->code;
+        lexeme_handle = slot->value;
+        coord = slot->coord;
+
+        return current_token_code;
+    }
+
+    current_token_code = next_token(&lexeme_handle, &coord);
+
+    return current_token_code;
+}
+
+int peek_token_at(int n)
+{
+    assert(n >= 1 && n <= HCC_LOOKAHEAD);
+
+    if (prelexed)
+    {
+        return tu_kinds[tu_cursor + n - 1 < tu_count ? tu_cursor + n - 1 : tu_count - 1];
+    }
+
+    while (ring_count < n)
+    {
+        t_token_slot* slot = &token_ring[(ring_head + ring_count) & (HCC_LOOKAHEAD - 1)];
+        t_token_slot* last = &token_ring[(ring_head + ring_count - 1) & (HCC_LOOKAHEAD - 1)];
+
+        if (ring_count > 0 && last->code == TK_END)
+        {
+            /* don't read past end of input */
+            *slot = *last;
+        }
+        else
+        {
+            slot->code = next_token(&slot->value, &slot->coord);
+        }
+
+        ring_count ++;
+    }
+
+    return token_ring[(ring_head + n - 1) & (HCC_LOOKAHEAD - 1)].code;
+}
+
+t_lexeme_handle peek_lexeme_at(int n)
+{
+    if (prelexed)
+    {
+        return tu_values[tu_cursor + n - 1 < tu_count ? tu_cursor + n - 1 : tu_count - 1];
+    }
+
+    peek_token_at(n);
+
+    return token_ring[(ring_head + n - 1) & (HCC_LOOKAHEAD - 1)].value;
+}
+
+int peek_token()
+{
+    return peek_token_at(1);
+}
+
+static unsigned int add_prelex_file(char* filename)
+{
+    int i = tu_file_count - 1;
+
+    /* consecutive tokens mostly come from the same file */
+    for (; i >= 0; i --)
+    {
+        if (tu_files[i] == filename)
+        {
+            return i;
+        }
+    }
+
+    if (tu_file_count == tu_file_capacity)
+    {
+        tu_files = (char**)grow_array(tu_files, &tu_file_capacity, sizeof(char*));
+    }
+
+    tu_files[tu_file_count] = filename;
+
+    return tu_file_count ++;
+}
+
+/*
+ * location of the token at index, which is the next one to be added
+ */
+static unsigned int pack_location(int index, unsigned int file, int line)
+{
+    t_far_location* far = NULL;
+
+    if (file < __HCC_LOCATION_FILE_LIMIT - 1 && line >= 0 && (unsigned long)line < __HCC_LOCATION_LINE_LIMIT)
+    {
+        return (unsigned int)__HCC_PACK_LOCATION(file, line);
+    }
+
+    /* doesn't fit in the bits, keep it aside */
+    if (tu_far_count == tu_far_capacity)
+    {
+        tu_far_locations = (t_far_location*)grow_array(tu_far_locations, &tu_far_capacity, sizeof(t_far_location));
+    }
+
+    far = &tu_far_locations[tu_far_count ++];
+    far->token = (unsigned int)index;
+    far->file = file;
+    far->line = line;
+
+    return (unsigned int)__HCC_LOCATION_FAR;
+}
+
+static void unpack_location(int index, t_coordinate* position)
+{
+    unsigned int location = tu_locations[index];
+    int low = 0;
+    int high = tu_far_count - 1;
+
+    if (location != __HCC_LOCATION_FAR)
+    {
+        position->filename = tu_files[__HCC_LOCATION_FILE(location)];
+        position->line = __HCC_LOCATION_LINE(location);
+        return;
+    }
+
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+
+        if (tu_far_locations[middle].token < (unsigned int)index)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    assert(tu_far_locations[low].token == (unsigned int)index);
+
+    position->filename = tu_files[tu_far_locations[low].file];
+    position->line = tu_far_locations[low].line;
+}
+
+void prelex_translation_unit()
+{
+    t_lexeme_handle value;
+    t_coordinate position;
+    unsigned int last_file = 0;
+    char* last_filename = NULL;
+    int token = TK_NULL;
+
+    /* already done behind a prefix header, see initialize_clexer */
+    if (prelexed)
+    {
+        return;
+    }
+
+    assert(ring_count == 0);
+
+    /* tu_count and tu_file_count are 0, or cover the tokens of the prefix header */
+    tu_cursor = 0;
+
+    while (token != TK_END)
+    {
+        token = next_token(&value, &position);
+
+        if (tu_count == tu_capacity)
+        {
+            tu_capacity = tu_capacity ? tu_capacity * 2 : 4096;
+            tu_kinds = (unsigned char*)realloc(tu_kinds, tu_capacity * sizeof(unsigned char));
+            tu_values = (unsigned int*)realloc(tu_values, tu_capacity * sizeof(unsigned int));
+            tu_locations = (unsigned int*)realloc(tu_locations, tu_capacity * sizeof(unsigned int));
+
+            if (!tu_kinds || !tu_values || !tu_locations)
+            {
+                exit(1);
+            }
+        }
+
+        assert(token >= 0 && token <= TK_NULL);
+
+        tu_kinds[tu_count] = (unsigned char)token;
+        tu_values[tu_count] = value;
+
+        if (position.filename != last_filename || tu_file_count == 0)
+        {
+            last_filename = position.filename;
+            last_file = add_prelex_file(last_filename);
+        }
+
+        tu_locations[tu_count] = pack_location(tu_count, last_file, position.line);
+        tu_count ++;
+    }
+
+    prelexed = 1;
+}
+
+int get_token_index()
+{
+    assert(prelexed);
+
+    return tu_cursor;
+}
+
+void reset_token_index(int index)
+{
+    assert(prelexed && index >= 0 && index < tu_count);
+
+    tu_cursor = index;
+}
+
+/*
+ * identifiers, string / char literals and operators carry a string lexeme value
+ */
+static int has_string_value(int token)
+{
+    return token == TK_ID || token == TK_CONST_STRING_LITERAL || token == TK_CONST_CHAR_LITERAL ||
+        (token >= TK_COMMA && token <= TK_ELLIPSE);
+}
 
-    assert(number);
-    assert(begin);
+static int copy_batch_text(t_token_batch* batch, char* text)
+{
+    int offset = batch->text_length;
+    int length = (int)strlen(text) + 1;
+
+    if (batch->text_length + length > batch->text_capacity)
+    {
+        while (batch->text_length + length > batch->text_capacity)
+        {
+            batch->text_capacity = batch->text_capacity ? batch->text_capacity * 2 : 4096;
+        }
+
+        batch->text = (char*)realloc(batch->text, batch->text_capacity);
+        if (!batch->text)
+        {
+            exit(1);
+        }
+    }
+
+    memcpy(batch->text + offset, text, length);
+    batch->text_length += length;
+
+    return offset;
+}
 
-    if ('.' == *number)
+static void pipeline_producer(void* arg)
+{
+    int token = TK_NULL;
+    unsigned long produced = 0;
+
+    (void)arg;
+
+    while (token != TK_END)
     {
-        number ++;
-        for (;;number ++)
+        t_token_batch* batch = NULL;
+
+        /* wait for a free batch */
+        while (produced - hcc_atomic_load(&pipeline_consumed) == HCC_PIPELINE_DEPTH)
         {
-            if (!HCC_ISDECIMAL_DIGIT(*number)) 
+            if (hcc_atomic_load(&pipeline_stop))
             {
-                break;
+                return;
             }
+
+            hcc_thread_yield();
+        }
+
+        batch = &pipeline_ring[produced & (HCC_PIPELINE_DEPTH - 1)];
+        batch->count = 0;
+        batch->text_length = 0;
+
+        while (batch->count < HCC_PIPELINE_BATCH_SIZE && token != TK_END)
+        {
+            t_token_record* record = &batch->tokens[batch->count ++];
+            t_coordinate position;
+
+            record->preprocessor_errors = 0;
+            record->diagnostic_count = 0;
+            scan_record = record;
+            token = scan_token(&record->value, &position);
+            scan_record = NULL;
+
+            record->code = token;
+            record->line = position.line;
+            record->filename = position.filename;
+            record->text = has_string_value(token) ? copy_batch_text(batch, record->value.string_value) : -1;
         }
+
+        /* publish the batch */
+        produced ++;
+        hcc_atomic_store(&pipeline_produced, produced);
     }
+}
 
-    if ('e' == *number || 'E' == *number)
+static int receive_token(t_lexeme_value* value, t_coordinate* position)
+{
+    t_token_batch* batch = &pipeline_ring[pipeline_consumed & (HCC_PIPELINE_DEPTH - 1)];
+    t_token_record* record = NULL;
+    int i = 0;
+
+    if (pipeline_cursor < 0 || pipeline_cursor == batch->count)
     {
-        number ++;
-        if ('+' == *number || '-' == *number)
+        unsigned long consumed = pipeline_consumed;
+
+        if (pipeline_cursor >= 0)
         {
-            number ++;
+            /* release consumed batch */
+            consumed ++;
+            hcc_atomic_store(&pipeline_consumed, consumed);
+            batch = &pipeline_ring[consumed & (HCC_PIPELINE_DEPTH - 1)];
         }
 
-        if (HCC_ISDECIMAL_DIGIT(*number))
+        while (hcc_atomic_load(&pipeline_produced) == consumed)
         {
-            for (;; number ++)
-            {
-                if (!HCC_ISDECIMAL_DIGIT(*number))
-                {
-                    break;
-                }
-            }
+            hcc_thread_yield();
+        }
+
+        pipeline_cursor = 0;
+    }
+
+    record = &batch->tokens[pipeline_cursor];
+
+    /* TK_END is the last token, it stays there */
+    if (record->code != TK_END)
+    {
+        pipeline_cursor ++;
+    }
+
+    /* diagnostics are reported once, when the token is first received */
+    for (; record->preprocessor_errors > 0; record->preprocessor_errors --)
+    {
+        preprocessor_error();
+    }
+
+    for (i = 0; i < record->diagnostic_count; i ++)
+    {
+        t_scan_diagnostic* diagnostic = &record->diagnostics[i];
+        t_coordinate at;
+
+        at.filename = diagnostic->filename;
+        at.line = (int)diagnostic->line;
+        at.column = 0;
+
+        if (diagnostic->error)
+        {
+            lexeme_error_at(diagnostic->message, &at);
         }
         else
         {
-            lexeme_error("incorrect float constant format detected!");
-            return 0;
+            warning_at(diagnostic->message, &at);
         }
     }
 
-// FIXME - better cross platform handling.
-#ifdef _WIN32
-    errno = 0;
-    value = strtod(begin, NULL);
-    if (errno == ERANGE)
+    record->diagnostic_count = 0;
+
+    *value = record->value;
+
+    if (record->text >= 0)
+    {
+        char* text = batch->text + record->text;
+
+        value->string_value = record->code == TK_CONST_STRING_LITERAL ?
+            store_literal(text, (int)strlen(text)) : atom_string(text);
+    }
+
+    if (record->filename != pipeline_filename_copy)
     {
-        warning("float value out of range!");
+        pipeline_filename_copy = record->filename;
+        pipeline_filename = atom_string(record->filename);
     }
-#else
-    if (!strtod(begin, NULL))
+
+    position->filename = pipeline_filename;
+    position->line = record->line;
+    position->column = 0;
+
+    return record->code;
+}
+
+/*
+ * start the producer thread; if it can't be started the lexer stays synchronous
+ */
+static void start_pipeline()
+{
+    pipeline_produced = pipeline_consumed = 0;
+    pipeline_stop = 0;
+    pipeline_cursor = -1;
+    pipeline_filename_copy = NULL;
+    pipeline_filename = NULL;
+
+    /* from now on scanner runs on producer thread only */
+    deferred_intern = 1;
+    scan_coord.filename = context_filename(scan_coord.filename);
+
+    pipeline_thread = hcc_thread_start(pipeline_producer, NULL);
+
+    if (!pipeline_thread)
+    {
+        deferred_intern = 0;
+        scan_coord.filename = coord.filename;
+    }
+}
+
+static void stop_pipeline()
+{
+    int i = 0;
+
+    if (pipeline_thread)
+    {
+        hcc_atomic_store(&pipeline_stop, 1);
+        hcc_thread_join(pipeline_thread);
+        pipeline_thread = NULL;
+    }
+
+    deferred_intern = 0;
+
+    for (i = 0; i < HCC_PIPELINE_DEPTH; i ++)
+    {
+        free(pipeline_ring[i].text);
+        pipeline_ring[i].text = NULL;
+        pipeline_ring[i].text_length = pipeline_ring[i].text_capacity = 0;
+    }
+
+    for (i = 0; i < pipeline_filename_count; i ++)
+    {
+        free(pipeline_filenames[i]);
+    }
+
+    free(pipeline_filenames);
+    pipeline_filenames = NULL;
+    pipeline_filename_count = pipeline_filename_capacity = 0;
+}
+
+/*
+ * binary token stream, see dump_translation_unit
+ * all integers are little endian:
+ *   "HTK3", file count, value count, token count, far location count, dependency count (u32 each)
+ *   files  - u32 length + name bytes
+ *   dependencies - u32 length + name bytes, u32 size, u32 mtime, u32 mtime nanoseconds
+ *   values - u8 tag + payload (string: u32 length + bytes, integer: u64, float: u32 bits, double: u64 bits)
+ *   tokens - u8 code array, u32 value handle array, u32 packed location array
+ *   far locations - u32 token index, u32 file index, u32 line
+ */
+#define __HCC_TOKEN_FILE_MAGIC "HTK3"
+
+enum
+{
+    TOKEN_VALUE_NONE,
+    TOKEN_VALUE_ATOM,
+    TOKEN_VALUE_LITERAL,
+    TOKEN_VALUE_INTEGER,
+    TOKEN_VALUE_FLOAT,
+    TOKEN_VALUE_DOUBLE
+};
+
+static int token_value_tag(int token)
+{
+    if (token == TK_CONST_STRING_LITERAL)
+    {
+        return TOKEN_VALUE_LITERAL;
+    }
+    else if (token == TK_CONST_FLOAT)
+    {
+        return TOKEN_VALUE_FLOAT;
+    }
+    else if (token == TK_CONST_DOUBLE || token == TK_CONST_LONG_DOUBLE)
+    {
+        return TOKEN_VALUE_DOUBLE;
+    }
+    else if (token >= TK_CONST_INTEGER && token <= TK_CONST_UNSIGNED_LONG_LONG)
+    {
+        return TOKEN_VALUE_INTEGER;
+    }
+    else if (has_string_value(token))
+    {
+        return TOKEN_VALUE_ATOM;
+    }
+
+    return TOKEN_VALUE_NONE;
+}
+
+static void put_u32(FILE* file, unsigned long value)
+{
+    putc((int)(value & 0xFF), file);
+    putc((int)((value >> 8) & 0xFF), file);
+    putc((int)((value >> 16) & 0xFF), file);
+    putc((int)((value >> 24) & 0xFF), file);
+}
+
+static void put_u64(FILE* file, unsigned long long value)
+{
+    put_u32(file, (unsigned long)(value & 0xFFFFFFFFUL));
+    put_u32(file, (unsigned long)(value >> 32));
+}
+
+static void put_string(FILE* file, char* string)
+{
+    size_t length = strlen(string);
+
+    put_u32(file, (unsigned long)length);
+    fwrite(string, 1, length, file);
+}
+
+static FILE* dependency_output;
+static unsigned long dependency_total;
+
+static void count_dependency(char* name)
+{
+    (void)name;
+    dependency_total ++;
+}
+
+static void put_dependency_stamp(char* name, struct file_stamp* stamp)
+{
+    put_string(dependency_output, name);
+    put_u32(dependency_output, stamp->size);
+    put_u32(dependency_output, stamp->mtime);
+    put_u32(dependency_output, stamp->mtime_nsec);
+}
+
+static void put_dependency(char* name)
+{
+    struct file_stamp stamp;
+
+    get_file_stamp(name, &stamp);
+    put_dependency_stamp(name, &stamp);
+}
+
+static int write_token_stream(FILE* file)
+{
+    unsigned char* tags = NULL;
+    int i = 0;
+
+    assert(prelexed);
+
+    /* a value may be shared by several tokens, all of them agree on its kind */
+    tags = (unsigned char*)calloc(lexeme_pool_count, sizeof(unsigned char));
+    if (!tags)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < tu_count; i ++)
+    {
+        if (!tags[tu_values[i]])
+        {
+            tags[tu_values[i]] = (unsigned char)token_value_tag(tu_kinds[i]);
+        }
+    }
+
+    fwrite(__HCC_TOKEN_FILE_MAGIC, 1, 4, file);
+    put_u32(file, tu_file_count);
+    put_u32(file, lexeme_pool_count);
+    put_u32(file, tu_count);
+    put_u32(file, tu_far_count);
+
+    /* those of a prefix header as they were loaded, then the files found by the preprocessor */
+    dependency_total = tu_dependency_count;
+    if (preprocessor_initialized)
+    {
+        scan_found_files(count_dependency);
+    }
+
+    put_u32(file, dependency_total);
+
+    for (i = 0; i < tu_file_count; i ++)
+    {
+        put_string(file, tu_files[i]);
+    }
+
+    dependency_output = file;
+
+    for (i = 0; i < tu_dependency_count; i ++)
+    {
+        put_dependency_stamp(tu_dependencies[i].name, &tu_dependencies[i].stamp);
+    }
+
+    if (preprocessor_initialized)
+    {
+        scan_found_files(put_dependency);
+    }
+
+    for (i = 0; i < lexeme_pool_count; i ++)
+    {
+        t_lexeme_value* value = &lexeme_pool[i];
+        double d = 0;
+        unsigned long long bits = 0;
+        float f = 0;
+        unsigned long fbits = 0;
+
+        putc(tags[i], file);
+
+        switch (tags[i])
+        {
+        case TOKEN_VALUE_ATOM:
+        case TOKEN_VALUE_LITERAL:
+            put_string(file, value->string_value);
+            break;
+        case TOKEN_VALUE_INTEGER:
+            put_u64(file, value->integer_value);
+            break;
+        case TOKEN_VALUE_FLOAT:
+            f = value->float_value;
+            memcpy(&fbits, &f, sizeof(f));
+            put_u32(file, fbits);
+            break;
+        case TOKEN_VALUE_DOUBLE:
+            /* constants are converted at double precision, nothing is lost here */
+            d = (double)value->double_value;
+            memcpy(&bits, &d, sizeof(d));
+            put_u64(file, bits);
+            break;
+        }
+    }
+
+    fwrite(tu_kinds, 1, tu_count, file);
+
+    for (i = 0; i < tu_count; i ++)
+    {
+        put_u32(file, tu_values[i]);
+    }
+
+    for (i = 0; i < tu_count; i ++)
+    {
+        put_u32(file, tu_locations[i]);
+    }
+
+    for (i = 0; i < tu_far_count; i ++)
+    {
+        put_u32(file, tu_far_locations[i].token);
+        put_u32(file, tu_far_locations[i].file);
+        put_u32(file, (unsigned long)tu_far_locations[i].line);
+    }
+
+    free(tags);
+
+    return ferror(file) ? -1 : 0;
+}
+
+int dump_translation_unit(const char* filename)
+{
+    FILE* file = fopen(filename, "wb");
+    int result = 0;
+
+    if (!file)
+    {
+        return -1;
+    }
+
+    result = write_token_stream(file);
+
+    return (fclose(file) || result) ? -1 : 0;
+}
+
+/*
+ * bounds checked reader over the loaded token file
+ */
+typedef struct token_file_reader
+{
+    unsigned char* cursor;
+    unsigned char* end;
+    int failed;
+} t_token_file_reader;
+
+static unsigned char* get_bytes(t_token_file_reader* reader, unsigned long length)
+{
+    unsigned char* bytes = reader->cursor;
+
+    if (reader->failed || (unsigned long)(reader->end - reader->cursor) < length)
+    {
+        reader->failed = 1;
+        return NULL;
+    }
+
+    reader->cursor += length;
+
+    return bytes;
+}
+
+static unsigned long get_u32(t_token_file_reader* reader)
+{
+    unsigned char* b = get_bytes(reader, 4);
+
+    if (!b)
+    {
+        return 0;
+    }
+
+    return (unsigned long)b[0] | ((unsigned long)b[1] << 8) | ((unsigned long)b[2] << 16) | ((unsigned long)b[3] << 24);
+}
+
+static unsigned long long get_u64(t_token_file_reader* reader)
+{
+    unsigned long long low = get_u32(reader);
+
+    return low | ((unsigned long long)get_u32(reader) << 32);
+}
+
+static char* get_string(t_token_file_reader* reader, int literal)
+{
+    unsigned long length = get_u32(reader);
+    char* bytes = (char*)get_bytes(reader, length);
+
+    if (!bytes)
+    {
+        return NULL;
+    }
+
+    return literal ? store_literal(bytes, (int)length) : atom_string_number(bytes, (int)length);
+}
+
+/*
+ * whether a value loaded with tag can be read by a token of this kind: a string for identifiers,
+ * literals and operators, the number of the same type for constants
+ */
+static int value_fits_token(int tag, int token)
+{
+    int expected = token_value_tag(token);
+
+    if (expected == TOKEN_VALUE_ATOM || expected == TOKEN_VALUE_LITERAL)
+    {
+        return tag == TOKEN_VALUE_ATOM || tag == TOKEN_VALUE_LITERAL;
+    }
+
+    return expected == TOKEN_VALUE_NONE || tag == expected;
+}
+
+static int read_token_file(t_token_file_reader* reader, unsigned char** tags)
+{
+    unsigned long file_count;
+    unsigned long value_count;
+    unsigned long token_count;
+    unsigned long far_count;
+    unsigned long dependency_count;
+    unsigned char* kinds;
+    unsigned long i;
+    unsigned long j;
+
+    if (!get_bytes(reader, 4) || memcmp(reader->cursor - 4, __HCC_TOKEN_FILE_MAGIC, 4))
+    {
+        return -1;
+    }
+
+    file_count = get_u32(reader);
+    value_count = get_u32(reader);
+    token_count = get_u32(reader);
+    far_count = get_u32(reader);
+    dependency_count = get_u32(reader);
+
+    /* every count is bounded by the file size, which keeps the allocations sane */
+    if (reader->failed || file_count > (unsigned long)(reader->end - reader->cursor) ||
+        value_count > (unsigned long)(reader->end - reader->cursor) ||
+        token_count == 0 || token_count > (unsigned long)(reader->end - reader->cursor) ||
+        far_count > token_count || dependency_count > (unsigned long)(reader->end - reader->cursor))
+    {
+        return -1;
+    }
+
+    tu_files = (char**)malloc(file_count * sizeof(char*) + 1);
+    tu_kinds = (unsigned char*)malloc(token_count * sizeof(unsigned char));
+    tu_values = (unsigned int*)malloc(token_count * sizeof(unsigned int));
+    tu_locations = (unsigned int*)malloc(token_count * sizeof(unsigned int));
+    tu_far_locations = (t_far_location*)malloc(far_count * sizeof(t_far_location) + 1);
+    tu_dependencies = (t_file_dependency*)malloc(dependency_count * sizeof(t_file_dependency) + 1);
+    *tags = (unsigned char*)malloc(value_count + 1);
+    if (!tu_files || !tu_kinds || !tu_values || !tu_locations || !tu_far_locations || !tu_dependencies || !*tags)
+    {
+        exit(1);
+    }
+
+    tu_file_capacity = (int)file_count;
+    tu_capacity = (int)token_count;
+    tu_far_capacity = (int)far_count;
+
+    for (i = 0; i < file_count && !reader->failed; i ++)
+    {
+        tu_files[tu_file_count ++] = get_string(reader, 0);
+    }
+
+    for (i = 0; i < dependency_count && !reader->failed; i ++)
+    {
+        t_file_dependency* dependency = &tu_dependencies[tu_dependency_count ++];
+
+        dependency->name = get_string(reader, 0);
+        dependency->stamp.size = get_u32(reader);
+        dependency->stamp.mtime = get_u32(reader);
+        dependency->stamp.mtime_nsec = get_u32(reader);
+    }
+
+    lexeme_pool_count = 0;
+    for (i = 0; i < value_count && !reader->failed; i ++)
     {
-        warning("float value out of range!");
+        t_lexeme_value value;
+        unsigned char* tag = get_bytes(reader, 1);
+        unsigned long long bits = 0;
+        unsigned long fbits = 0;
+        double d = 0;
+
+        memset(&value, 0, sizeof(value));
+        (*tags)[i] = tag ? *tag : TOKEN_VALUE_NONE;
+
+        switch ((*tags)[i])
+        {
+        case TOKEN_VALUE_NONE:
+            break;
+        case TOKEN_VALUE_ATOM:
+        case TOKEN_VALUE_LITERAL:
+            value.string_value = get_string(reader, *tag == TOKEN_VALUE_LITERAL);
+            break;
+        case TOKEN_VALUE_INTEGER:
+            value.integer_value = get_u64(reader);
+            break;
+        case TOKEN_VALUE_FLOAT:
+            fbits = get_u32(reader);
+            memcpy(&value.float_value, &fbits, sizeof(value.float_value));
+            break;
+        case TOKEN_VALUE_DOUBLE:
+            bits = get_u64(reader);
+            memcpy(&d, &bits, sizeof(d));
+            value.double_value = d;
+            break;
+        default:
+            return -1;
+        }
+
+        add_lexeme_value(&value);
     }
-#endif
 
-#ifdef HCC_TRACE_ENABLE
-    fprintf(stderr, "float value %f\n", value);
-#endif
+    kinds = get_bytes(reader, token_count);
+    if (!kinds)
+    {
+        return -1;
+    }
 
-    lexeme_value.double_value = value;
+    memcpy(tu_kinds, kinds, token_count);
 
-    if (*number == 'f' || *number == 'F')
+    for (i = 0; i < token_count; i ++)
     {
-        lexeme_value.float_value = (float)value;    
+        tu_values[i] = (unsigned int)get_u32(reader);
     }
-    else if (*number == 'l' || *number == 'L')
+
+    for (i = 0; i < token_count; i ++)
     {
-        return_val = TK_CONST_LONG_DOUBLE;
+        tu_locations[i] = (unsigned int)get_u32(reader);
     }
-    else
+
+    for (i = 0; i < far_count; i ++)
     {
-        return_val = TK_CONST_DOUBLE;
+        tu_far_locations[i].token = (unsigned int)get_u32(reader);
+        tu_far_locations[i].file = (unsigned int)get_u32(reader);
+        tu_far_locations[i].line = (int)get_u32(reader);
     }
 
-    return return_val;
-}
-
-static int identify_numerical_value(char* number)
-{
-    int base = 10;
-    char* begin = number;
+    tu_count = (int)token_count;
+    tu_far_count = (int)far_count;
 
-    assert(number);
-    
-    if ('.' == *number)
+    if (reader->failed || reader->cursor != reader->end || tu_kinds[tu_count - 1] != TK_END)
     {
-        return identify_float_value(number, number);
+        return -1;
     }
 
-	/*
-     * [TODO] - here we need to verify the valid suffixes
-     * ul, UL, uL, Ul. and detect invalid hex number, oct number, and decimal number
-     * currently number like 0xXYZ will survive the crossfire which is not right
-	 */
-    if ('0' == *number && 
-        ('x' == number[1] ||
-         'X' == number[1]))
+    /* far locations belong, in order, to the tokens marked as far */
+    for (i = 0, j = 0; i < token_count; i ++)
     {
-        base = 16;
-        begin += 2;
-        number += 2;
-
-        while (HCC_ISHEX_DIGIT(*number))
+        if (tu_kinds[i] > TK_NULL || tu_values[i] >= value_count || !value_fits_token((*tags)[tu_values[i]], tu_kinds[i]))
         {
-            number ++;
+            return -1;
         }
-    }
-    else if ('0' == *number)
-    {
-        base = 8;
-        begin ++;
-        number ++;
 
-        while (HCC_ISOCT_DIGIT(*number))
+        if (tu_locations[i] != __HCC_LOCATION_FAR)
         {
-            number ++;
+            if (__HCC_LOCATION_FILE(tu_locations[i]) >= file_count)
+            {
+                return -1;
+            }
         }
-    }
-    else
-    {
-        number ++;
-        while (HCC_ISDECIMAL_DIGIT(*number))
+        else if (j == far_count || tu_far_locations[j].token != i || tu_far_locations[j ++].file >= file_count)
         {
-            number ++;
+            return -1;
         }
     }
 
-    if (base == 16 || (*number != '.' && *number != 'e' && *number != 'E'))
+    return j == far_count ? 0 : -1;
+}
+
+static int load_token_file(t_token_file_reader* reader)
+{
+    unsigned char* tags = NULL;
+    int result = read_token_file(reader, &tags);
+
+    free(tags);
+
+    return result;
+}
+
+/*
+ * whole contents of a file, NULL if it can't be read or is empty
+ */
+static unsigned char* read_whole_file(const char* filename, long* size)
+{
+    unsigned char* buffer = NULL;
+    FILE* file = fopen(filename, "rb");
+
+    if (!file)
     {
-        return identify_integer_value(begin, (int)(number - begin), base); 
+        return NULL;
     }
-    else
+
+    if (fseek(file, 0, SEEK_END) == 0 && (*size = ftell(file)) > 0 && fseek(file, 0, SEEK_SET) == 0)
     {
-        return identify_float_value(number, begin);
+        buffer = (unsigned char*)malloc(*size);
+        if (buffer && fread(buffer, 1, *size, file) != (size_t)*size)
+        {
+            free(buffer);
+            buffer = NULL;
+        }
     }
-}
 
+    fclose(file);
 
-static int get_token_internal()
+    return buffer;
+}
+
+/*
+ * whether a file still has the stamp recorded in a token file, which keeps the low 32 bits of each word
+ */
+static int same_file_stamp(t_file_dependency* dependency)
 {
-    int retval;
-    int r;
+    struct file_stamp stamp;
 
-    /*
-	 * This is the trick to implement the backup - restore feature such that
-     * lexer provides its caller the capability to peek a token (without consume).
-     */
-	if (peek_token_code != TK_NULL)
-	{
-        /*
-         * none NULL peek token indicates previously the peek_token is invoked.
-         * so we just return the cached peek token and restore the clexer state to 
-         * what it should be. 
-         */
-        current_token_code = peek_token_code;
-		peek_token_code = TK_NULL;
-        lexeme_value = peek_lexeme_value;
-        return current_token_code;
-	}
+    return !get_file_stamp(dependency->name, &stamp) &&
+        (stamp.size & 0xFFFFFFFFUL) == dependency->stamp.size &&
+        (stamp.mtime & 0xFFFFFFFFUL) == dependency->stamp.mtime &&
+        stamp.mtime_nsec == dependency->stamp.mtime_nsec;
+}
 
-    retval = TK_ID;
+int replay_translation_unit(const char* filename)
+{
+    t_token_file_reader reader;
+    unsigned char* buffer = NULL;
+    long size = 0;
+    int result = -1;
+    int i = 0;
 
-    r = lex(&ls);
+    current_token_code = TK_NULL;
+    cached_token_code = TK_NULL;
+    ring_head = ring_count = 0;
+    reset_lexeme_pool();
 
-    /*
-    * lex() reads the next token from the processed stream and stores it
-    * into ls->ctok.
-    * return value: non zero on error (including CPPERR_EOF, which is not
-    * quite an error)
-    */
-    if (r == CPPERR_EOF)
+    buffer = read_whole_file(filename, &size);
+    if (!buffer)
     {
-        return TK_END;
+        return -1;
     }
-    else if (r)
+
+    reader.cursor = buffer;
+    reader.end = buffer + size;
+    reader.failed = 0;
+
+    result = load_token_file(&reader);
+
+    free(buffer);
+
+    /* out of date once a file it was lexed from changed */
+    for (i = 0; i < tu_dependency_count && !result; i ++)
     {
-        /*TODO*/ 
-        assert(0); 
+        if (!same_file_stamp(&tu_dependencies[i]))
+        {
+            result = -1;
+        }
     }
-	
-    
-    /* we print each token: its numerical value, and its
-    string content; if this is a PRAGMA token, the
-    string content is in fact a compressed token list,
-    that we uncompress and print. */
-    if (ls.ctok->type == PRAGMA) 
+
+    if (result)
     {
-        unsigned char *c = (unsigned char *)(ls.ctok->name);
+        free_clexer();
+        return -1;
+    }
 
-#ifdef HCC_TRACE_ENABLE
-       printf("line %ld: <#pragma>\n", ls.line); 
-#endif
+    unpack_location(0, &coord);
+    coord.column = 0;
+    coord.line = 0;
+    tu_cursor = 0;
+    prelexed = 1;
 
-        for (; *c; c ++) 
-        {
-            int t = *c;
+    return 0;
+}
 
-            if (STRING_TOKEN(t)) 
-            {
-            #ifdef HCC_TRACE_ENABLE
-                printf("  <%2d>  ", t);
-            #endif
+/*
+ * precompiled prefix header
+ * the image <prefix header>.hph is written the first time the prefix header is needed, and
+ * rewritten when it is out of date. after its magic, it holds:
+ *   include path - u32 count, then u32 length + bytes for each directory
+ *   state of the preprocessor at the end of the prefix header, see write_cpp_state in ucpp
+ *   tokens of the prefix header, in the token file format (see dump_translation_unit)
+ */
+#define __HCC_PREFIX_FILE_MAGIC "HPH1"
 
-                for (c ++; *c != PRAGMA_TOKEN_END; c ++)
-                {
-            #ifdef HCC_TRACE_ENABLE
-                    putchar(*c);
-                    putchar('\n');
-            #endif
-                }
-            } 
-            else 
-            {
-            #ifdef HCC_TRACE_ENABLE
-                printf("  <%2d>  `%s'\n", t,
-                    operators_name[t]);
-            #endif
-            }
-        }
+static unsigned char* prefix_image = NULL;
+static long prefix_image_size = 0;
+static long prefix_state_offset = 0;
+static long prefix_token_offset = 0;
 
-        retval = TK_POUND;
-    } 
-    else if (ls.ctok->type == CONTEXT) 
+static int prefix_image_name(char* name, size_t size)
+{
+    if (strlen(g_prefix_header) + 5 > size)
     {
-#ifdef HCC_TRACE_ENABLE
-        printf("new context: file '%s', line %ld\n",
-            ls.ctok->name, ls.ctok->line);
-#endif
-        
-        coord.filename = atom_string(ls.ctok->name);
-        coord.line = ls.ctok->line;
+        return -1;
+    }
 
-		/* HACK! TODO */
-        retval = TK_WHITESPACE;
-    } 
-    else if (ls.ctok->type == NEWLINE) 
-    {
-#ifdef HCC_TRACE_ENABLE
-        printf("[newline]\n");
-#endif
+    sprintf(name, "%s.hph", g_prefix_header);
 
-        retval = TK_NEWLINE;
-    } 
-    else 
-    {
-		/* todo - column and file name (should be set in translation unit) */
-        coord.line = ls.ctok->line; 
+    return 0;
+}
 
-        if (STRING_TOKEN(ls.ctok->type))
-        {
-            /* NUMBER, NAME, STRING, CHAR
-             * here lexer does proper categorization for the lexeme
-             * it identifies number (integer or float), string/char literal, identifier
-             * the associated value of lexeme is stored in lexeme_value, 
-			 * for parser usage in next stage.
-            */
-			switch (ls.ctok->type)
-            {
-            case NUMBER :
-                {
-                    HCC_TRACE("number const : %s\n", ls.ctok->name); 
-                    retval = identify_numerical_value(ls.ctok->name);
-                    break;
-                }
-            case NAME:
-                {
-					retval = identify_keyword(ls.ctok->name);
+static int build_prefix_header(t_scanner_context* sc, const char* image)
+{
+    t_scanner_context prefix_sc = *sc;
+    char* prefix = g_prefix_header;
+    int pipeline = g_pipeline_lexer;
+    FILE* file = NULL;
+    int result = -1;
+    int i = 0;
 
-                    if (retval == TK_ID)
-                    {
-                        lexeme_value.string_value = atom_string(ls.ctok->name);
+    /* the prefix header is preprocessed alone, as a translation unit of its own */
+    prefix_sc.filename = prefix;
+    g_prefix_header = NULL;
+    g_pipeline_lexer = 0;
 
-                        HCC_TRACE("identifier: %s\n", lexeme_value.string_value);
-                    }
-                    else
-                    {
-                        HCC_TRACE("keyword: %s\n", ls.ctok->name);
-                    }
+    initialize_clexer(&prefix_sc);
+    prelex_translation_unit();
 
-                    break;
-                }
-            case STRING:
-                {
-                    HCC_TRACE("string const : %s\n", ls.ctok->name);
+    g_prefix_header = prefix;
+    g_pipeline_lexer = pipeline;
 
-                    lexeme_value.string_value = atom_string(ls.ctok->name);
-                    retval = TK_CONST_STRING_LITERAL;
-                    break;
-                }
-            case CHAR:
-                {
-                    HCC_TRACE("char const : %s\n", ls.ctok->name);
+    file = fopen(image, "wb");
+    if (file)
+    {
+        fwrite(__HCC_PREFIX_FILE_MAGIC, 1, 4, file);
+        put_u32(file, sc->number_of_include_pathes);
 
-                    lexeme_value.string_value = atom_string(ls.ctok->name);
-                    retval = TK_CONST_CHAR_LITERAL;
-                    break;
-                }
-            }
-        }
-        else
+        for (i = 0; i < sc->number_of_include_pathes; i ++)
         {
-            retval = lexical_map[ls.ctok->type];
-			lexeme_value.string_value = atom_string(STRING_TOKEN(ls.ctok->type) ? ls.ctok->name
-                : operators_name[ls.ctok->type]);
-#ifdef HCC_TRACE_ENABLE
-            printf("line %ld: <%2d>  `%s'\n", ls.ctok->line,
-                ls.ctok->type,
-                STRING_TOKEN(ls.ctok->type) ? ls.ctok->name
-                : operators_name[ls.ctok->type]);
-#endif
+            put_string(file, sc->include_pathes[i]);
         }
 
-        /*
-        printf("line %ld: <%2d>  `%s'\n", ls.ctok->line,
-            ls.ctok->type,
-            STRING_TOKEN(ls.ctok->type) ? ls.ctok->name
-            : operators_name[ls.ctok->type]);
-        */
+        result = (write_cpp_state(file) || write_token_stream(file)) ? -1 : 0;
+
+        if (fclose(file))
+        {
+            result = -1;
+        }
     }
 
-	current_token_code = retval;
-    return retval;
+    free_clexer();
+
+    return result;
 }
 
-int get_token()
+/*
+ * read the image and check that it is still valid for this translation unit, without touching
+ * the preprocessor; tokens of the prefix header are loaded in the token buffer
+ */
+static int open_prefix_header(t_scanner_context* sc, const char* image)
 {
-    int token;
+    t_token_file_reader reader;
+    long state = 0;
+    int i = 0;
 
-    if (cached_token_code != TK_NULL)
+    prefix_image = read_whole_file(image, &prefix_image_size);
+    if (!prefix_image)
     {
-        current_token_code = cached_token_code;
-        cached_token_code = TK_NULL;
-        lexeme_value = cached_lexeme_value;
-        return current_token_code;
+        return -1;
     }
 
-    token = get_token_internal();
+    reader.cursor = prefix_image;
+    reader.end = prefix_image + prefix_image_size;
+    reader.failed = 0;
 
-    /* [TODO] - tabs (vertical and horizontal) and form feed needs? */
-    while (token == TK_NEWLINE ||
-        token == TK_CRETURN ||
-        token == TK_WHITESPACE ||
-        token == TK_POUND)
+    if (!get_bytes(&reader, 4) || memcmp(prefix_image, __HCC_PREFIX_FILE_MAGIC, 4) ||
+        get_u32(&reader) != (unsigned long)sc->number_of_include_pathes)
     {
-        token = get_token_internal();
-        if (token == TK_END)
-        {
-            return token;
-        }
+        reader.failed = 1;
     }
 
-    /* [WORK AROUND] 
-     * work around ucpp can't concat string literals
-     * a better fix should be done in ucpp
-     */
-    while (token == TK_CONST_STRING_LITERAL)
+    for (i = 0; i < sc->number_of_include_pathes && !reader.failed; i ++)
     {
-        cached_token_code = token;
-        cached_lexeme_value = lexeme_value;
+        unsigned long length = get_u32(&reader);
+        unsigned char* path = get_bytes(&reader, length);
 
-        token = get_token_internal();
-        while (token == TK_NEWLINE ||
-            token == TK_CRETURN ||
-            token == TK_WHITESPACE)
+        if (!path || length != strlen(sc->include_pathes[i]) || memcmp(path, sc->include_pathes[i], length))
         {
-            token = get_token_internal();
+            reader.failed = 1;
         }
+    }
 
-        if (token == TK_CONST_STRING_LITERAL)
-        {
-            char* tmp = (char*)malloc(strlen(cached_lexeme_value.string_value) + strlen(lexeme_value.string_value) + 1);
-            
-            strcpy(tmp, cached_lexeme_value.string_value);
-            strcat(tmp, lexeme_value.string_value);
-            
-            lexeme_value.string_value = atom_string(tmp);
-            free(tmp);
-        }
-        else
+    if (!reader.failed)
+    {
+        state = read_cpp_state(reader.cursor, reader.end - reader.cursor, 0);
+    }
+
+    if (!reader.failed && state >= 0)
+    {
+        prefix_state_offset = (long)(reader.cursor - prefix_image);
+        prefix_token_offset = prefix_state_offset + state;
+
+        reader.cursor = prefix_image + prefix_token_offset;
+        reset_lexeme_pool();
+        if (load_token_file(&reader))
         {
-            cached_token_code = token;
-            cached_lexeme_value = lexeme_value;
-            return TK_CONST_STRING_LITERAL;
+            free_token_buffer();
+            reader.failed = 1;
         }
     }
 
-    return token;
+    if (reader.failed || state < 0)
+    {
+        free(prefix_image);
+        prefix_image = NULL;
+        return -1;
+    }
+
+    return 0;
 }
 
-int peek_token()
+static int prepare_prefix_header(t_scanner_context* sc)
 {
-    /* [TODO] token coordinate value save and restore */
-	int backup_token = current_token_code;
-    t_lexeme_value backup_lexeme_value = lexeme_value;
+    char image[FILENAME_MAX];
+
+    if (prefix_image_name(image, sizeof(image)))
+    {
+        return -1;
+    }
 
-	peek_token_code = get_token();
-    peek_lexeme_value = lexeme_value;
+    if (open_prefix_header(sc, image) && (build_prefix_header(sc, image) || open_prefix_header(sc, image)))
+    {
+        fprintf(stderr, "%s: can't build prefix header image %s\n", g_prefix_header, image);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * the state of the preprocessor comes from the image, as if the file had included the prefix
+ * header first; the file is then pre-lexed after the tokens loaded by open_prefix_header
+ */
+static void apply_prefix_header()
+{
+    /* both sections were checked by open_prefix_header */
+    read_cpp_state(prefix_image + prefix_state_offset, prefix_token_offset - prefix_state_offset, 1);
 
-	current_token_code = backup_token;
-    lexeme_value = backup_lexeme_value;
+    /* drop TK_END of the prefix header */
+    tu_count --;
 
-	return peek_token_code;
+    free(prefix_image);
+    prefix_image = NULL;
 }
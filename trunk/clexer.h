@@ -59,19 +59,25 @@ typedef union lexeme_value
 } t_lexeme_value;
 
 /*
- * lexeme value of current lexer token
+ * handle of a token value in the literal pool of the translation unit
+ * handles stay valid until free_clexer, pointers returned by HCC_LEXEME only until the next
+ * token is scanned (the pool may grow)
  */
-extern t_lexeme_value lexeme_value;
+typedef unsigned int t_lexeme_handle;
+
+extern t_lexeme_value* lexeme_pool;
+
+#define HCC_LEXEME(handle) (&lexeme_pool[handle])
 
 /*
- * lexeme value of peeked lexer token
+ * lexeme value handle of current lexer token
  */
-extern t_lexeme_value peek_lexeme_value;
+extern t_lexeme_handle lexeme_handle;
 
 /*
- * lexeme value of cached token
+ * string value of current lexer token (identifiers, string / char literals and operators)
  */
-extern t_lexeme_value cached_lexeme_value;
+#define HCC_LEXEME_STRING() (lexeme_pool[lexeme_handle].string_value)
 
 /*
  * current token coordinate (file, line, column)
@@ -82,15 +88,60 @@ extern t_coordinate coord;
 /* get next token from lexer and consume it */
 int get_token();
 
+/*
+ * number of tokens the lexer can look ahead (power of 2)
+ */
+#define HCC_LOOKAHEAD 4
+
 /*
  * peek next token but doesn't consume it (so lexer's internal state is kept intact in this case.. comparing with get_token)
- * there is a twist here - peek token can't be invoked straight many times
- * the invokation should be interleaved with get_token to clean up the peek status
- * an alternative is to explicit clean up peek status by caller but since it's LL(1)
- * there is no need to do so for now..
+ * same as peek_token_at(1)
 */
 int peek_token();
 
+/*
+ * peek the n-th token after current token (1 <= n <= HCC_LOOKAHEAD) without consuming it
+ * peeked tokens are kept in a ring buffer so peeks can be repeated and interleaved freely with get_token
+ */
+int peek_token_at(int n);
+
+/*
+ * lexeme value handle of the n-th token after current token
+ */
+t_lexeme_handle peek_lexeme_at(int n);
+
+/*
+ * preprocess and lex the whole translation unit into a token buffer before parsing
+ * (called right after initialize_clexer); get_token and peek_token then walk the buffer by index.
+ * the buffer keeps token codes as bytes, literal pool handles and packed file/line locations.
+ */
+void prelex_translation_unit();
+
+/*
+ * index of the next token get_token returns - pre-lexed translation unit only
+ */
+int get_token_index();
+
+/*
+ * backtrack (or skip forward) to a token index returned by get_token_index,
+ * the next get_token returns that token again - pre-lexed translation unit only
+ */
+void reset_token_index(int index);
+
+/*
+ * write the pre-lexed translation unit - the exact token sequence get_token returns, with
+ * values and locations - to a compact binary token file. returns 0 on success
+ */
+int dump_translation_unit(const char* filename);
+
+/*
+ * set up the lexer from a token file written by dump_translation_unit without running the
+ * preprocessor (called instead of initialize_clexer, free_clexer still applies); get_token and
+ * peek_token then replay the token sequence. returns 0 on success, the file is rejected if it
+ * is malformed or truncated, or out of date: a file it was lexed from changed size or modification time
+ */
+int replay_translation_unit(const char* filename);
+
 /*
  * reset scanner to prepare for compiling next file
  * this method will initialize internal preprocessor and lexer (currently using ucpp)
@@ -103,4 +154,10 @@ void initialize_clexer(t_scanner_context* sc);
  */
 void free_clexer();
 
+/*
+ * release what the lexer keeps across translation units (include lookup cache),
+ * called once after the last translation unit of the session
+ */
+void finalize_clexer();
+
 #endif
\ No newline at end of file
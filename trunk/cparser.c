@@ -413,13 +413,14 @@ t_ast_exp* primary_expression()
 {
     t_ast_exp* exp = NULL;
     t_ast_exp_val exp_val;
+    t_lexeme_value* lexeme = HCC_LEXEME(lexeme_handle);
     memset(&exp_val, 0, sizeof(exp_val));
 
     switch (cptk)
     {
     case TK_ID :
         {
-            exp = make_ast_id_exp(lexeme_value.string_value);
+            exp = make_ast_id_exp(lexeme->string_value);
 			BINDING_COORDINATE(exp, coord);
 
             GET_NEXT_TOKEN;
@@ -428,7 +429,7 @@ t_ast_exp* primary_expression()
     case TK_CONST_INTEGER :
     case TK_CONST_CHAR_LITERAL :
         {
-            exp_val.i = (int)lexeme_value.integer_value;
+            exp_val.i = (int)lexeme->integer_value;
             exp = make_ast_const_exp(exp_val, AST_EXP_CONST_INTEGER_KIND);
 			BINDING_COORDINATE(exp, coord);
 
@@ -437,7 +438,7 @@ t_ast_exp* primary_expression()
         }
     case TK_CONST_FLOAT :
         {
-            exp_val.f = lexeme_value.float_value;
+            exp_val.f = lexeme->float_value;
             exp = make_ast_const_exp(exp_val, AST_EXP_CONST_FLOAT_KIND);
 			BINDING_COORDINATE(exp, coord);
             
@@ -446,7 +447,7 @@ t_ast_exp* primary_expression()
         }
     case TK_CONST_DOUBLE :
         {
-            exp_val.d = (double)lexeme_value.double_value;
+            exp_val.d = (double)lexeme->double_value;
             exp = make_ast_const_exp(exp_val, AST_EXP_CONST_DOUBLE_KIND);
 			BINDING_COORDINATE(exp, coord);
             
@@ -455,7 +456,7 @@ t_ast_exp* primary_expression()
         }
     case TK_CONST_LONG_DOUBLE :
         {
-            exp_val.ld = lexeme_value.double_value;
+            exp_val.ld = lexeme->double_value;
             exp = make_ast_const_exp(exp_val, AST_EXP_CONST_LONG_DOUBLE_KIND);
 			BINDING_COORDINATE(exp, coord);
             
@@ -464,7 +465,7 @@ t_ast_exp* primary_expression()
         }
 	case TK_CONST_LONG_INTEGER :
         {
-            exp_val.l = (long)lexeme_value.integer_value;
+            exp_val.l = (long)lexeme->integer_value;
             exp = make_ast_const_exp(exp_val, AST_EXP_CONST_LONG_INTEGER_KIND);
 			BINDING_COORDINATE(exp, coord);
             
@@ -473,7 +474,7 @@ t_ast_exp* primary_expression()
         }
 	case TK_CONST_LONG_LONG :
         {
-			exp_val.ll = (long long)lexeme_value.integer_value;
+			exp_val.ll = (long long)lexeme->integer_value;
             exp = make_ast_const_exp(exp_val, AST_EXP_CONST_LONG_LONG_KIND);
 			BINDING_COORDINATE(exp, coord);
             
@@ -482,7 +483,7 @@ t_ast_exp* primary_expression()
         }
 	case TK_CONST_UNSIGNED_INTEGER :
         {
-            exp_val.ui = (unsigned int)lexeme_value.integer_value;
+            exp_val.ui = (unsigned int)lexeme->integer_value;
             exp = make_ast_const_exp(exp_val, AST_EXP_CONST_UNSIGNED_INTEGER_KIND);
 			BINDING_COORDINATE(exp, coord);
             
@@ -491,7 +492,7 @@ t_ast_exp* primary_expression()
         }
 	case TK_CONST_UNSIGNED_LONG_INTEGER :
         {
-            exp_val.ul = (unsigned long)lexeme_value.integer_value;
+            exp_val.ul = (unsigned long)lexeme->integer_value;
             exp = make_ast_const_exp(exp_val, AST_EXP_CONST_UNSIGNED_LONG_INTEGER_KIND);
 			BINDING_COORDINATE(exp, coord);
             
@@ -500,7 +501,7 @@ t_ast_exp* primary_expression()
         }
 	case TK_CONST_UNSIGNED_LONG_LONG :
         {
-			exp_val.ull = lexeme_value.integer_value;
+			exp_val.ull = lexeme->integer_value;
             exp = make_ast_const_exp(exp_val, AST_EXP_CONST_UNSIGNED_LONG_LONG_KIND);
 			BINDING_COORDINATE(exp, coord);
             
@@ -510,7 +511,7 @@ t_ast_exp* primary_expression()
     case TK_CONST_STRING_LITERAL:
         {
             /* [TODO] wide string in lexer */
-			exp_val.p = lexeme_value.string_value;
+			exp_val.p = lexeme->string_value;
             exp = make_ast_const_exp(exp_val, AST_EXP_LITERAL_STRING_KIND);
 			BINDING_COORDINATE(exp, coord);
 
@@ -607,7 +608,7 @@ t_ast_exp* postfix_expression()
 					break;
 				}
 				
-				exp = make_ast_indir_exp(exp, op, lexeme_value.string_value);
+				exp = make_ast_indir_exp(exp, op, HCC_LEXEME_STRING());
 				BINDING_COORDINATE(exp, saved_coord);
                 
 				GET_NEXT_TOKEN;
@@ -688,8 +689,9 @@ t_ast_exp* unary_expression()
              * So here we need to peek next token instead of consume TK_LPAREN
              */
             int peek_token_code = peek_token();
+            t_lexeme_handle peek_value = peek_lexeme_at(1);
 
-            if (is_token_typename_token(peek_token_code, peek_lexeme_value.string_value))
+            if (is_token_typename_token(peek_token_code, HCC_LEXEME(peek_value)->string_value))
             {
 				t_ast_type_name* tname = NULL;
 
@@ -737,7 +739,7 @@ t_ast_exp* sizeof_expression()
     {
         GET_NEXT_TOKEN;
 
-        if (is_token_typename_token(cptk, lexeme_value.string_value))
+        if (is_token_typename_token(cptk, HCC_LEXEME_STRING()))
         {
             type = type_name();
         }
@@ -1170,7 +1172,7 @@ t_ast_stmt* expression_statement()
     {
         stmt = labeled_statement();
     }
-    else if (cptk == TK_ID && strcmp(lexeme_value.string_value, "__asm") == 0)
+    else if (cptk == TK_ID && strcmp(HCC_LEXEME_STRING(), "__asm") == 0)
     {
         /* [FIX ME][ASSEMBLY] 
          * this is a temp workaround to skip inline assembly parsing 
@@ -1233,7 +1235,7 @@ t_ast_stmt* labeled_statement()
 	match(TK_COLON);
 	_stmt = statement();
 	
-	stmt = make_ast_label_stmt(lexeme_value.string_value, _stmt);
+	stmt = make_ast_label_stmt(HCC_LEXEME_STRING(), _stmt);
 	BINDING_COORDINATE(stmt, saved_coord);
 	
 	return stmt;
@@ -1405,7 +1407,7 @@ t_ast_stmt* goto_statement()
     match(TK_GOTO);
 	if (cptk == TK_ID)
 	{
-		stmt = make_ast_goto_stmt(lexeme_value.string_value);
+		stmt = make_ast_goto_stmt(HCC_LEXEME_STRING());
 		BINDING_COORDINATE(stmt, coord);
 		GET_NEXT_TOKEN;
 	}
@@ -1644,9 +1646,9 @@ t_ast_declaration_specifier* declaration_specifiers()
 				break;
 			}
         case TK_ID:
-			if (!type_engaged && is_typedef_id(lexeme_value.string_value))
+			if (!type_engaged && is_typedef_id(HCC_LEXEME_STRING()))
             {
-				s = make_ast_type_specifier_typedef(lexeme_value.string_value);
+				s = make_ast_type_specifier_typedef(HCC_LEXEME_STRING());
 				BINDING_COORDINATE(s, coord);
                 HCC_AST_LIST_APPEND(type_specifier_list, s);
 
@@ -1817,9 +1819,9 @@ t_ast_parameter_declaration* parameter_declaration()
     
     if (!is_current_token_declarator_token() && cptk != TK_LBRACKET)
     {
-        if (cptk == TK_ID && is_typedef_id(lexeme_value.string_value))
+        if (cptk == TK_ID && is_typedef_id(HCC_LEXEME_STRING()))
         {
-            t_symbol* sym = find_symbol(lexeme_value.string_value, sym_table_identifiers);
+            t_symbol* sym = find_symbol(HCC_LEXEME_STRING(), sym_table_identifiers);
 
             if (symbol_scope > sym->scope)
             {
@@ -2014,14 +2016,14 @@ t_ast_suffix_declarator* suffix_declarator()
             */
             if (cptk == TK_ID)
             {
-				HCC_AST_LIST_APPEND(ids, lexeme_value.string_value);
+				HCC_AST_LIST_APPEND(ids, HCC_LEXEME_STRING());
 
                 GET_NEXT_TOKEN;
                 while (cptk == TK_COMMA)
                 {
                     GET_NEXT_TOKEN;
 
-					HCC_AST_LIST_APPEND(ids, lexeme_value.string_value);
+					HCC_AST_LIST_APPEND(ids, HCC_LEXEME_STRING());
 
                     match(TK_ID);
                 }
@@ -2101,7 +2103,7 @@ t_ast_direct_declarator* direct_declarator(int storage_class)
 			syntax_error("direct declarator must end with an identifier");
 		}
 
-		symbol = find_symbol(lexeme_value.string_value, sym_table_identifiers);
+		symbol = find_symbol(HCC_LEXEME_STRING(), sym_table_identifiers);
 
 		if (storage_class == TK_TYPEDEF)
 		{ 
@@ -2119,7 +2121,7 @@ t_ast_direct_declarator* direct_declarator(int storage_class)
 			}
 			else
 			{
-				symbol = add_symbol(lexeme_value.string_value, &sym_table_identifiers, symbol_scope, FUNC);
+				symbol = add_symbol(HCC_LEXEME_STRING(), &sym_table_identifiers, symbol_scope, FUNC);
 				symbol->storage = TK_TYPEDEF;
 				symbol->coordinate = coord;
                 symbol->defined = 1;
@@ -2133,7 +2135,7 @@ t_ast_direct_declarator* direct_declarator(int storage_class)
             }
         }
 
-        id = lexeme_value.string_value;
+        id = HCC_LEXEME_STRING();
 
 		GET_NEXT_TOKEN;
     }
@@ -2262,12 +2264,12 @@ t_ast_all_declarator* all_declarator(int storage_class)
 		/* only typedef symbol should be recorded at parsing stage */
 		if (storage_class == TK_TYPEDEF)
 		{
-			t_symbol* symbol = add_symbol(lexeme_value.string_value, &sym_table_identifiers, symbol_scope, FUNC);
+			t_symbol* symbol = add_symbol(HCC_LEXEME_STRING(), &sym_table_identifiers, symbol_scope, FUNC);
 			symbol->storage = TK_TYPEDEF;
             symbol->coordinate = coord;
 		}
 
-        id = lexeme_value.string_value;
+        id = HCC_LEXEME_STRING();
 
         GET_NEXT_TOKEN;
     }
@@ -2311,7 +2313,7 @@ t_ast_struct_or_union_specifier* struct_or_union_specifier()
     GET_NEXT_TOKEN;
     if (cptk  == TK_ID)
     {
-		id = lexeme_value.string_value;
+		id = HCC_LEXEME_STRING();
         GET_NEXT_TOKEN;
     }
 
@@ -2344,7 +2346,8 @@ struct_declarator_list
 */
 t_ast_list* struct_declaration_list()
 {
-	t_ast_list *list = make_ast_list_entry(), *c_list = list, *specifier_qualifier_list = NULL;
+	t_ast_list *list = make_ast_list_entry(), *c_list = list;
+	t_ast_declaration_specifier* specifier_qualifier_list = NULL;
 	t_ast_struct_declaration* struct_declaration = NULL;
 
     do
@@ -2420,12 +2423,23 @@ specifier_qualifier_list
 	| type_qualifier
 	;
 */
-t_ast_list* specifiers_qualifier_list()
+t_ast_declaration_specifier* specifiers_qualifier_list()
 {
-	t_ast_list *list = make_ast_list_entry(), *c_list = list;
+	t_ast_list *type_specifier_list = make_ast_list_entry(), *type_qualifier_list = make_ast_list_entry();
+	t_ast_declaration_specifier* specifiers = make_ast_declaration_specifier();
     int type_engaged = 0;
 	t_ast_type_specifier* s = NULL;
 
+    /* 
+     * specifiers and qualifiers are kept in separate lists (same as declaration_specifiers, minus storage class)
+     * so the semantic checker can tell them apart and reuse the declaration specifiers check.
+     */
+    specifiers->type_specifier_list = type_specifier_list;
+    specifiers->type_qualifier_list = type_qualifier_list;
+    specifiers->storage_class = TK_NULL;
+
+    BINDING_COORDINATE(specifiers, coord);
+
     for(;;)
     {
         switch(cptk)
@@ -2436,7 +2450,7 @@ t_ast_list* specifiers_qualifier_list()
 				t_ast_type_qualifier_kind kind = (cptk == TK_CONST)? AST_TYPE_CONST : AST_TYPE_VOLATILE;
 				t_ast_type_qualifier* q = make_ast_type_qualifer(kind);
 				BINDING_COORDINATE(q, coord);
-				HCC_AST_LIST_APPEND(c_list, q);
+				HCC_AST_LIST_APPEND(type_qualifier_list, q);
 
 				GET_NEXT_TOKEN;
 				break;
@@ -2454,37 +2468,37 @@ t_ast_list* specifiers_qualifier_list()
 			{
 				s = make_ast_type_specifier_native_type(token_to_ast_native_type(cptk));
 				BINDING_COORDINATE(s, coord);
-				HCC_AST_LIST_APPEND(c_list, s);
+				HCC_AST_LIST_APPEND(type_specifier_list, s);
 				
                 type_engaged = 1;
 				GET_NEXT_TOKEN;
 				break;
 			}
         case TK_ID:
-			if (!type_engaged && is_typedef_id(lexeme_value.string_value))
+			if (!type_engaged && is_typedef_id(HCC_LEXEME_STRING()))
             {
-				s = make_ast_type_specifier_typedef(lexeme_value.string_value);
+				s = make_ast_type_specifier_typedef(HCC_LEXEME_STRING());
 				BINDING_COORDINATE(s, coord);
-				HCC_AST_LIST_APPEND(c_list, s);
+				HCC_AST_LIST_APPEND(type_specifier_list, s);
 
                 GET_NEXT_TOKEN;
                 type_engaged = 1; 
                 break;
             }
 
-            return list;
+            return specifiers;
         case TK_STRUCT:
         case TK_UNION:
 			{
 				s = make_ast_type_specifier_struct_union(struct_or_union_specifier());
-				HCC_AST_LIST_APPEND(c_list, s);
+				HCC_AST_LIST_APPEND(type_specifier_list, s);
 				type_engaged = 1;
 				break;
 			}
         case TK_ENUM:
 			{
 				s = make_ast_type_specifier_enum(enum_specifier());
-				HCC_AST_LIST_APPEND(c_list, s);
+				HCC_AST_LIST_APPEND(type_specifier_list, s);
 				type_engaged = 1;
 				break;
 			}
@@ -2495,10 +2509,10 @@ t_ast_list* specifiers_qualifier_list()
         case TK_TYPEDEF:
             {
                 syntax_error("illegal storage class appears");
-                return list;
+                return specifiers;
             }
         default:
-            return list;
+            return specifiers;
         }
     }
 }
@@ -2531,7 +2545,7 @@ t_ast_enum_specifier* enum_specifier()
 
     if (cptk == TK_ID)
     {
-		e->id = lexeme_value.string_value;
+		e->id = HCC_LEXEME_STRING();
 		
         GET_NEXT_TOKEN;
         flag = 1;
@@ -2587,7 +2601,7 @@ t_ast_enumerator* enumerator()
 {
     t_ast_enumerator* e = NULL;
     t_ast_exp* exp = NULL;
-    char* id = lexeme_value.string_value;
+    char* id = HCC_LEXEME_STRING();
     t_coordinate saved_coord = coord;
 
     if (cptk != TK_ID)
@@ -2835,14 +2849,14 @@ t_ast_type_name* type_name()
 	t_ast_type_name* t = NULL;
 	t_coordinate saved_coord = coord;
 	t_ast_abstract_declarator* abstract_declr = NULL;
-	t_ast_list* list = specifiers_qualifier_list();
+	t_ast_declaration_specifier* specifier_qualifier_list = specifiers_qualifier_list();
 
     if (cptk == TK_MUL || cptk == TK_LPAREN || cptk == TK_LBRACKET)
     {
 		abstract_declr = abstract_declarator();
     }
 
-	t = make_ast_type_name(list, abstract_declr);
+	t = make_ast_type_name(specifier_qualifier_list, abstract_declr);
 	BINDING_COORDINATE(t, saved_coord);
 
 	return t;
@@ -2883,7 +2897,7 @@ int is_current_token_declaration_specifier_token()
     }
     else if (cptk == TK_ID)
     {
-        return is_typedef_id(lexeme_value.string_value);
+        return is_typedef_id(HCC_LEXEME_STRING());
     }
     else
     {
@@ -2895,7 +2909,7 @@ int is_current_token_declarator_token()
 {
 	if (cptk == TK_MUL ||
 		cptk == TK_LPAREN ||
-		(cptk == TK_ID && !is_typedef_id(lexeme_value.string_value)))
+		(cptk == TK_ID && !is_typedef_id(HCC_LEXEME_STRING())))
 	{
 		return 1;
 	}
@@ -525,7 +525,7 @@ t_ast_all_declarator* all_declarator(int storage_class);
 t_ast_struct_or_union_specifier* struct_or_union_specifier();
 t_ast_list* struct_declaration_list();
 t_ast_struct_declarator* struct_declarator();
-t_ast_list* specifiers_qualifier_list();
+t_ast_declaration_specifier* specifiers_qualifier_list();
 t_ast_enum_specifier* enum_specifier();
 t_ast_enumerator* enumerator();
 t_ast_type_name* type_name();
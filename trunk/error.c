@@ -90,11 +90,17 @@ void syntax_error(char* error_msg)
 
 void warning(char* warning_msg)
 {
-	printf("Warning in file %s on line %d : %s \r\n", coord.filename, coord.line, warning_msg);
+	warning_at(warning_msg, &coord);
+}
+
+/* the lexer reports at the token it scans, which may be ahead of coord */
+void warning_at(char* warning_msg, t_coordinate* position)
+{
+	printf("Warning in file %s on line %d : %s \r\n", position->filename, position->line, warning_msg);
 
     if (fp) 
     {
-        fprintf(fp, "Warning in file %s on line %d : %s \r\n", coord.filename, coord.line, warning_msg);
+        fprintf(fp, "Warning in file %s on line %d : %s \r\n", position->filename, position->line, warning_msg);
     }
 
 	warning_count ++;
@@ -102,11 +108,16 @@ void warning(char* warning_msg)
 
 void lexeme_error(char* error_msg)
 {
-	printf("Lexeme error detected in file %s on line %d : %s \r\n", coord.filename, coord.line, error_msg);
+	lexeme_error_at(error_msg, &coord);
+}
+
+void lexeme_error_at(char* error_msg, t_coordinate* position)
+{
+	printf("Lexeme error detected in file %s on line %d : %s \r\n", position->filename, position->line, error_msg);
 
     if (fp) 
     {
-        fprintf(fp, "Lexeme error detected in file %s on line %d : %s \r\n", coord.filename, coord.line, error_msg);
+        fprintf(fp, "Lexeme error detected in file %s on line %d : %s \r\n", position->filename, position->line, error_msg);
     }
 
 	error_count ++;
@@ -124,6 +135,17 @@ void type_error(char* msg)
 	error_count ++;
 }
 
+/* the preprocessor has printed the error itself */
+void preprocessor_error()
+{
+    error_count ++;
+}
+
+int get_error_count()
+{
+    return error_count;
+}
+
 void semantic_error(char* msg, t_ast_coord* coord)
 {
     printf("semantic error in file %s on line %d : %s\n", coord->file, coord->line,msg);
@@ -156,7 +178,11 @@ void log_initialize(char* filename)
 
 void log_terminate()
 {
-    if (!fp) fclose(fp);
+    if (fp)
+    {
+        fclose(fp);
+        fp = NULL;
+    }
 }
 
 void log_number(int i)
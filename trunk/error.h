@@ -36,10 +36,14 @@ OTHER DEALINGS IN THE SOFTWARE.
 void error(char* expect_token, char* actual_token);
 void syntax_error(char* error_msg);
 void lexeme_error(char* error_msg);
+void lexeme_error_at(char* error_msg, t_coordinate* position);
 void semantic_error(char* msg, t_ast_coord* coord);
 void semantic_warning(char* msg, t_ast_coord* coord);
 void warning(char*);
+void warning_at(char* warning_msg, t_coordinate* position);
 void type_error(char* msg);
+void preprocessor_error();
+int get_error_count();
 
 /* prelimary logging system */
 void log_initialize(char* filename);
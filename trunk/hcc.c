@@ -32,6 +32,8 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "hconfig.h"
 #include "arena.h"
 #include "type.h"
+#include "ssc.h"
+#include "layout.h"
 #include <crtdbg.h>
 
 #include <time.h>
@@ -184,6 +186,7 @@ void test_lexer()
     }
 
 	free_clexer();
+	finalize_clexer();
 
     hcc_deallocate_all();
 
@@ -195,16 +198,67 @@ void test_parser(char* filename, char** include_path)
 {
     /* this is a typical parsing session */
     t_scanner_context sc;
+    t_ast_translation_unit* unit = NULL;
+    clock_t lex_start, parse_start, check_start, check_end;
+    char token_file[FILENAME_MAX];
+    int token_stream = 0;
+    int replayed = 0;
 
 	sc.filename = filename;
 	sc.include_pathes = include_path;
 	sc.number_of_include_pathes = 4;
 
-	initialize_clexer(&sc);
+    lex_start = clock();
+
+    /* token file of the translation unit is <file>.htk */
+    if ((g_dump_token_stream || g_replay_token_stream) && strlen(filename) + 5 <= sizeof(token_file))
+    {
+        sprintf(token_file, "%s.htk", filename);
+        token_stream = 1;
+    }
+
+    if (token_stream && g_replay_token_stream)
+    {
+        replayed = !replay_translation_unit(token_file);
+    }
+
+    if (!replayed)
+    {
+	    initialize_clexer(&sc);
+
+        /* before the parser takes its first token */
+        if (g_prelex_translation_unit || (token_stream && g_dump_token_stream))
+        {
+            prelex_translation_unit();
+        }
+
+        if (token_stream && g_dump_token_stream && dump_translation_unit(token_file))
+        {
+            fprintf(stderr, "%s: can't write token file %s\n", filename, token_file);
+        }
+    }
+
 	initialize_parser();
     type_system_initialize();
 
-    static_semantic_check(translation_unit());		
+    parse_start = clock();
+    unit = translation_unit();
+    check_start = clock();
+    static_semantic_check(unit);		
+    check_end = clock();
+
+    if (g_prelex_translation_unit || replayed)
+    {
+        printf("%s: %s %.3fs, parse %.3fs, check %.3fs\n", filename,
+            replayed ? "replay" : "lex", (double)(parse_start - lex_start) / CLOCKS_PER_SEC,
+            (double)(check_start - parse_start) / CLOCKS_PER_SEC,
+            (double)(check_end - check_start) / CLOCKS_PER_SEC);
+    }
+
+    if (g_layout_report_output)
+    {
+        layout_report_emit(filename);
+    }
 
 	free_clexer();
     free_symbol_tables();
@@ -247,8 +301,43 @@ HCC_MEM_CHECK_START
 
    log_initialize("G:\\athena.txt");
 
+//#define LAYOUT_REPORT
+#ifdef LAYOUT_REPORT
+   g_layout_report_output = fopen("G:\\layout.json", "wb");
+#endif
+
    time(&t1);
 
+//#define PRELEX_TRANSLATION_UNIT
+#ifdef PRELEX_TRANSLATION_UNIT
+   g_prelex_translation_unit = 1;
+#endif
+
+//#define PIPELINE_LEXER
+#ifdef PIPELINE_LEXER
+   g_pipeline_lexer = 1;
+#endif
+
+//#define DUMP_TOKEN_STREAM
+#ifdef DUMP_TOKEN_STREAM
+   g_dump_token_stream = 1;
+#endif
+
+//#define REPLAY_TOKEN_STREAM
+#ifdef REPLAY_TOKEN_STREAM
+   g_replay_token_stream = 1;
+#endif
+
+//#define PREFIX_HEADER
+#ifdef PREFIX_HEADER
+   g_prefix_header = "G:\\src\\prefix.h";
+#endif
+
+//#define HEADER_MODULES
+#ifdef HEADER_MODULES
+   g_header_modules = 1;
+#endif
+
 //#define ATOMIC_TEST
 #ifdef ATOMIC_TEST
    (names);
@@ -264,6 +353,11 @@ HCC_MEM_CHECK_START
     }
 #endif
     log_terminate();
+    finalize_clexer();
+
+#ifdef LAYOUT_REPORT
+    if (g_layout_report_output) fclose(g_layout_report_output);
+#endif
 
 	hcc_deallocate_all();
 
@@ -49,15 +49,27 @@ OTHER DEALINGS IN THE SOFTWARE.
 //
 // type size configurations
 //
+// target data model is ILP32 by default (int, long and pointer are 4 bytes);
+// define HCC_TARGET_LP64 for LP64 targets (long and pointer are 8 bytes).
+// arithmetic conversions are derived from these sizes when type system is initialized.
+//
 #define HCC_CHAR_SIZE 1
 #define HCC_SHORT_SIZE 2
 #define HCC_INT_SIZE 4
+#ifdef HCC_TARGET_LP64
+#define HCC_LONG_SIZE 8
+#else
 #define HCC_LONG_SIZE 4
+#endif
 #define HCC_LONGLONG_SIZE 8
 #define HCC_FLOAT_SIZE 4
 #define HCC_DOUBLE_SIZE 8
 #define HCC_LONG_DOUBLE_SIZE 8
+#ifdef HCC_TARGET_LP64
+#define HCC_PTR_SIZE 8
+#else
 #define HCC_PTR_SIZE 4
+#endif
 
 //
 // arena types 
@@ -28,6 +28,8 @@ OTHER DEALINGS IN THE SOFTWARE.
 #ifndef __HCC_CONFIG_H
 #define __HCC_CONFIG_H
 
+#include <stdio.h>
+
 #ifdef _MSC_VER
 #include <crtdbg.h>
 #endif
@@ -37,6 +39,47 @@ OTHER DEALINGS IN THE SOFTWARE.
 //
 extern char** g_compiling_files;
 
+/*
+ * record layout report (see layout.h) - padding and cache line analysis of structs and unions
+ * the report is written to this stream when it is set; NULL disables the analysis
+ */
+extern FILE* g_layout_report_output;
+
+/*
+ * non zero to preprocess and lex a whole translation unit before parsing it
+ * (see prelex_translation_unit in clexer.h); phase timings are printed in this mode
+ */
+extern int g_prelex_translation_unit;
+
+/*
+ * non zero to run preprocessing and lexing on a producer thread feeding the parser
+ * (see clexer.c); falls back to the synchronous lexer if no thread can be started
+ */
+extern int g_pipeline_lexer;
+
+/*
+ * non zero to write the token stream of each translation unit to <file>.htk after lexing it
+ * (see dump_translation_unit in clexer.h), or to replay <file>.htk instead of preprocessing
+ * the file when it exists - parser and semantic checks can then be timed and profiled alone
+ */
+extern int g_dump_token_stream;
+extern int g_replay_token_stream;
+
+/*
+ * prefix header: when set, every translation unit is compiled as if it began with #include of
+ * this file. the header is preprocessed once into an image, <file>.hph, holding its tokens and
+ * the preprocessor state at its end (macros, assertions, guards of the files it included); the
+ * image is loaded instead, and built again when one of these files or the include path changes
+ */
+extern char* g_prefix_header;
+
+/*
+ * non zero to keep guarded headers as modules for the session: the tokens and macros a header
+ * produced are replayed when it is included again under the same macro definitions, instead of
+ * preprocessing it again (see import_header_module in preprocessor/cpp.c)
+ */
+extern int g_header_modules;
+
 #ifdef _MSC_VER
 
 	#define HCC_MEM_CHECK_START _CrtSetDbgFlag ( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF ); \
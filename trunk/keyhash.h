@@ -0,0 +1,203 @@
+/* generated by utility/kwgen.c from keywords.h - do not edit */
+
+#ifndef __HCC_KEYHASH_H
+#define __HCC_KEYHASH_H
+
+#include <string.h>
+
+typedef struct keyword_slot
+{
+    char* name;
+    int len;
+    int token;
+} t_keyword_slot;
+
+#define KW_MAX_LENGTH 8
+#define KW_HASH_SIZE 128
+
+static const unsigned char kw_asso[256] =
+{
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   3,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  29,
+      0,   8, 123,  12, 122, 103,  86,  12,  38, 112,   0, 102, 121,  58, 119, 105,
+      0,   0,  81,   9, 103,  78, 102, 124, 111, 111,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0
+};
+
+static const t_keyword_slot kw_hash_table[KW_HASH_SIZE] =
+{
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"static", 6, TK_STATIC},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"char", 4, TK_CHAR},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"while", 5, TK_WHILE},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"register", 8, TK_REGISTER},
+    {NULL, 0, TK_ID},
+    {"for", 3, TK_FOR},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"short", 5, TK_SHORT},
+    {"enum", 4, TK_ENUM},
+    {NULL, 0, TK_ID},
+    {"if", 2, TK_IF},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"switch", 6, TK_SWITCH},
+    {NULL, 0, TK_ID},
+    {"typedef", 7, TK_TYPEDEF},
+    {NULL, 0, TK_ID},
+    {"return", 6, TK_RETURN},
+    {NULL, 0, TK_ID},
+    {"break", 5, TK_BREAK},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"float", 5, TK_FLOAT},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"volatile", 8, TK_VOLATILE},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"union", 5, TK_UNION},
+    {NULL, 0, TK_ID},
+    {"auto", 4, TK_AUTO},
+    {"__int64", 7, TK_INT64},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"unsigned", 8, TK_UNSIGNED},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"else", 4, TK_ELSE},
+    {NULL, 0, TK_ID},
+    {"void", 4, TK_VOID},
+    {"do", 2, TK_DO},
+    {"default", 7, TK_DEFAULT},
+    {"double", 6, TK_DOUBLE},
+    {"int", 3, TK_INT},
+    {NULL, 0, TK_ID},
+    {"extern", 6, TK_EXTERN},
+    {NULL, 0, TK_ID},
+    {"sizeof", 6, TK_SIZEOF},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"struct", 6, TK_STRUCT},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"const", 5, TK_CONST},
+    {"goto", 4, TK_GOTO},
+    {NULL, 0, TK_ID},
+    {"continue", 8, TK_CONTINUE},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"long", 4, TK_LONG},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"signed", 6, TK_SIGNED},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {NULL, 0, TK_ID},
+    {"case", 4, TK_CASE},
+};
+
+/*
+ * map an identifier to its keyword token, or TK_ID
+ * the length is measured only up to the longest keyword, so no strlen is needed
+ */
+static int kw_lookup(const char* id)
+{
+    const t_keyword_slot* p = NULL;
+    int len = 0;
+
+    while (id[len])
+    {
+        if (++len > KW_MAX_LENGTH)
+        {
+            return TK_ID;
+        }
+    }
+
+    if (len == 0)
+    {
+        return TK_ID;
+    }
+
+    p = &kw_hash_table[(len + kw_asso[(unsigned char)id[0]] + kw_asso[(unsigned char)id[1]] +
+        kw_asso[(unsigned char)id[len - 1]]) & (KW_HASH_SIZE - 1)];
+
+    if (p->len == len && p->name[0] == id[0] && memcmp(p->name, id, len) == 0)
+    {
+        return p->token;
+    }
+
+    return TK_ID;
+}
+
+#endif
@@ -176,6 +176,13 @@ static tKW kwZ[] =
     {NULL,       0, TK_ID}
 };
 
+/* [NON STD EXT] extension keywords which do not start with a letter */
+static tKW kwExt[] =
+{
+	{"__int64", 7, TK_INT64},
+    {NULL,       0, TK_ID}
+};
+
 static tKW* kw_table[] =
 {
     kwA, kwB, kwC, kwD, kwE, kwF, kwG,
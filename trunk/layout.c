@@ -0,0 +1,276 @@
+/***************************************************************
+
+Copyright (c) 2008-2010 Michael Liang Han
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+#include <assert.h>
+
+#include "hcc.h"
+#include "hconfig.h"
+#include "layout.h"
+#include "symbol.h"
+#include "arena.h"
+
+FILE* g_layout_report_output = NULL;
+
+/*
+ * records laid out in current translation unit, in the order they are defined
+ */
+static struct layout_entry
+{
+    t_type* record;
+    struct layout_entry* next;
+} *layout_entries = NULL, **layout_tail = &layout_entries;
+
+
+void layout_report_record(t_type* record)
+{
+    struct layout_entry* entry = NULL;
+
+    assert(record && (record->code == TYPE_STRUCT || record->code == TYPE_UNION));
+
+    CALLOC(entry, PERM);
+    entry->record = record;
+
+    *layout_tail = entry;
+    layout_tail = &entry->next;
+}
+
+static void emit_string(FILE* out, const char* s)
+{
+    if (!s)
+    {
+        fprintf(out, "null");
+        return;
+    }
+
+    fputc('"', out);
+
+    for (; *s; s ++)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            fputc('\\', out);
+            fputc(*s, out);
+        }
+        else if ((unsigned char)*s < 0x20)
+        {
+            fprintf(out, "\\u%04x", (unsigned char)*s);
+        }
+        else
+        {
+            fputc(*s, out);
+        }
+    }
+
+    fputc('"', out);
+}
+
+/*
+ * bytes [start, end) occupied by a field
+ * an unnamed zero width bit field occupies nothing
+ */
+static void field_extent(t_record_field* field, int* start, int* end)
+{
+    if (field->bits > 0)
+    {
+        *start = field->offset + field->bit_offset / 8;
+        *end = field->offset + (field->bit_offset + field->bits + 7) / 8;
+    }
+    else if (!field->name && !IS_ANONYMOUS_MEMBER(field))
+    {
+        *start = *end = field->offset;
+    }
+    else
+    {
+        *start = field->offset;
+        *end = field->offset + field->type->size;
+    }
+}
+
+static int field_align(t_record_field* field)
+{
+    return field->type->align > 0 ? field->type->align : 1;
+}
+
+/*
+ * field order which minimizes size of a struct
+ *
+ * C alignments are powers of 2 and a type size is a multiple of its alignment, so laying out fields
+ * by decreasing alignment leaves no hole between fields; a stable sort keeps the original order
+ * among fields of same alignment. bit fields are not reordered.
+ * return size of the struct in the suggested order, or 0 if the struct can't be reordered.
+ */
+static int optimal_order(t_type* record, t_record_field** order, int count)
+{
+    t_record_field* field = NULL;
+    int i = 0, j = 0;
+    int offset = 0;
+
+    for (field = record->u.tag->fields; field; field = field->next)
+    {
+        if (field->bits > 0 || (!field->name && !IS_ANONYMOUS_MEMBER(field)))
+        {
+            return 0;
+        }
+
+        /* insertion sort - stable */
+        for (j = i; j > 0 && field_align(order[j - 1]) < field_align(field); j --)
+        {
+            order[j] = order[j - 1];
+        }
+
+        order[j] = field;
+        i ++;
+    }
+
+    assert(i == count);
+
+    for (i = 0; i < count; i ++)
+    {
+        offset = ROUNDUP(offset, field_align(order[i])) + order[i]->type->size;
+    }
+
+    return ROUNDUP(offset, record->align > 0 ? record->align : 1);
+}
+
+static void emit_record(FILE* out, t_type* record)
+{
+    t_symbol* symbol = (t_symbol*)record->symbolic_link;
+    t_record_field* field = NULL;
+    t_record_field** order = NULL;
+    int count = 0, straddling = 0, padding = 0, covered = 0;
+    int optimal_size = 0;
+    int i = 0;
+
+    fprintf(out, "{\"name\":");
+    emit_string(out, record->u.tag->tag);
+    /* anonymous records are named by a generated number */
+    fprintf(out, ",\"anonymous\":%s,\"kind\":\"%s\",\"file\":", 
+        IS_ANONYMOUS_TAG(record->u.tag->tag) ? "true" : "false",
+        record->code == TYPE_STRUCT ? "struct" : "union");
+    emit_string(out, symbol ? symbol->coordinate.filename : NULL);
+    fprintf(out, ",\"line\":%d,\"size\":%d,\"align\":%d,\"fields\":[", 
+        symbol ? symbol->coordinate.line : 0, record->size, record->align);
+
+    for (field = record->u.tag->fields; field; field = field->next)
+    {
+        int start = 0, end = 0, next_start = record->size;
+        int straddle = 0;
+
+        field_extent(field, &start, &end);
+
+        if (field->next && record->code == TYPE_STRUCT)
+        {
+            int next_end = 0;
+            field_extent(field->next, &next_start, &next_end);
+        }
+
+        if (record->code == TYPE_STRUCT)
+        {
+            if (start > covered)
+            {
+                padding += start - covered;
+            }
+
+            if (end > covered)
+            {
+                covered = end;
+            }
+        }
+        else if (end > covered)
+        {
+            covered = end;
+        }
+
+        straddle = end > start && (start / HCC_CACHE_LINE_SIZE) != ((end - 1) / HCC_CACHE_LINE_SIZE);
+        straddling += straddle;
+
+        fprintf(out, "%s{\"name\":", count ? "," : "");
+        emit_string(out, field->name);
+        fprintf(out, ",\"offset\":%d,\"size\":%d,\"align\":%d,\"bits\":%d,\"bit_offset\":%d,\"hole_after\":%d,\"straddles_cache_line\":%s}",
+            field->offset, field->type->size, field_align(field), field->bits, field->bit_offset,
+            (record->code == TYPE_STRUCT && next_start > end) ? next_start - end : 0,
+            straddle ? "true" : "false");
+
+        count ++;
+    }
+
+    padding += record->size > covered ? record->size - covered : 0;
+
+    fprintf(out, "],\"padding\":%d,\"straddling_fields\":%d", padding, straddling);
+
+    if (record->code == TYPE_STRUCT && count > 0)
+    {
+        order = malloc(count * sizeof(*order));
+        optimal_size = optimal_order(record, order, count);
+    }
+
+    if (optimal_size > 0)
+    {
+        fprintf(out, ",\"optimal\":{\"size\":%d,\"saving\":%d,\"order\":[", optimal_size, record->size - optimal_size);
+
+        for (i = 0; i < count; i ++)
+        {
+            fprintf(out, "%s", i ? "," : "");
+            emit_string(out, order[i]->name);
+        }
+
+        fprintf(out, "]}");
+    }
+    else
+    {
+        fprintf(out, ",\"optimal\":null");
+    }
+
+    free(order);
+
+    fprintf(out, "}");
+}
+
+void layout_report_emit(char* filename)
+{
+    FILE* out = g_layout_report_output;
+    struct layout_entry* entry = NULL;
+
+    if (out)
+    {
+        fprintf(out, "{\"file\":");
+        emit_string(out, filename);
+        fprintf(out, ",\"cache_line_size\":%d,\"records\":[", HCC_CACHE_LINE_SIZE);
+
+        for (entry = layout_entries; entry; entry = entry->next)
+        {
+            fprintf(out, "%s", entry == layout_entries ? "" : ",");
+            emit_record(out, entry->record);
+        }
+
+        fprintf(out, "]}\n");
+        fflush(out);
+    }
+
+    /* entries are allocated in PERM arena and reclaimed with it */
+    layout_entries = NULL;
+    layout_tail = &layout_entries;
+}
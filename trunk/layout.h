@@ -0,0 +1,51 @@
+/***************************************************************
+
+Copyright (c) 2008-2010 Michael Liang Han
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+#ifndef __HCC_LAYOUT_H
+#define __HCC_LAYOUT_H
+
+#include "type.h"
+
+/*
+ * record layout report
+ *
+ * a -Wpadded like analysis over structs and unions laid out during semantic check.
+ * for each record it reports total padding bytes, the fields which straddle a cache line
+ * and the field order which minimizes the record size.
+ *
+ * the report is enabled by setting g_layout_report_output (see hconfig.h); one JSON object
+ * is written per translation unit, one translation unit per line.
+ */
+
+#define HCC_CACHE_LINE_SIZE 64
+
+/* record a laid out struct / union for the report of current translation unit */
+void layout_report_record(t_type* record);
+
+/* write the report of the translation unit and reset recorded records for next translation unit */
+void layout_report_emit(char* filename);
+
+#endif
@@ -72,6 +72,37 @@ static void del_assertion(void *va)
 	freemem(a);
 }
 
+/*
+ * An assertion shared with the saved table (see save_assertions()) is
+ * replaced with a private copy before it is modified.
+ */
+static struct assert *own_assertion(struct assert *a)
+{
+	struct assert *b;
+	char *aname;
+	size_t i, j;
+
+	if (!HASH_ITEM_SHARED(a)) return a;
+	b = new_assertion();
+	for (i = 0; i < a->nbval; i ++) {
+		struct token_fifo tf;
+
+		tf.art = tf.nt = 0;
+		for (j = 0; j < a->val[i].nt; j ++) {
+			struct token t = a->val[i].t[j];
+
+			if (S_TOKEN(t.type)) t.name = sdup(t.name);
+			aol(tf.t, tf.nt, t, TOKEN_LIST_MEMG);
+		}
+		aol(b->val, b->nbval, tf, TOKEN_LIST_MEMG);
+	}
+	aname = sdup(HASH_ITEM_NAME(a));
+	HTT_del(&assertions, aname);
+	HTT_put(&assertions, b, aname);
+	freemem(aname);
+	return b;
+}
+
 /*
  * print the contents of a token list
  */
@@ -202,6 +233,7 @@ handle_assert_next3:
 	}
 
 	/* This is a new assertion. Let's keep it. */
+	if (!ina) a = own_assertion(a);
 	aol(a->val, a->nbval, *atl, TOKEN_LIST_MEMG);
 	if (ina) {
 		HTT_put(&assertions, a, aname);
@@ -311,6 +343,7 @@ handle_unassert_next3:
 	for (i = 0; i < a->nbval && cmp_token_list(&atl, a->val + i); i ++);
 	if (i != a->nbval) {
 		/* we have it, undefine it */
+		a = own_assertion(a);
 		del_token_fifo(a->val + i);
 		if (i < (a->nbval - 1))
 			mmvwo(a->val + i, a->val + i + 1, (a->nbval - i - 1)
@@ -403,6 +436,121 @@ void init_assertions(void)
 	assertions_init_done = 1;
 }
 
+/*
+ * The assertion table saved by save_assertions(); its assertions are
+ * shared with the tables copied by restore_assertions().
+ */
+static HTT saved_assertions;
+static int saved_assertions_done = 0;
+
+/*
+ * save the current assertion table
+ */
+void save_assertions(void)
+{
+	if (!assertions_init_done) return;
+	HTT_freeze(&assertions);
+	HTT_copy(&saved_assertions, &assertions);
+	saved_assertions_done = 1;
+}
+
+/*
+ * replace the assertion table with a copy of the saved one; this
+ * returns 0 if there is none
+ */
+int restore_assertions(void)
+{
+	if (!saved_assertions_done) return 0;
+	wipe_assertions();
+	HTT_copy(&assertions, &saved_assertions);
+	assertions_init_done = 1;
+	return 1;
+}
+
+/*
+ * release the saved assertion table
+ */
+void free_saved_assertions(void)
+{
+	if (saved_assertions_done) HTT_release(&saved_assertions);
+	saved_assertions_done = 0;
+}
+
+/*
+ * assertion table image, see write_cpp_state() in cpp.c
+ */
+static FILE *state_output;
+
+static void write_assertion(void *va)
+{
+	struct assert *a = va;
+	size_t i, j;
+
+	put_state_string(state_output, HASH_ITEM_NAME(a));
+	put_state_word(state_output, (unsigned long)a->nbval);
+	for (i = 0; i < a->nbval; i ++) {
+		put_state_word(state_output, (unsigned long)a->val[i].nt);
+		for (j = 0; j < a->val[i].nt; j ++) {
+			struct token *t = a->val[i].t + j;
+
+			put_state_word(state_output, (unsigned long)t->type);
+			if (S_TOKEN(t->type))
+				put_state_string(state_output, t->name);
+		}
+	}
+}
+
+void write_assertions(FILE *f)
+{
+	state_output = f;
+	put_state_word(f, assertions_init_done
+		? (unsigned long)assertions.count : 0);
+	if (assertions_init_done) HTT_scan(&assertions, write_assertion);
+}
+
+/*
+ * read the assertions written by write_assertions(); they replace the
+ * current assertions if apply is non-zero, and are only checked otherwise
+ */
+void read_assertions(struct state_reader *r, int apply)
+{
+	unsigned long n = get_state_word(r), i, j, k;
+
+	if (apply) init_assertions();
+	for (i = 0; i < n && !r->failed; i ++) {
+		char *name = get_state_string(r);
+		unsigned long nbval = get_state_word(r);
+		struct assert *a = 0;
+
+		if (apply) a = new_assertion();
+		for (j = 0; j < nbval && !r->failed; j ++) {
+			struct token_fifo tf;
+			unsigned long nt = get_state_word(r);
+
+			tf.art = tf.nt = 0;
+			for (k = 0; k < nt && !r->failed; k ++) {
+				struct token t;
+				unsigned long type = get_state_word(r);
+
+				if (type > MACROARG) {
+					r->failed = 1;
+					break;
+				}
+				t.type = (int)type;
+				t.line = 0;
+				if (S_TOKEN(t.type)) {
+					char *tn = get_state_string(r);
+
+					if (apply) t.name = sdup(tn);
+				}
+				if (apply) aol(tf.t, tf.nt, t, TOKEN_LIST_MEMG);
+			}
+			if (apply) aol(a->val, a->nbval, tf, TOKEN_LIST_MEMG);
+		}
+		if (apply) HTT_put(&assertions, a, name);
+	}
+}
+
 /*
  * retrieve an assertion from the hash table
  */
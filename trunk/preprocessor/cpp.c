@@ -41,16 +41,28 @@
 #include <stddef.h>
 #include <limits.h>
 #include <time.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "ucppi.h"
 #include "mem.h"
 #include "nhash.h"
 #ifdef UCPP_MMAP 
 #include <unistd.h>
-#include <sys/types.h>
 #include <sys/mman.h>
 #include <fcntl.h>
 #endif
 
+/*
+ * Nanoseconds of the modification time, where the POSIX.1-2008 struct
+ * stat has them, so that a file rewritten within a second is told apart.
+ */
+#if defined(_POSIX_VERSION) && _POSIX_VERSION >= 200809L
+#define ST_MTIME_NSEC(st)	((unsigned long)(st)->st_mtim.tv_nsec)
+#else
+#define ST_MTIME_NSEC(st)	0UL
+#endif
+
 /*
  * The standard path where includes are looked for.
  */
@@ -62,6 +74,7 @@ static size_t include_path_nb = 0;
 
 int no_special_macros = 0;
 int emit_dependencies = 0, emit_defines = 0, emit_assertions = 0;
+int header_modules = 0;
 FILE *emit_output;
 
 #ifdef STAND_ALONE
@@ -98,6 +111,7 @@ void ucpp_error(long line, char *fmt, ...)
 {
 	va_list ap;
 
+	spoil_header_module();
 	va_start(ap, fmt);
 	if (line > 0)
 		fprintf(stderr, "%s: line %ld: ", current_filename, line);
@@ -124,6 +138,7 @@ void ucpp_warning(long line, char *fmt, ...)
 {
 	va_list ap;
 
+	spoil_header_module();
 	va_start(ap, fmt);
 	if (line > 0)
 		fprintf(stderr, "%s: warning: line %ld: ",
@@ -233,11 +248,16 @@ char *token_name(struct token *t)
  *    construction; we can then avoid including several times a file
  *    when this is not necessary.
  * -- remember in which directory, in the include path, the file was found.
+ * -- remember, for the whole session, the guardian macro of each file and
+ *    whether it uses #pragma once (see struct known_file below).
  */
+struct known_file;
+
 struct found_file {
 	hash_item_header head;    /* first field */
 	char *name;
 	char *protect;
+	struct known_file *kf;
 };
 
 /*
@@ -258,6 +278,7 @@ static struct found_file *new_found_file(void)
 
 	ff->name = 0;
 	ff->protect = 0;
+	ff->kf = 0;
 	return ff;
 }
 
@@ -310,8 +331,282 @@ void set_init_filename(char *x, int real_file)
 	}
 }
 
+/*
+ * Include lookup cache. Resolving a header tries each directory of the
+ * include path in turn, and most of those opens fail. Failed lookups are
+ * remembered per parent directory, together with the state of that
+ * directory when they were recorded. Unlike found_files, the cache lives
+ * for the whole session (wipeout() keeps it), so later translation units
+ * skip the failing opens with one hash lookup each. A directory is
+ * stat()ed again once per translation unit and its entries are dropped
+ * if it appeared, vanished or was modified in between.
+ */
+struct include_dir {
+	hash_item_header head;    /* first field */
+	int exists;
+	time_t mtime;
+	unsigned long mtime_nsec;
+	unsigned long checked;	/* include_serial of the last stat() */
+	HTT misses;
+};
+
+static HTT include_dirs;
+static int include_dirs_init_done = 0;
+static unsigned long include_serial = 0;
+
+static void del_include_miss(void *m)
+{
+	freemem(m);
+}
+
+static void del_include_dir(void *m)
+{
+	struct include_dir *id = (struct include_dir *)m;
+
+	HTT_kill(&id->misses);
+	freemem(id);
+}
+
+/*
+ * Split path into its directory and base name, and get the cache entry
+ * of the directory, up to date for this translation unit.
+ */
+static struct include_dir *get_include_dir(char *path, char **base)
+{
+	struct include_dir *id;
+	struct stat st;
+	char *dir, *c;
+	int exists;
+
+	for (c = *base = path; *c; c ++)
+#ifdef MSDOS
+		if (*c == '/' || *c == '\\') *base = c + 1;
+#else
+		if (*c == '/') *base = c + 1;
+#endif
+	if (*base == path) {
+		dir = sdup(".");
+	} else {
+		dir = getmem(*base - path);
+		mmv(dir, path, *base - path - 1);
+		dir[*base - path - 1] = 0;
+	}
+	if (!include_dirs_init_done) {
+		HTT_init(&include_dirs, del_include_dir);
+		include_dirs_init_done = 1;
+	}
+	id = HTT_get(&include_dirs, dir);
+	if (!id) {
+		id = getmem(sizeof(struct include_dir));
+		id->checked = include_serial - 1;
+		id->exists = -1;
+		id->mtime = 0;
+		id->mtime_nsec = 0;
+		HTT_init(&id->misses, del_include_miss);
+		HTT_put(&include_dirs, id, dir);
+	}
+	if (id->checked != include_serial) {
+		exists = (stat(dir, &st) == 0);
+		if (exists != id->exists || (exists && (st.st_mtime != id->mtime
+			|| ST_MTIME_NSEC(&st) != id->mtime_nsec))) {
+			HTT_kill(&id->misses);
+			HTT_init(&id->misses, del_include_miss);
+			id->exists = exists;
+			id->mtime = exists ? st.st_mtime : 0;
+			id->mtime_nsec = exists ? ST_MTIME_NSEC(&st) : 0;
+		}
+		id->checked = include_serial;
+	}
+	freemem(dir);
+	return id;
+}
+
+/*
+ * Header knowledge. found_files only lives for one translation unit, and
+ * is indexed by name; what we learn about the contents of a file (its
+ * guardian macro, a #pragma once) is kept here for the whole session,
+ * indexed by the identity of the file: device, inode, modification time
+ * and size, so that an edited file is considered anew. Where the system has
+ * no inode numbers, the path stands in for them.
+ * A guardian is not trusted blindly: whether it is defined is checked
+ * against the macros of the current translation unit, each time.
+ */
+struct known_file {
+	hash_item_header head;    /* first field */
+	char *protect;
+	int once;
+	unsigned long entered;	/* include_serial of the last inclusion */
+	struct header_module *modules;	/* see handle_include() */
+	int no_module;		/* the file cannot be recorded */
+};
+
+static HTT known_files;
+static int known_files_init_done = 0;
+
+/*
+ * Header modules. A header protected by a guardian macro or by #pragma
+ * once is recorded while it is read: the tokens it produces, the files
+ * it reads in turn, and the macros it uses and sets (see struct
+ * macro_set). The module is kept with the session entry of the header,
+ * and goes away with it when the file is modified. When the header is
+ * included again, in a later translation unit, and the module applies
+ * -- the macros it used have the same definitions, the files it read are
+ * unchanged and would be read again, the include path is the same --
+ * its tokens are replayed and its macros set, instead of reading and
+ * preprocessing the header again.
+ *
+ * A header whose output depends on anything else (__FILE__, __DATE__,
+ * __TIME__, assertions, #line) or that raised a diagnostic is not
+ * recorded.
+ */
+struct module_file {
+	struct known_file *kf;
+	char *path;
+};
+
+struct header_module {
+	struct header_module *next;
+	char *name;		/* path the header was read from */
+	int incdir;
+	size_t nincpath;
+	char **incpath;
+	struct macro_set key, delta;
+	size_t nfile, nonce;
+	struct module_file *file;	/* files read by the header */
+	struct known_file **once;	/* #pragma once files it skipped */
+	size_t nt, tmax;
+	struct token *t;
+};
+
+/*
+ * the header module being recorded, see start_module_record()
+ */
+static struct header_module *recorded_module = 0;
+static struct known_file *recorded_kf;
+static size_t recorded_depth;
+static char *recorded_context;
+static int recorded_spoilt;
+
+static void del_header_module(struct header_module *);
+static void note_module_once(struct known_file *);
+static void record_module_token(struct lexer_state *);
+static void end_module_record(void);
+static void drop_module_record(void);
+
+static void del_known_file(void *m)
+{
+	struct known_file *kf = (struct known_file *)m;
+
+	while (kf->modules) {
+		struct header_module *hm = kf->modules;
+
+		kf->modules = hm->next;
+		del_header_module(hm);
+	}
+	if (kf->protect) freemem(kf->protect);
+	freemem(kf);
+}
+
+static char *known_file_key(char *path, struct stat *st)
+{
+	char *key = getmem(strlen(path) + 96);
+
+	sprintf(key, "%lx:%lx:%lx.%lx:%lx", (unsigned long)st->st_dev,
+		(unsigned long)st->st_ino, (unsigned long)st->st_mtime,
+		ST_MTIME_NSEC(st), (unsigned long)st->st_size);
+	if (st->st_ino == 0) {
+		strcat(key, ":");
+		strcat(key, path);
+	}
+	return key;
+}
+
+static struct known_file *get_known_file(char *path, struct stat *st)
+{
+	struct known_file *kf;
+	char *key = known_file_key(path, st);
+
+	if (!known_files_init_done) {
+		HTT_init(&known_files, del_known_file);
+		known_files_init_done = 1;
+	}
+	kf = HTT_get(&known_files, key);
+	if (!kf) {
+		kf = getmem(sizeof(struct known_file));
+		kf->protect = 0;
+		kf->once = 0;
+		kf->entered = include_serial - 1;
+		kf->modules = 0;
+		kf->no_module = 0;
+		HTT_put(&known_files, kf, key);
+	}
+	freemem(key);
+	return kf;
+}
+
+/*
+ * A known file need not be read if it used #pragma once and was already
+ * included in this translation unit, or if its guardian macro is defined.
+ */
+static int skip_known_file(struct known_file *kf)
+{
+	if (kf->once && kf->entered == include_serial) {
+		if (recorded_module) note_module_once(kf);
+		return 1;
+	}
+	return kf->protect && get_macro(kf->protect);
+}
+
+/*
+ * Open an include file candidate, unless it is known not to exist.
+ * *kf receives the session entry of the file if it exists; when it is
+ * set but 0 is returned, the file does not need to be read.
+ */
+static FILE *fopen_include_file(char *path, struct known_file **kf)
+{
+	char *base;
+	struct include_dir *id = get_include_dir(path, &base);
+	struct stat st;
+	FILE *f;
+
+	*kf = 0;
+	if (HTT_get(&id->misses, base)) return 0;
+	if (stat(path, &st) < 0) {
+		if (errno == ENOENT || errno == ENOTDIR) {
+			hash_item_header *miss =
+				getmem(sizeof(hash_item_header));
+
+			HTT_put(&id->misses, miss, base);
+		}
+		return 0;
+	}
+	*kf = get_known_file(path, &st);
+	if (skip_known_file(*kf)) return 0;
+#ifdef UCPP_MMAP
+	f = fopen_mmap_file(path);
+#else
+	f = fopen(path, "r");
+#endif
+	if (!f) *kf = 0;
+	return f;
+}
+
+/*
+ * Release the include lookup cache and the header knowledge; they are
+ * otherwise kept until the end of the session.
+ */
+void free_include_cache(void)
+{
+	drop_module_record();
+	if (include_dirs_init_done) HTT_kill(&include_dirs);
+	include_dirs_init_done = 0;
+	if (known_files_init_done) HTT_kill(&known_files);
+	known_files_init_done = 0;
+}
+
 static void init_found_files(void)
 {
+	include_serial ++;
 	if (found_files_init_done) HTT_kill(&found_files);
 	HTT_init(&found_files, del_found_file);
 	found_files_init_done = 1;
@@ -320,6 +615,182 @@ static void init_found_files(void)
 	found_files_sys_init_done = 1;
 }
 
+/*
+ * The state of the preprocessor at the end of a translation unit can be
+ * written with write_cpp_state(), and loaded at the beginning of another
+ * one with read_cpp_state(); this is how a prefix header is precompiled.
+ * The image holds:
+ * -- each file found in the translation unit, with its size and date
+ *    (seconds, then nanoseconds where known), and what is known of its guardian macro and #pragma once; the image
+ *    is out of date if one of these files changed;
+ * -- the macros (special ones included) and the assertions.
+ * Numbers are 32-bit little-endian words; a string is written as its
+ * length, trailing 0 included, followed by its characters.
+ */
+#define STATE_MAGIC	0x32505355UL	/* "USP2" */
+
+void put_state_word(FILE *f, unsigned long x)
+{
+	putc((int)(x & 0xFF), f);
+	putc((int)((x >> 8) & 0xFF), f);
+	putc((int)((x >> 16) & 0xFF), f);
+	putc((int)((x >> 24) & 0xFF), f);
+}
+
+void put_state_string(FILE *f, char *s)
+{
+	size_t n = strlen(s) + 1;
+
+	put_state_word(f, (unsigned long)n);
+	fwrite(s, 1, n, f);
+}
+
+unsigned long get_state_word(struct state_reader *r)
+{
+	unsigned char *p = r->p;
+
+	if (r->failed || r->end - p < 4) {
+		r->failed = 1;
+		return 0;
+	}
+	r->p += 4;
+	return (unsigned long)p[0] | ((unsigned long)p[1] << 8)
+		| ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+/*
+ * The returned string points into the image.
+ */
+char *get_state_string(struct state_reader *r)
+{
+	unsigned long n = get_state_word(r);
+	char *s = (char *)r->p;
+
+	if (r->failed || n == 0 || (unsigned long)(r->end - r->p) < n
+		|| s[n - 1] != 0) {
+		r->failed = 1;
+		return "";
+	}
+	r->p += n;
+	return s;
+}
+
+/*
+ * get_file_stamp() fills fs with the size and modification time of the
+ * named file; if it can't be stat()ed, fs is zeroed and -1 is returned.
+ */
+int get_file_stamp(char *name, struct file_stamp *fs)
+{
+	struct stat st;
+
+	if (stat(name, &st) < 0) {
+		fs->size = fs->mtime = fs->mtime_nsec = 0;
+		return -1;
+	}
+	fs->size = (unsigned long)st.st_size;
+	fs->mtime = (unsigned long)st.st_mtime;
+	fs->mtime_nsec = ST_MTIME_NSEC(&st);
+	return 0;
+}
+
+static void (*found_file_action)(char *);
+
+static void scan_found_file(void *m)
+{
+	found_file_action(HASH_ITEM_NAME((struct found_file *)m));
+}
+
+/*
+ * scan_found_files() calls action with the name of each file found in
+ * this translation unit, the main file included.
+ */
+void scan_found_files(void (*action)(char *))
+{
+	if (!found_files_init_done) return;
+	found_file_action = action;
+	HTT_scan(&found_files, scan_found_file);
+}
+
+static FILE *state_output;
+
+static void write_found_file(void *m)
+{
+	struct found_file *ff = (struct found_file *)m;
+	struct known_file *kf = ff->kf;
+	struct file_stamp fs;
+	char *protect = kf ? kf->protect : ff->protect;
+
+	get_file_stamp(HASH_ITEM_NAME(ff), &fs);
+	put_state_string(state_output, HASH_ITEM_NAME(ff));
+	put_state_word(state_output, fs.size);
+	put_state_word(state_output, fs.mtime);
+	put_state_word(state_output, fs.mtime_nsec);
+	put_state_string(state_output, protect ? protect : "");
+	put_state_word(state_output, (kf && kf->once ? 1UL : 0UL)
+		| (!kf || kf->entered == include_serial ? 2UL : 0UL));
+}
+
+/*
+ * write_cpp_state() returns non-zero on error.
+ */
+int write_cpp_state(FILE *f)
+{
+	put_state_word(f, STATE_MAGIC);
+	state_output = f;
+	if (found_files_init_done) {
+		put_state_word(f, (unsigned long)found_files.count);
+		HTT_scan(&found_files, write_found_file);
+	} else put_state_word(f, 0);
+	write_macros(f);
+	write_assertions(f);
+	return ferror(f) != 0;
+}
+
+/*
+ * read_cpp_state() only checks the image if apply is 0; otherwise, the
+ * macros and assertions of the image replace the current ones, and the
+ * files it records are considered included in this translation unit if
+ * they were in the saved one. It returns the size of the image, or -1
+ * if the image is malformed or out of date; apply should be used only
+ * with an image that passed the check.
+ */
+long read_cpp_state(unsigned char *buf, size_t len, int apply)
+{
+	struct state_reader r;
+	unsigned long n, i;
+
+	r.p = buf;
+	r.end = buf + len;
+	r.failed = 0;
+	if (get_state_word(&r) != STATE_MAGIC) return -1;
+	n = get_state_word(&r);
+	for (i = 0; i < n && !r.failed; i ++) {
+		struct stat st;
+		char *name = get_state_string(&r);
+		unsigned long size = get_state_word(&r);
+		unsigned long mtime = get_state_word(&r);
+		unsigned long mtime_nsec = get_state_word(&r);
+		char *protect = get_state_string(&r);
+		unsigned long flags = get_state_word(&r);
+		struct known_file *kf;
+
+		if (r.failed || stat(name, &st) < 0
+			|| ((unsigned long)st.st_size & 0xFFFFFFFFUL) != size
+			|| ((unsigned long)st.st_mtime & 0xFFFFFFFFUL) != mtime
+			|| ST_MTIME_NSEC(&st) != mtime_nsec)
+			return -1;
+		if (!apply) continue;
+		kf = get_known_file(name, &st);
+		if (*protect && !kf->protect) kf->protect = sdup(protect);
+		if (flags & 1) kf->once = 1;
+		if (flags & 2) kf->entered = include_serial;
+	}
+	read_macros(&r, apply);
+	read_assertions(&r, apply);
+	if (r.failed) return -1;
+	return (long)(r.p - buf);
+}
+
 /*
  * Set the lexer state at the beginning of a file.
  */
@@ -382,6 +853,8 @@ void init_lexer_state(struct lexer_state *ls)
 {
 	init_buf_lexer_state(ls, 1);
 	ls->input = 0;
+	ls->context_name = 0;
+	ls->context_changed = 0;
 }
 
 /*
@@ -416,11 +889,7 @@ static void restore_lexer_state(struct lexer_state *ls,
 static void close_input(struct lexer_state *ls)
 {
 #ifdef UCPP_MMAP
-	if (ls->from_mmap) {
-		munmap((void *)ls->input_buf, ls->ebuf);
-		ls->from_mmap = 0;
-		ls->input_buf = ls->input_buf_sav;
-	}
+	if (ls->from_mmap) unmap_input_file(ls);
 #endif
 	if (ls->input) {
 		fclose(ls->input);
@@ -564,6 +1033,10 @@ static void print_line_info(struct lexer_state *ls, unsigned long flags)
  * As a command-line option, gcc-like directives (with only a '#',
  * without 'line') may be produced.
  *
+ * In STAMP_CONTEXT lexer mode, no token is produced; the new file name
+ * is recorded in the struct lexer_state for the client to pick up with
+ * the next token.
+ *
  * enter_file() returns 1 if a (CONTEXT) token was produced, 0 otherwise.
  */
 int enter_file(struct lexer_state *ls, unsigned long flags)
@@ -571,6 +1044,12 @@ int enter_file(struct lexer_state *ls, unsigned long flags)
 	char *fn = current_long_filename ?
 		current_long_filename : current_filename;
 
+	if ((flags & LEXER) && (flags & STAMP_CONTEXT)) {
+		ls->context_name = fn;
+		ls->context_changed = 1;
+		if (recorded_module) recorded_context = fn;
+		return 0;
+	}
 	if (!(flags & LINE_NUM)) return 0;
 	if ((flags & LEXER) && !(flags & TEXT_OUTPUT)) {
 		struct token t;
@@ -588,43 +1067,85 @@ int enter_file(struct lexer_state *ls, unsigned long flags)
 
 #ifdef UCPP_MMAP
 /*
- * We open() the file, then fdopen() it and fseek() to its end. If the
- * fseek() worked, we try to mmap() the file, up to the point where we
- * arrived.
+ * We open() the file and fstat() it. A non empty regular file is either
+ * read whole with read() (below UCPP_MMAP_MIN bytes) or mmap()ed and
+ * advised for sequential access; in both cases the descriptor is left at
+ * the end of the file, so that the FILE returned reads nothing more once
+ * the buffer is consumed. Anything else (pipes, terminals, devices) and
+ * files we could neither read nor map go through the standard fread()
+ * path on the FILE.
  * On an architecture where end-of-lines are multibytes and translated
- * into single '\n', bad things could happen. We strongly hope that, if
- * we could fseek() to the end but could not mmap(), then we can get back.
+ * into single '\n', bad things could happen.
  */
-static void *find_file_map;
+static unsigned char *find_file_map;
 static size_t map_length;
+static int map_kind;
+
+static int read_whole_file(int fd, unsigned char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t r = read(fd, buf, len);
+
+		if (r <= 0) return 0;	/* error, or the file shrank */
+		buf += r;
+		len -= r;
+	}
+	return 1;
+}
+
+static void drop_file_map(void)
+{
+	if (map_kind == MMAP_INPUT) {
+		munmap((void *)find_file_map, map_length);
+	} else {
+		freemem(find_file_map);
+	}
+	find_file_map = 0;
+}
 
 FILE *fopen_mmap_file(char *name)
 {
 	FILE *f;
+	struct stat st;
 	int fd;
-	long l;
 
 	find_file_map = 0;
 	fd = open(name, O_RDONLY, 0);
 	if (fd < 0) return 0;
-	l = lseek(fd, 0, SEEK_END);
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0
+		&& (off_t)(size_t)st.st_size == st.st_size) {
+		map_length = st.st_size;
+		if (map_length < UCPP_MMAP_MIN) {
+			find_file_map = getmem(map_length);
+			map_kind = READ_INPUT;
+			if (!read_whole_file(fd, find_file_map, map_length))
+				drop_file_map();
+		} else {
+			void *m = mmap(0, map_length, PROT_READ,
+				MAP_PRIVATE, fd, 0);
+
+			if (m != MAP_FAILED) {
+				posix_madvise(m, map_length,
+					POSIX_MADV_SEQUENTIAL);
+				find_file_map = m;
+				map_kind = MMAP_INPUT;
+			}
+		}
+		/* past the buffered part, or back to the start for fread() */
+		if (lseek(fd, find_file_map ? (off_t)map_length : 0,
+			SEEK_SET) < 0) {
+			/* bwaah... can't get there. This file is cursed. */
+			if (find_file_map) drop_file_map();
+			close(fd);
+			return 0;
+		}
+	}
 	f = fdopen(fd, "r");
 	if (!f) {
+		if (find_file_map) drop_file_map();
 		close(fd);
 		return 0;
 	}
-	if (l < 0) return f;	/* not seekable */
-	map_length = l;
-	if ((find_file_map = mmap(0, map_length, PROT_READ,
-		MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
-		/* we could not mmap() the file; get back */
-		find_file_map = 0;
-		if (fseek(f, 0, SEEK_SET)) {
-			/* bwaah... can't get back. This file is cursed. */
-			fclose(f);
-			return 0;
-		}
-	}
 	return f;
 }
 
@@ -632,15 +1153,31 @@ void set_input_file(struct lexer_state *ls, FILE *f)
 {
 	ls->input = f;
 	if (find_file_map) {
-		ls->from_mmap = 1;
+		ls->from_mmap = map_kind;
 		ls->input_buf_sav = ls->input_buf;
 		ls->input_buf = find_file_map;
 		ls->pbuf = 0;
 		ls->ebuf = map_length;
+		find_file_map = 0;
 	} else {
 		ls->from_mmap = 0;
 	}
 }
+
+/*
+ * Release the mapped or preloaded input of a lexer_state and get back
+ * its own input buffer.
+ */
+void unmap_input_file(struct lexer_state *ls)
+{
+	if (ls->from_mmap == MMAP_INPUT) {
+		munmap((void *)ls->input_buf, ls->ebuf);
+	} else {
+		freemem(ls->input_buf);
+	}
+	ls->from_mmap = 0;
+	ls->input_buf = ls->input_buf_sav;
+}
 #endif
 
 /*
@@ -664,6 +1201,7 @@ static FILE *find_file(char *name, int localdir)
 	size_t nl = strlen(name);
 	char *s = 0;
 	struct found_file *ff = 0, *nff;
+	struct known_file *kf = 0;
 	int lf = 0;
 	int nffa = 0;
 
@@ -728,13 +1266,7 @@ static FILE *find_file(char *name, int localdir)
 	 */
 	protect_detect.ff = new_found_file();
 	nffa = 1;
-	if (localdir &&
-#ifdef UCPP_MMAP
-		(f = fopen_mmap_file(s ? s : name))
-#else
-		(f = fopen(s ? s : name, "r"))
-#endif
-		) {
+	if (localdir && ((f = fopen_include_file(s ? s : name, &kf)) || kf)) {
 		lf = 1;
 		goto found_file;
 	}
@@ -796,12 +1328,8 @@ static FILE *find_file(char *name, int localdir)
 			}
 			goto found_file_cache;
 		}
-#ifdef UCPP_MMAP
-		f = fopen_mmap_file(s);
-#else
-		f = fopen(s, "r");
-#endif
-		if (f) goto found_file;
+		f = fopen_include_file(s, &kf);
+		if (f || kf) goto found_file;
 		freemem(s);
 		s = 0;
 	}
@@ -819,6 +1347,10 @@ zero_out:
 	 * cache.
 	 */
 found_file_cache:
+	if (ff->kf && skip_known_file(ff->kf)) {
+		find_file_error = FF_PROTECT;
+		goto zero_out;
+	}
 	if (ff->protect) {
 		if (get_macro(ff->protect)) {
 			/* file is protected, do not include it */
@@ -836,6 +1368,7 @@ found_file_cache:
 	f = fopen(HASH_ITEM_NAME(ff), "r");
 #endif
 	if (!f) goto zero_out;
+	if (ff->kf) ff->kf->entered = include_serial;
 	find_file_error = FF_KNOWN;
 	goto found_file_2;
 
@@ -845,6 +1378,8 @@ found_file_cache:
 	 * otherwise it was found in some system include directory.
 	 * A new found_file structure has been allocated and is in
 	 * protect_detect.ff
+	 * If f is 0, the file exists but is known not to need reading;
+	 * it is recorded all the same, for the next lookups.
 	 */
 found_file:
 	if (f && ((emit_dependencies == 1 && lf && current_incdir == -1)
@@ -853,6 +1388,8 @@ found_file:
 	}
 	nff = protect_detect.ff;
 	nff->name = sdup(name);
+	nff->kf = kf;
+	if (kf && kf->protect) nff->protect = sdup(kf->protect);
 #ifdef AUDIT
 	if (
 #endif
@@ -870,6 +1407,16 @@ found_file:
 	}
 	if (s) freemem(s);
 	s = 0;
+	if (!f) {
+		find_file_error = FF_PROTECT;
+		nffa = 0;
+		goto zero_out;
+	}
+	if (kf) {
+		kf->entered = include_serial;
+		/* the guardian is already known */
+		if (kf->protect) protect_detect.state = 0;
+	}
 	find_file_error = FF_UNKNOWN;
 	ff = nff;
 
@@ -895,6 +1442,7 @@ static FILE *find_file_next(char *name)
 	size_t nl = strlen(name);
 	FILE *f;
 	struct found_file *ff;
+	struct known_file *kf;
 
 	find_file_error = FF_ERROR;
 	protect_detect.state = -1;
@@ -918,6 +1466,11 @@ static FILE *find_file_next(char *name)
 		ff = HTT_get(&found_files, s);
 		if (ff) {
 			/* file was found in the cache */
+			if (ff->kf && skip_known_file(ff->kf)) {
+				find_file_error = FF_PROTECT;
+				freemem(s);
+				return 0;
+			}
 			if (ff->protect) {
 				if (get_macro(ff->protect)) {
 					find_file_error = FF_PROTECT;
@@ -939,21 +1492,20 @@ static FILE *find_file_next(char *name)
 				freemem(s);
 				return 0;
 			}
+			if (ff->kf) ff->kf->entered = include_serial;
 			find_file_error = FF_KNOWN;
 			freemem(s);
 			s = HASH_ITEM_NAME(ff);
 		} else {
-#ifdef UCPP_MMAP
-			f = fopen_mmap_file(s);
-#else
-			f = fopen(s, "r");
-#endif
-			if (f) {
-				if (emit_dependencies == 2) {
+			f = fopen_include_file(s, &kf);
+			if (f || kf) {
+				if (f && emit_dependencies == 2) {
 					fprintf(emit_output, " %s", s);
 				}
-				ff = protect_detect.ff = new_found_file();
+				ff = new_found_file();
 				ff->name = sdup(s);
+				ff->kf = kf;
+				if (kf->protect) ff->protect = sdup(kf->protect);
 #ifdef AUDIT
 				if (
 #endif
@@ -962,8 +1514,15 @@ static FILE *find_file_next(char *name)
 				) ouch("filename collided with a wraith")
 #endif
 				;
-				find_file_error = FF_UNKNOWN;
 				freemem(s);
+				if (!f) {
+					find_file_error = FF_PROTECT;
+					return 0;
+				}
+				protect_detect.ff = ff;
+				kf->entered = include_serial;
+				if (kf->protect) protect_detect.state = 0;
+				find_file_error = FF_UNKNOWN;
 				s = HASH_ITEM_NAME(ff);
 			}
 		}
@@ -1090,6 +1649,7 @@ static int handle_if(struct lexer_state *ls)
 			int av = 0;
 			struct token rt;
 
+			spoil_header_module();
 			atl.art = atl.nt = 0;
 			while (i < tf1.nt && ttMWS(tf1.t[i].type)) i ++;
 			if (i >= tf1.nt) goto assert_error;
@@ -1187,6 +1747,239 @@ error1:
 	return -1;
 }
 
+static void del_header_module(struct header_module *hm)
+{
+	size_t i;
+
+	freemem(hm->name);
+	for (i = 0; i < hm->nincpath; i ++) freemem(hm->incpath[i]);
+	if (hm->nincpath) freemem(hm->incpath);
+	if (hm->key.name) {
+		free_macro_set(&hm->key);
+		free_macro_set(&hm->delta);
+	}
+	for (i = 0; i < hm->nfile; i ++) freemem(hm->file[i].path);
+	if (hm->nfile) freemem(hm->file);
+	if (hm->nonce) freemem(hm->once);
+	for (i = 0; i < hm->nt; i ++)
+		if (S_TOKEN(hm->t[i].type)) freemem(hm->t[i].name);
+	freemem(hm->t);
+	freemem(hm);
+}
+
+/*
+ * the header being recorded cannot be replayed from a module
+ */
+void spoil_header_module(void)
+{
+	if (recorded_module) recorded_spoilt = 1;
+}
+
+/*
+ * start recording the header that was just opened
+ */
+static void start_module_record(struct known_file *kf)
+{
+	struct header_module *hm = getmem(sizeof(struct header_module));
+	size_t i;
+
+	hm->next = 0;
+	hm->name = sdup(current_long_filename);
+	hm->incdir = current_incdir;
+	hm->nincpath = include_path_nb;
+	if (include_path_nb)
+		hm->incpath = getmem(include_path_nb * sizeof(char *));
+	for (i = 0; i < include_path_nb; i ++)
+		hm->incpath[i] = sdup(include_path[i]);
+	hm->key.name = hm->delta.name = 0;
+	hm->nfile = hm->nonce = hm->nt = 0;
+	hm->t = getmem((hm->tmax = 256) * sizeof(struct token));
+	recorded_module = hm;
+	recorded_kf = kf;
+	recorded_depth = ls_depth;
+	recorded_context = 0;
+	recorded_spoilt = 0;
+	record_macro_uses();
+}
+
+static void record_module_token(struct lexer_state *ls)
+{
+	struct header_module *hm = recorded_module;
+	struct token t;
+
+	if (recorded_context) {
+		t.type = CONTEXT;
+		t.line = ls->ctok->line;
+		t.name = sdup(recorded_context);
+		wan(hm->t, hm->nt, t, hm->tmax);
+		recorded_context = 0;
+	}
+	t = *(ls->ctok);
+	if (S_TOKEN(t.type)) t.name = sdup(t.name);
+	wan(hm->t, hm->nt, t, hm->tmax);
+}
+
+static int module_reads_file(struct header_module *hm, struct known_file *kf)
+{
+	size_t i;
+
+	if (kf == recorded_kf) return 1;
+	for (i = 0; i < hm->nfile; i ++) if (hm->file[i].kf == kf) return 1;
+	return 0;
+}
+
+/*
+ * the header being recorded reads a file...
+ */
+static void note_module_file(struct known_file *kf, char *path)
+{
+	struct module_file mf;
+
+	if (module_reads_file(recorded_module, kf)) return;
+	mf.kf = kf;
+	mf.path = sdup(path);
+	aol(recorded_module->file, recorded_module->nfile, mf,
+		MODULE_LIST_MEMG);
+}
+
+/*
+ * ...or skips it, as it uses #pragma once and was read before
+ */
+static void note_module_once(struct known_file *kf)
+{
+	struct header_module *hm = recorded_module;
+	size_t i;
+
+	if (module_reads_file(hm, kf)) return;
+	for (i = 0; i < hm->nonce; i ++) if (hm->once[i] == kf) return;
+	aol(hm->once, hm->nonce, kf, MODULE_LIST_MEMG);
+}
+
+/*
+ * the header being recorded is complete; its module is kept if the
+ * header is protected
+ */
+static void end_module_record(void)
+{
+	struct header_module *hm = recorded_module, **p;
+	struct known_file *kf = recorded_kf;
+	int n;
+
+	recorded_module = 0;
+	if (recorded_spoilt || (!kf->protect && !kf->once)) {
+		end_macro_uses(0, 0);
+		del_header_module(hm);
+		kf->no_module = 1;
+		return;
+	}
+	end_macro_uses(&hm->key, &hm->delta);
+	hm->next = kf->modules;
+	kf->modules = hm;
+	for (n = 1, p = &hm->next; *p; p = &((*p)->next))
+		if (++ n > HEADER_MODULE_VARIANTS) {
+			del_header_module(*p);
+			*p = 0;
+			break;
+		}
+}
+
+static void drop_module_record(void)
+{
+	if (!recorded_module) return;
+	end_macro_uses(0, 0);
+	del_header_module(recorded_module);
+	recorded_module = 0;
+}
+
+/*
+ * check whether a module of the header that was just opened applies;
+ * return value: 1 if it does, 0 if it does not, -1 if one of the files
+ * it read was modified (it will never apply again)
+ */
+static int check_header_module(struct header_module *hm)
+{
+	size_t i;
+
+	if (strcmp(hm->name, current_long_filename)
+		|| hm->incdir != current_incdir
+		|| hm->nincpath != include_path_nb) return 0;
+	for (i = 0; i < include_path_nb; i ++)
+		if (strcmp(hm->incpath[i], include_path[i])) return 0;
+	for (i = 0; i < hm->nonce; i ++)
+		if (hm->once[i]->entered != include_serial) return 0;
+	for (i = 0; i < hm->nfile; i ++) {
+		struct known_file *kf = hm->file[i].kf;
+
+		if (kf->once && kf->entered == include_serial) return 0;
+	}
+	if (!check_macro_set(&hm->key)) return 0;
+	for (i = 0; i < hm->nfile; i ++) {
+		struct stat st;
+		char *key;
+		int same;
+
+		if (stat(hm->file[i].path, &st) < 0) return -1;
+		key = known_file_key(hm->file[i].path, &st);
+		same = !strcmp(key, HASH_ITEM_NAME(hm->file[i].kf));
+		freemem(key);
+		if (!same) return -1;
+	}
+	return 1;
+}
+
+/*
+ * Replace the header that was just opened with one of its modules, if
+ * one applies: its macros are set, and its tokens are put in the output
+ * fifo, followed by the context of the includer.
+ * return value: 1 if the header was replaced, 0 otherwise
+ */
+static int import_header_module(struct lexer_state *ls,
+	struct known_file *kf)
+{
+	struct header_module *hm, **p;
+	struct token_fifo *tf;
+	size_t i;
+	int x;
+
+	for (p = &(kf->modules); (hm = *p) != 0;) {
+		if ((x = check_header_module(hm)) > 0) break;
+		if (x < 0) {
+			*p = hm->next;
+			del_header_module(hm);
+		} else p = &(hm->next);
+	}
+	if (!hm) return 0;
+	*p = hm->next;
+	hm->next = kf->modules;
+	kf->modules = hm;
+	apply_macro_set(&hm->delta);
+	for (i = 0; i < hm->nfile; i ++)
+		hm->file[i].kf->entered = include_serial;
+	if (recorded_module) {
+		note_module_file(kf, hm->name);
+		for (i = 0; i < hm->nfile; i ++)
+			note_module_file(hm->file[i].kf, hm->file[i].path);
+		for (i = 0; i < hm->nonce; i ++)
+			note_module_once(hm->once[i]);
+	}
+	pop_file_context(ls);
+	tf = ls->output_fifo;
+	tf->t = getmem((hm->nt + 1) * sizeof(struct token));
+	mmv(tf->t, hm->t, hm->nt * sizeof(struct token));
+	tf->nt = hm->nt;
+	tf->art = 0;
+	if ((ls->flags & LEXER) && (ls->flags & (STAMP_CONTEXT | LINE_NUM))) {
+		struct token *t = tf->t + (tf->nt ++);
+
+		t->type = CONTEXT;
+		t->line = ls->line;
+		t->name = current_long_filename ? current_long_filename
+			: current_filename;
+	}
+	if (tf->nt == 0) freemem(tf->t);
+	return 1;
+}
+
 /*
  * A #include was found; parse the end of line, replace macros if
  * necessary.
@@ -1207,6 +2000,8 @@ static int handle_include(struct lexer_state *ls, unsigned long flags, int nex)
 	size_t nl;
 	int tgd;
 	struct lexer_state alt_ls;
+	struct known_file *kf;
+	int modules;
 
 #define left_angle(t)	((t) == LT || (t) == LEQ || (t) == LSH \
 			|| (t) == ASLSH || (t) == DIG_LBRK || (t) == LBRA)
@@ -1421,12 +2216,20 @@ do_include_next:
 		freemem(fname);
 		return 0;
 	}
+	kf = protect_detect.ff ? protect_detect.ff->kf : 0;
 #ifdef UCPP_MMAP
 	set_input_file(ls, f);
 #else
 	ls->input = f;
 #endif
 	current_filename = fname;
+	modules = header_modules && kf && (ls->flags & LEXER)
+		&& !emit_dependencies;
+	if (modules && import_header_module(ls, kf)) return 0;
+	if (recorded_module) {
+		if (kf) note_module_file(kf, current_long_filename);
+		else spoil_header_module();
+	} else if (modules && !kf->no_module) start_module_record(kf);
 	enter_file(ls, flags);
 	return 0;
 
@@ -1618,9 +2421,20 @@ struct comp_token_fifo compress_token_list(struct token_fifo *tf)
 }
 #endif
 
+/*
+ * #pragma once: the current file is not to be read again in this
+ * translation unit. The main file has no session entry and is left
+ * alone.
+ */
+static void pragma_once(void)
+{
+	if (protect_detect.ff && protect_detect.ff->kf)
+		protect_detect.ff->kf->once = 1;
+}
+
 /*
  * A #pragma directive: we make a PRAGMA token containing the rest of
- * the line.
+ * the line; #pragma once is handled here and produces no token.
  *
  * We strongly hope that we are called only in LEXER mode.
  */
@@ -1650,6 +2464,13 @@ static void handle_pragma(struct lexer_state *ls)
 		/* void pragma are silently ignored */
 		return;
 	}
+	if (tf.nt == 1 && tf.t[0].type == NAME
+		&& !strcmp(tf.t[0].name, "once")) {
+		freemem(tf.t[0].name);
+		freemem(tf.t);
+		pragma_once();
+		return;
+	}
 	buf = (compress_token_list(&tf)).t;
 #else
 	int c, x = 1, y = 32;
@@ -1669,6 +2490,11 @@ static void handle_pragma(struct lexer_state *ls)
 	for (x --; x >= 0 && space_char(buf[x]); x --);
 	x ++;
 	wan(buf, x, 0, y);
+	if (!strcmp((char *)buf, "once")) {
+		freemem(buf);
+		pragma_once();
+		return;
+	}
 #endif
 	t.type = PRAGMA;
 	t.line = l;
@@ -1882,14 +2708,17 @@ static int handle_cpp(struct lexer_state *ls, int sharp_type)
 				handle_error(ls);
 				goto handle_exit;
 			} else if (!strcmp(ls->ctok->name, "line")) {
+				spoil_header_module();
 				ret = handle_line(ls, save_flags);
 				goto handle_exit;
 			} else if ((ls->flags & HANDLE_ASSERTIONS)
 				&& !strcmp(ls->ctok->name, "assert")) {
+				spoil_header_module();
 				ret = handle_assert(ls);
 				goto handle_exit;
 			} else if ((ls->flags & HANDLE_ASSERTIONS)
 				&& !strcmp(ls->ctok->name, "unassert")) {
+				spoil_header_module();
 				ret = handle_unassert(ls);
 				goto handle_exit;
 			}
@@ -1963,6 +2792,7 @@ static int handle_cpp(struct lexer_state *ls, int sharp_type)
 	return 1;
 
 handle_warp_ign:
+	if (!ls->condcomp) skip_false_code(ls, 1);
 	while (!next_token(ls)) if (ls->ctok->type == NEWLINE) break;
 	goto handle_exit;
 handle_warp:
@@ -2004,6 +2834,8 @@ int cpp(struct lexer_state *ls)
 {
 	int r = 0;
 
+	/* in code compiled out, go straight to the next directive */
+	if (!ls->condcomp && ls->ltwnl) skip_false_code(ls, 0);
 	while (next_token(ls)) {
 		if (protect_detect.state == 3) {
 			/*
@@ -2015,6 +2847,10 @@ int cpp(struct lexer_state *ls)
 				/* Cool ! A new guardian has been detected. */
 				protect_detect.ff->protect =
 					protect_detect.macro;
+				if (protect_detect.macro && protect_detect.ff->kf
+					&& !protect_detect.ff->kf->protect)
+					protect_detect.ff->kf->protect =
+						sdup(protect_detect.macro);
 			} else if (protect_detect.macro) {
 				/* We found a guardian but an old one. */
 				freemem(protect_detect.macro);
@@ -2027,6 +2863,8 @@ int cpp(struct lexer_state *ls)
 			r = CPPERR_NEST;
 		}
 		if (ls_depth == 0) return CPPERR_EOF;
+		if (recorded_module && ls_depth == recorded_depth)
+			end_module_record();
 		close_input(ls);
 		if (!(ls->flags & LEXER) && !ls->ltwnl) put_char(ls, '\n');
 		pop_file_context(ls);
@@ -2143,6 +2981,7 @@ int lex(struct lexer_state *ls)
 	} while (!r && (!ls->condcomp || (ttWHI(ls->ctok->type) &&
 		(!(ls->flags & LINE_NUM) || ls->ctok->type != NEWLINE))));
 #endif
+	if (!r && recorded_module) record_module_token(ls);
 	return r;
 }
 #endif
@@ -2178,10 +3017,9 @@ void init_cpp(void)
 }
 
 /*
- * (re)init the global tables.
- * If standard_assertions is non 0, init the assertions table.
+ * init the tables that are not saved by save_tables()
  */
-void init_tables(int with_assertions)
+static void init_tu_tables(void)
 {
 	time_t t;
 	struct tm *ct;
@@ -2212,9 +3050,51 @@ void init_tables(int with_assertions)
 	strftime(compile_time, 12, "\"%H:%M:%S\"", ct);
 	strftime(compile_date, 24, "\"%b %d %Y\"", ct);
 #endif
+	init_found_files();
+}
+
+/*
+ * (re)init the global tables.
+ * If standard_assertions is non 0, init the assertions table.
+ */
+void init_tables(int with_assertions)
+{
+	init_tu_tables();
 	init_macros();
 	if (with_assertions) init_assertions();
-	init_found_files();
+}
+
+/*
+ * save_tables() keeps a copy of the macro and assertion tables, as they
+ * stand after init_tables() and the initial definitions. For each next
+ * translation unit, restore_tables() then replaces init_tables() and
+ * these definitions: the tables are copied back, sharing their items
+ * with the saved ones (an item is copied only when modified). The static
+ * tables set up by init_cpp() and set_identifier_char() are left alone
+ * by wipeout(), hence need not be built again either.
+ *
+ * restore_tables() returns 0 (and does nothing) if nothing was saved.
+ * free_saved_tables() releases the saved tables; it must be called after
+ * wipeout(), and before save_tables() is called again.
+ */
+void save_tables(void)
+{
+	save_macros();
+	save_assertions();
+}
+
+int restore_tables(void)
+{
+	if (!restore_macros()) return 0;
+	init_tu_tables();
+	if (!restore_assertions()) wipe_assertions();
+	return 1;
+}
+
+void free_saved_tables(void)
+{
+	free_saved_macros();
+	free_saved_assertions();
 }
 
 /*
@@ -2280,6 +3160,7 @@ void wipeout()
 #ifdef PRAGMA_TOKENIZE
 	free_lexer_state(&tokenize_lexer);
 #endif
+	drop_module_record();
 	if (found_files_init_done) HTT_kill(&found_files);
 	found_files_init_done = 0;
 	if (found_files_sys_init_done) HTT_kill(&found_files_sys);
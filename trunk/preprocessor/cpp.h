@@ -149,7 +149,7 @@ struct lexer_state {
 #ifndef NO_UCPP_BUF
 	unsigned char *input_buf;
 #ifdef UCPP_MMAP
-	int from_mmap;
+	int from_mmap;		/* MMAP_INPUT, READ_INPUT or 0 */
 	unsigned char *input_buf_sav;
 #endif
 #endif
@@ -179,6 +179,8 @@ struct lexer_state {
 	size_t tknl;
 	int ltwnl;
 	int pending_token;
+	char *context_name;	/* current file name, in STAMP_CONTEXT mode */
+	int context_changed;	/* context_name changed since last reset */
 #ifdef INMACRO_FLAG
 	int inmacro;
 	long macro_count;
@@ -233,6 +235,11 @@ struct lexer_state {
 #define READ_AGAIN	     0x080000UL	/* emit again the last token */
 #define TEXT_OUTPUT	     0x100000UL	/* output text */
 
+/* lexer mode: emit neither NEWLINE nor CONTEXT tokens; file changes
+   are recorded in context_name/context_changed instead (use without
+   LINE_NUM) */
+#define STAMP_CONTEXT	     0x200000UL
+
 /*
  * Public function prototypes
  */
@@ -262,14 +269,32 @@ int lex(struct lexer_state *);
 int check_cpp_errors(struct lexer_state *);
 void add_incpath(char *);
 void init_tables(int);
+void save_tables(void);
+int restore_tables(void);
+void free_saved_tables(void);
+int write_cpp_state(FILE *);
+long read_cpp_state(unsigned char *, size_t, int);
+
+/* hcc - what the checks of saved images compare to tell a file changed */
+struct file_stamp {
+	unsigned long size, mtime, mtime_nsec;
+};
+
+int get_file_stamp(char *, struct file_stamp *);
+void scan_found_files(void (*)(char *));
 int enter_file(struct lexer_state *, unsigned long);
 int cpp(struct lexer_state *);
 void set_identifier_char(int c);
 void unset_identifier_char(int c);
+void free_include_cache(void);
 
 #ifdef UCPP_MMAP
+#define MMAP_INPUT	1	/* input_buf is the mmap()ed file */
+#define READ_INPUT	2	/* input_buf holds the whole file */
+
 FILE *fopen_mmap_file(char *);
 void set_input_file(struct lexer_state *, FILE *);
+void unmap_input_file(struct lexer_state *);
 #endif
 
 struct stack_context {
@@ -281,7 +306,9 @@ struct stack_context *report_context(void);
 extern int no_special_macros, system_macros,
 	emit_dependencies, emit_defines, emit_assertions;
 extern int c99_compliant, c99_hosted;
+extern int header_modules;
 extern FILE *emit_output;
+extern unsigned long macro_lookups, macro_lookups_filtered;
 extern char *current_filename, *current_long_filename;
 extern char *operators_name[];
 extern struct protect {
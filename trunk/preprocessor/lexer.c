@@ -344,6 +344,66 @@ static struct machine_state {
 static int cppm[MSTATE][MAX_CHAR_VAL];
 static int cppm_vch[MSTATE];
 
+/*
+ * Character classes for skip_false_code().
+ */
+#define SKC_NL		1	/* '\n', '\r' */
+#define SKC_SLASH	2	/* '/' */
+#define SKC_QUOTE	4	/* '"', '\'' */
+#define SKC_BS		8	/* '\\', and '?' for ??/ */
+#define SKC_STAR	16	/* '*' */
+
+static unsigned char skip_class[UCHAR_MAX + 1];
+
+static void init_skip_class(void)
+{
+	skip_class['\n'] = skip_class['\r'] = SKC_NL;
+	skip_class['/'] = SKC_SLASH;
+	skip_class['"'] = skip_class['\''] = SKC_QUOTE;
+	skip_class['\\'] = skip_class['?'] = SKC_BS;
+	skip_class['*'] = SKC_STAR;
+}
+
+/*
+ * Runs. Once an identifier, a number or some whitespace has started,
+ * the automaton loops in the same state for each character of the same
+ * class; read_run() consumes such runs directly from the input buffer.
+ * run_class[] is derived from cppm[][]; the characters that may start
+ * a trigraph, a line splice or an end of line never belong to a run,
+ * so that they always go through next_char().
+ */
+#define RUN_NAME	1
+#define RUN_NUMBER	2
+#define RUN_SPACE	4
+
+static unsigned char run_class[UCHAR_MAX + 1];
+static int run_swar_names;	/* all of [0-9A-Za-z_] are RUN_NAME */
+
+static void init_run_class(void)
+{
+	static int st[3] = { S_NAME, S_NUMBER, S_SPACE };
+	int c, i;
+
+	for (c = 0; c <= UCHAR_MAX; c ++) {
+		run_class[c] = 0;
+		if (c == '?' || c == '\\' || c == '\r' || c == '\n') continue;
+		for (i = 0; i < 3; i ++) {
+			int x = cppm[st[i]][c < MAX_CHAR_VAL ? c : 0];
+
+			if (!ttSTO(x) && !ttFRZ(x) && noMOD(x) == st[i])
+				run_class[c] |= 1 << i;
+		}
+	}
+	run_swar_names = (run_class['_'] & RUN_NAME) != 0;
+	for (c = 0; c < 26; c ++) {
+		if (!(run_class['a' + c] & RUN_NAME)
+			|| !(run_class['A' + c] & RUN_NAME))
+			run_swar_names = 0;
+	}
+	for (c = '0'; c <= '9'; c ++)
+		if (!(run_class[c] & RUN_NAME)) run_swar_names = 0;
+}
+
 /*
  * init_cppm() fills cppm[][] with the information stored in cppms[].
  * It must be called before beginning the lexing process.
@@ -397,6 +457,8 @@ void init_cppm(void)
 			break;
 		}
 	}
+	init_skip_class();
+	init_run_class();
 }
 
 /*
@@ -406,6 +468,7 @@ void set_identifier_char(int c)
 {
 	cppm[S_START][c] = PUT(S_NAME);
 	cppm[S_NAME][c] = PUT(S_NAME);
+	init_run_class();
 }
 
 /*
@@ -415,6 +478,7 @@ void unset_identifier_char(int c)
 {
 	cppm[S_START][c] = S_ILL;
 	cppm[S_NAME][c] = FRZ(STO(NAME));
+	init_run_class();
 }
 
 int space_char(int c)
@@ -492,11 +556,7 @@ static inline int read_char(struct lexer_state *ls)
 #ifndef NO_UCPP_BUF
 		if (ls->pbuf == ls->ebuf) {
 #ifdef UCPP_MMAP
-			if (ls->from_mmap) {
-				munmap((void *)ls->input_buf, ls->ebuf);
-				ls->from_mmap = 0;
-				ls->input_buf = ls->input_buf_sav;
-			}
+			if (ls->from_mmap) unmap_input_file(ls);
 #endif
 			ls->ebuf = fread(ls->input_buf, 1,
 				INPUT_BUF_MEMG, ls->input);
@@ -656,6 +716,115 @@ void discard_char(struct lexer_state *ls)
 	if (ls->last == '\n') ls->line ++;
 }
 
+/*
+ * Code compiled out. In a false conditional block, all that matters is
+ * where the next directive is; running the automaton on every token,
+ * only to drop it, is a waste. skip_false_code() walks over the text
+ * with the little knowledge needed to find the beginning of logical
+ * lines: comments, character constants, string literals and line
+ * splices. It stops before a '#' (or a '%', maybe starting %:) that
+ * begins a line, or at the end of input; if to_eol is set, it stops
+ * before the newline that ends the current logical line instead.
+ *
+ * Characters are read with next_char(), so trigraphs, splices and line
+ * endings are handled as usual; runs of characters that cannot change
+ * the scanner state are stepped over directly in the input buffer.
+ * An unterminated literal ends with its line; there is no point in
+ * complaining about code that is not compiled.
+ */
+enum { SK_CODE, SK_SLASH, SK_CMT, SK_CMT_STAR, SK_LCMT, SK_STR, SK_STR_ESC };
+
+void skip_false_code(struct lexer_state *ls, int to_eol)
+{
+	int state = SK_CODE, bol = !to_eol, quote = 0, c, mask;
+	long l = ls->line;
+
+	if (ls->pending_token || (ls->flags & READ_AGAIN)) return;
+	while (1) {
+#ifndef NO_UCPP_BUF
+		switch (state) {
+		case SK_CODE:
+			mask = bol ? 0 : SKC_NL | SKC_SLASH | SKC_QUOTE
+				| SKC_BS;
+			break;
+		case SK_CMT: mask = SKC_NL | SKC_STAR; break;
+		case SK_LCMT: mask = SKC_NL | SKC_BS; break;
+		case SK_STR: mask = SKC_NL | SKC_QUOTE | SKC_BS; break;
+		default: mask = 0; break;
+		}
+		if (mask && ls->discard && !ls->nlka && !ls->macfile
+			&& !(ls->flags & COPY_LINE)) {
+			unsigned char *buf = ls->input ? ls->input_buf
+				: ls->input_string;
+			size_t p = ls->pbuf, e = ls->ebuf;
+
+			while (p < e && !(skip_class[buf[p]] & mask)) p ++;
+			ls->pbuf = p;
+		}
+#endif
+		if ((c = next_char(ls)) < 0) {
+			if (state == SK_CMT || state == SK_CMT_STAR)
+				error(l, "truncated comment");
+			return;
+		}
+		switch (state) {
+		case SK_CODE:
+			if (c == '\n') {
+				if (to_eol) return;
+				bol = 1;
+			} else if (bol && (c == '#' || c == '%')) {
+				return;
+			} else if (c == '/') {
+				state = SK_SLASH;
+			} else if (!space_char(c)) {
+				bol = 0;
+				if (c == '"' || c == '\'') {
+					state = SK_STR;
+					quote = c;
+				}
+			}
+			break;
+		case SK_SLASH:
+			if (c == '*') {
+				state = SK_CMT;
+				l = ls->line;
+			} else if (c == '/' && (ls->flags & CPLUSPLUS_COMMENTS)) {
+				state = SK_LCMT;
+			} else {
+				/* a lone slash; read c again as code */
+				bol = 0;
+				state = SK_CODE;
+				continue;
+			}
+			break;
+		case SK_CMT:
+			if (c == '*') state = SK_CMT_STAR;
+			break;
+		case SK_CMT_STAR:
+			if (c == '/') state = SK_CODE;
+			else if (c != '*') state = SK_CMT;
+			break;
+		case SK_LCMT:
+			if (c == '\n') {
+				state = SK_CODE;
+				continue;
+			}
+			break;
+		case SK_STR:
+		case SK_STR_ESC:
+			if (c == '\n') {
+				state = SK_CODE;
+				continue;
+			}
+			if (state == SK_STR_ESC) state = SK_STR;
+			else if (c == '\\') state = SK_STR_ESC;
+			else if (c == quote) state = SK_CODE;
+			break;
+		}
+		discard_char(ls);
+	}
+}
+
 /*
  * Convert an UTF-8 encoded character to a Universal Character Name
  * using \u (or \U when appropriate).
@@ -779,6 +948,86 @@ canon_error:
 	*d = 0;
 }
 
+#ifndef NO_UCPP_BUF
+#ifdef UCPP_SWAR
+#define SWAR_ONES	0x0101010101010101ULL
+#define SWAR_HIGH	(SWAR_ONES * 0x80)
+#define SWAR_LOW	(SWAR_ONES * 0x7F)
+
+/* top bit set in each byte of x that is zero */
+#define SWAR_ZERO(x)	(~((((x) & SWAR_LOW) + SWAR_LOW) | (x) | SWAR_LOW))
+
+/* top bit set in each byte of x within lo..hi; bytes must be below 0x80 */
+#define SWAR_IN(x, lo, hi)	(((x) + SWAR_ONES * (0x80 - (lo))) \
+				& ~((x) + SWAR_ONES * (0x7F - (hi))) & SWAR_HIGH)
+
+/*
+ * Are the eight bytes at p all letters, digits or underscores?
+ */
+static inline int swar_name8(unsigned char *p)
+{
+	unsigned long long x;
+
+	memcpy(&x, p, 8);
+	if (x & SWAR_HIGH) return 0;
+	return (SWAR_IN(x, '0', '9')
+		| SWAR_IN(x | (SWAR_ONES * 0x20), 'a', 'z')
+		| SWAR_ZERO(x ^ (SWAR_ONES * '_'))) == SWAR_HIGH;
+}
+
+/*
+ * Are the eight bytes at p all spaces or tabs?
+ */
+static inline int swar_space8(unsigned char *p)
+{
+	unsigned long long x;
+
+	memcpy(&x, p, 8);
+	return (SWAR_ZERO(x ^ (SWAR_ONES * ' '))
+		| SWAR_ZERO(x ^ (SWAR_ONES * '\t'))) == SWAR_HIGH;
+}
+#endif
+
+/*
+ * Consume the rest of a run of the current state cstat from the input
+ * buffer, appending it to the token name when the automaton would.
+ * The caller has checked that no character is pending in the
+ * look-ahead and that nothing needs to be output or copied on the way.
+ * Returns the new token length.
+ */
+static size_t read_run(struct lexer_state *ls, int cstat, size_t ltok)
+{
+	unsigned char *buf = ls->input ? ls->input_buf : ls->input_string;
+	size_t b = ls->pbuf, p = b, e = ls->ebuf;
+	int bit = cstat == S_NAME ? RUN_NAME
+		: cstat == S_NUMBER ? RUN_NUMBER : RUN_SPACE;
+
+#ifdef UCPP_SWAR
+	if (cstat == S_NAME && run_swar_names) {
+		while (e - p >= 8 && swar_name8(buf + p)) p += 8;
+	} else if (cstat == S_SPACE && (run_class['\t'] & RUN_SPACE)) {
+		while (e - p >= 8 && swar_space8(buf + p)) p += 8;
+	}
+#endif
+	while (p < e && (run_class[buf[p]] & bit)) p ++;
+	if (p == b) return ltok;
+	if (ttPUT(cppm[cstat][buf[b] < MAX_CHAR_VAL ? buf[b] : 0])) {
+		size_t n = p - b, l = ls->tknl;
+
+		while (ltok + n >= l) l += l;
+		if (l != ls->tknl) {
+			ls->ctok->name = incmem(ls->ctok->name, ltok, l);
+			ls->tknl = l;
+		}
+		mmv(ls->ctok->name + ltok, buf + b, n);
+		ltok += n;
+	}
+	ls->last = buf[p - 1];
+	ls->pbuf = p;
+	return ltok;
+}
+#endif
+
 /*
  * Run the automaton, in order to get the next token.
  * This function should not be called, except by next_token()
@@ -979,6 +1228,13 @@ static inline int read_token(struct lexer_state *ls)
 			break;
 		}
 		cstat = noMOD(nstat);
+#ifndef NO_UCPP_BUF
+		if ((cstat == S_NAME || cstat == S_NUMBER || cstat == S_SPACE)
+			&& ls->discard && !ls->nlka && !ls->macfile
+			&& (ls->flags & LEXER) && !(ls->flags
+				& (COPY_LINE | UTF8_SOURCE)))
+			ltok = read_run(ls, cstat, ltok);
+#endif
 	} while (1);
 	if (!(ls->flags & LEXER) && (ls->flags & DISCARD_COMMENTS)
 			&& ls->ctok->type == COMMENT) put_char(ls, ' ');
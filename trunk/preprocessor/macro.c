@@ -43,6 +43,141 @@
 static HTT macros;
 static int macros_init_done = 0;
 
+/*
+ * Most names looked up are not macros. The macro_filter bitset is a
+ * Bloom filter of the macro names: each name sets two bits, chosen
+ * within the same 64-byte line, so that a name that is not a macro is
+ * usually ruled out with a single cache line read, without probing the
+ * hash table. Bits cannot be cleared on #undef, so the filter is
+ * rebuilt when undefined names make up more than half of its content.
+ *
+ * macro_lookups counts the lookups of a name in the macro table, and
+ * macro_lookups_filtered those that were answered by the filter alone.
+ */
+#define MACRO_FILTER_LINES	256
+#define MACRO_FILTER_LINE_BITS	512
+
+static unsigned char macro_filter[MACRO_FILTER_LINES
+	* (MACRO_FILTER_LINE_BITS / 8)];
+static size_t macro_filter_names = 0, macro_filter_stale = 0;
+
+unsigned long macro_lookups = 0, macro_lookups_filtered = 0;
+
+/*
+ * macro_generation is bumped each time a macro is defined or undefined;
+ * a memoized expansion (see substitute_macro()) is valid only for the
+ * generation it was computed in.
+ */
+static unsigned long macro_generation = 1;
+
+/*
+ * expansion_volatile is set when the expansion in progress depends on
+ * something else than the macro definitions: tokens read from the input
+ * to complete a macro call, a special macro, or a diagnostic.
+ */
+static int expansion_volatile = 0;
+
+static unsigned long macro_filter_hash(char *name)
+{
+	unsigned long h = 2166136261UL;
+
+	for (; *name; name ++) {
+		h ^= *(unsigned char *)name;
+		h = (h * 16777619UL) & 0xFFFFFFFFUL;
+	}
+	h ^= h >> 15;
+	h = (h * 0x2C1B3C6DUL) & 0xFFFFFFFFUL;
+	h ^= h >> 12;
+	return h;
+}
+
+#define MF_LINE(h)	(macro_filter + ((h) % MACRO_FILTER_LINES) \
+				* (MACRO_FILTER_LINE_BITS / 8))
+#define MF_BIT1(h)	(((h) >> 8) % MACRO_FILTER_LINE_BITS)
+#define MF_BIT2(h)	(((h) >> 17) % MACRO_FILTER_LINE_BITS)
+
+static void macro_filter_add(char *name)
+{
+	unsigned long h = macro_filter_hash(name);
+	unsigned char *line = MF_LINE(h);
+
+	line[MF_BIT1(h) >> 3] |= 1 << (MF_BIT1(h) & 7);
+	line[MF_BIT2(h) >> 3] |= 1 << (MF_BIT2(h) & 7);
+	macro_filter_names ++;
+}
+
+static void macro_filter_add_item(void *m)
+{
+	macro_filter_add(HASH_ITEM_NAME(m));
+}
+
+static void macro_filter_clear(void)
+{
+	memset(macro_filter, 0, sizeof macro_filter);
+	macro_filter_names = macro_filter_stale = 0;
+}
+
+/*
+ * called after a macro was removed from the table
+ */
+static void macro_filter_remove(void)
+{
+	if (++ macro_filter_stale * 2 > macro_filter_names
+		&& macro_filter_stale >= 64) {
+		macro_filter_clear();
+		HTT_scan(&macros, macro_filter_add_item);
+	}
+}
+
+/*
+ * recording_uses is set while a header module is recorded, see
+ * record_macro_uses()
+ */
+static int recording_uses = 0;
+
+static void note_macro_use(char *);
+static void note_macro_set(char *);
+
+/*
+ * find a macro from its name, through the filter
+ */
+static inline struct macro *find_macro(char *name)
+{
+	unsigned long h = macro_filter_hash(name);
+	unsigned char *line = MF_LINE(h);
+
+	macro_lookups ++;
+	if (!(line[MF_BIT1(h) >> 3] & (1 << (MF_BIT1(h) & 7)))
+		|| !(line[MF_BIT2(h) >> 3] & (1 << (MF_BIT2(h) & 7)))) {
+		macro_lookups_filtered ++;
+		return 0;
+	}
+	return HTT_get(&macros, name);
+}
+
+/*
+ * the same, for a use of the name by the source
+ */
+static inline struct macro *lookup_macro(char *name)
+{
+	if (recording_uses) note_macro_use(name);
+	return find_macro(name);
+}
+
+static void put_macro(struct macro *m, char *name)
+{
+	HTT_put(&macros, m, name);
+	macro_filter_add(name);
+	macro_generation ++;
+}
+
+static void del_macro_name(char *name)
+{
+	HTT_del(&macros, name);
+	macro_filter_remove();
+	macro_generation ++;
+}
+
 static void del_macro(void *m)
 {
 	struct macro *n = m;
@@ -60,6 +195,12 @@ static void del_macro(void *m)
 		freemem(n->val.t);
 	}
 #endif
+	if (n->memo.nt) {
+		for (i = 0; i < n->memo.nt; i ++)
+			if (S_TOKEN(n->memo.t[i].type))
+				freemem(n->memo.t[i].name);
+		freemem(n->memo.t);
+	}
 	freemem(n);
 }
 
@@ -75,6 +216,8 @@ static inline struct macro *new_macro(void)
 	m->val.nt = m->val.art = 0;
 #endif
 	m->vaarg = 0;
+	m->memo.nt = m->memo.art = 0;
+	m->memo_gen = 0;
 	return m;
 }
 
@@ -119,14 +262,14 @@ static void add_special_macros(void)
 {
 	struct macro *m;
 
-	HTT_put(&macros, new_macro(), "__LINE__");
-	HTT_put(&macros, new_macro(), "__FILE__");
-	HTT_put(&macros, new_macro(), "__DATE__");
-	HTT_put(&macros, new_macro(), "__TIME__");
-	HTT_put(&macros, new_macro(), "__STDC__");
+	put_macro(new_macro(), "__LINE__");
+	put_macro(new_macro(), "__FILE__");
+	put_macro(new_macro(), "__DATE__");
+	put_macro(new_macro(), "__TIME__");
+	put_macro(new_macro(), "__STDC__");
 	m = new_macro(); m->narg = 1;
 	m->arg = getmem(sizeof(char *)); m->arg[0] = sdup("foo");
-	HTT_put(&macros, m, "_Pragma");
+	put_macro(m, "_Pragma");
 	if (c99_compliant) {
 #ifndef LOW_MEM
 		struct token t;
@@ -144,7 +287,7 @@ static void add_special_macros(void)
 		t.name = sdup("199901L");
 		aol(m->val.t, m->val.nt, t, TOKEN_LIST_MEMG);
 #endif
-		HTT_put(&macros, m, "__STDC_VERSION__");
+		put_macro(m, "__STDC_VERSION__");
 	}
 	if (c99_hosted) {
 #ifndef LOW_MEM
@@ -163,7 +306,7 @@ static void add_special_macros(void)
 		t.name = sdup("1");
 		aol(m->val.t, m->val.nt, t, TOKEN_LIST_MEMG);
 #endif
-		HTT_put(&macros, m, "__STDC_HOSTED__");
+		put_macro(m, "__STDC_HOSTED__");
 	}
 }
 
@@ -356,7 +499,15 @@ int handle_define(struct lexer_state *ls)
 	 * Since it is easy to avoid this error (with a #undef directive),
 	 * we choose to enforce the rule and emit an error.
 	 */
-	if ((n = HTT_get(&macros, mname)) != 0) {
+	/*
+	 * whether this is a redefinition, and an identical one, depends
+	 * on the definition found here: it is part of the key
+	 */
+	if (recording_uses) {
+		note_macro_use(mname);
+		note_macro_set(mname);
+	}
+	if ((n = find_macro(mname)) != 0) {
 		/* redefinition of a macro: we must check that we define
 		   it identical */
 		redef = 1;
@@ -669,7 +820,7 @@ define_end:
 		if (mval.nt) freemem(mval.t);
 	}
 #endif
-	HTT_put(&macros, m, mname);
+	put_macro(m, mname);
 	freemem(mname);
 	if (emit_defines) print_macro(m);
 	return 0;
@@ -721,7 +872,8 @@ static int collect_arguments(struct lexer_state *ls, struct token_fifo *tfi,
 
 #define unravel(ls)	(read_from_fifo = 0, !((tfi && tfi->art < tfi->nt \
 	&& (read_from_fifo = 1) != 0 && (ct = tfi->t + (tfi->art ++))) \
-	|| ((!tfi || penury) && !next_token(ls) && (ct = (ls)->ctok))))
+	|| ((!tfi || penury) && (expansion_volatile = 1) != 0 \
+	&& !next_token(ls) && (ct = (ls)->ctok))))
 
 	/*
 	 * collect_arguments() is assumed to setup correctly atl
@@ -838,29 +990,33 @@ too_many_args:
 	}
 	return 4;
 harvested:
-	if (i > 127 && (ls->flags & WARN_STANDARD))
+	if (i > 127 && (ls->flags & WARN_STANDARD)) {
+		expansion_volatile = 1;
 		warning(begin_line, "macro call with %d arguments (ISO "
 			"specifies 127 max)", i);
+	}
 	return 0;
 #undef unravel
 }
 
 /*
- * concat_token() is called when the ## operator is used. It uses
- * the struct lexer_state dsharp_lexer to parse the result of the
- * concatenation.
+ * relex_token() pastes two tokens by running the concatenation of their
+ * spellings through the struct lexer_state dsharp_lexer. On success, the
+ * resulting token is stored in r; its name, if any, is a fresh copy.
  *
  * Law enforcement: if the whole string does not produce a valid
- * single token, an error (non-zero result) is returned.
+ * single token, an error (non-zero result) is returned. This includes
+ * characters left in the look-ahead (as for '?' '.'), which are also
+ * dropped so that they do not leak into the next concatenation.
  */
 struct lexer_state dsharp_lexer;
 
-static inline int concat_token(struct token *t1, struct token *t2)
+static int relex_token(struct token *t1, struct token *t2, struct token *r)
 {
 	char *n1 = token_name(t1), *n2 = token_name(t2);
 	size_t l1 = strlen(n1), l2 = strlen(n2);
 	unsigned char *x = getmem(l1 + l2 + 1);
-	int r;
+	int e;
 
 	mmv(x, n1, l1);
 	mmv(x + l1, n2, l2);
@@ -872,11 +1028,93 @@ static inline int concat_token(struct token *t1, struct token *t2)
 	dsharp_lexer.discard = 1;
 	dsharp_lexer.flags = DEFAULT_LEXER_FLAGS;
 	dsharp_lexer.pending_token = 0;
-	r = next_token(&dsharp_lexer);
+	dsharp_lexer.nlka = 0;
+	dsharp_lexer.macfile = 0;
+	e = next_token(&dsharp_lexer);
 	freemem(x);
-	return (r == 1 || dsharp_lexer.pbuf < (l1 + l2)
+	if (e == 1 || dsharp_lexer.pbuf < (l1 + l2)
 		|| dsharp_lexer.pending_token
-		|| (dsharp_lexer.pbuf == (l1 + l2) && !dsharp_lexer.discard));
+		|| (dsharp_lexer.nlka > 0 && dsharp_lexer.lka[0] >= 0)
+		|| (dsharp_lexer.pbuf == (l1 + l2) && !dsharp_lexer.discard))
+		return 1;
+	r->type = dsharp_lexer.ctok->type;
+	if (S_TOKEN(r->type)) r->name = sdup(dsharp_lexer.ctok->name);
+	return 0;
+}
+
+/*
+ * The spelling of an operator depends only on its type, so the result
+ * of pasting two operators into another operator is remembered in
+ * paste_table, indexed by the two types: PASTE_UNKNOWN, or PASTE_TYPE +
+ * the type of the resulting operator. Only pastes that give an operator
+ * spelled as the concatenation are remembered; the others (invalid, or
+ * involving comments or trigraphs) are re-lexed, and diagnosed, each
+ * time.
+ */
+#define PASTE_UNKNOWN	0
+#define PASTE_TYPE	1
+
+static unsigned char paste_table[LAST_MEANINGFUL_TOKEN][LAST_MEANINGFUL_TOKEN];
+
+/*
+ * a spelling made only of letters, digits and underscores
+ */
+static inline int plain_word(char *c)
+{
+	for (; *c; c ++)
+		if (!((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z')
+			|| (*c >= '0' && *c <= '9') || *c == '_'))
+			return 0;
+	return 1;
+}
+
+/*
+ * concat_token() is called when the ## operator is used. It stores
+ * the resulting token in r, with a fresh copy of its name if any, and
+ * returns non-zero if the two tokens do not paste into a single valid
+ * token.
+ *
+ * Two operators are pasted through paste_table. An identifier or a
+ * number followed by an identifier or a number, all made of letters,
+ * digits and underscores, is respectively an identifier or a number.
+ * Other cases are re-lexed with relex_token().
+ */
+static inline int concat_token(struct token *t1, struct token *t2,
+	struct token *r)
+{
+	if (!S_TOKEN(t1->type) && !S_TOKEN(t2->type)
+		&& t1->type < LAST_MEANINGFUL_TOKEN
+		&& t2->type < LAST_MEANINGFUL_TOKEN) {
+		unsigned char *p = &paste_table[t1->type][t2->type];
+
+		if (*p == PASTE_UNKNOWN) {
+			char *n1 = operators_name[t1->type];
+			char *n;
+			size_t l1 = strlen(n1);
+
+			if (relex_token(t1, t2, r)) return 1;
+			n = operators_name[r->type];
+			if (r->type >= SLASH && r->type < LAST_MEANINGFUL_TOKEN
+				&& !ttWHI(r->type) && !strncmp(n, n1, l1)
+				&& !strcmp(n + l1, operators_name[t2->type]))
+				*p = (unsigned char)(PASTE_TYPE + r->type);
+			return 0;
+		}
+		r->type = *p - PASTE_TYPE;
+		return 0;
+	}
+	if ((t1->type == NAME || t1->type == NUMBER)
+		&& (t2->type == NAME || t2->type == NUMBER)
+		&& plain_word(t1->name) && plain_word(t2->name)) {
+		size_t l1 = strlen(t1->name), l2 = strlen(t2->name);
+
+		r->type = t1->type;
+		r->name = getmem(l1 + l2 + 1);
+		mmv(r->name, t1->name, l1);
+		mmv(r->name + l1, t2->name, l2 + 1);
+		return 0;
+	}
+	return relex_token(t1, t2, r);
 }
 
 #ifdef PRAGMA_TOKENIZE
@@ -1007,6 +1245,68 @@ static char *stringify(struct token_fifo *tf)
  */
 char compile_time[12], compile_date[24];
 
+/*
+ * Once an object-like macro has been expanded at toplevel, its fully
+ * rescanned replacement is kept in m->memo, so that the next uses splice
+ * these tokens in the output instead of substituting the macro again.
+ * This is done only when the expansion did not depend on its context
+ * (expansion_volatile), and the memo is discarded when any macro is
+ * defined or undefined (macro_generation).
+ *
+ * The spliced tokens share their names with the memo: they are read
+ * from the output fifo before the next directive may remove the macro.
+ */
+static void memo_store(struct lexer_state *ls, struct macro *m,
+	size_t start, long l)
+{
+	struct token_fifo *of = ls->output_fifo;
+	size_t i;
+
+	for (i = start; i < of->nt; i ++)
+		if (of->t[i].line != l) return;
+	if (m->memo.nt) {
+		for (i = 0; i < m->memo.nt; i ++)
+			if (S_TOKEN(m->memo.t[i].type))
+				freemem(m->memo.t[i].name);
+		freemem(m->memo.t);
+		m->memo.nt = 0;
+	}
+	for (i = start; i < of->nt; i ++) {
+		struct token t = of->t[i];
+
+		if (S_TOKEN(t.type)) t.name = sdup(t.name);
+		aol(m->memo.t, m->memo.nt, t, TOKEN_LIST_MEMG);
+	}
+	m->memo_gen = macro_generation;
+}
+
+static void memo_splice(struct lexer_state *ls, struct macro *m, long l)
+{
+	size_t i;
+
+	for (i = 0; i < m->memo.nt; i ++) {
+		struct token t = m->memo.t[i];
+
+		t.line = l;
+		aol(ls->output_fifo->t, ls->output_fifo->nt, t,
+			TOKEN_LIST_MEMG);
+	}
+}
+
+/*
+ * An argument that appears several times in the replacement list is
+ * macro-expanded only for its first appearance; the other appearances
+ * copy the tokens that this expansion left in the expanded list (the
+ * range from start to end), unless the expansion depended on anything
+ * else than the argument (expansion_volatile).
+ */
+enum { AX_NONE, AX_SHARED, AX_VOLATILE };
+
+struct arg_expansion {
+	int state;
+	size_t start, end;
+};
+
 /*
  * substitute_macro() performs the macro substitution. It is called when
  * an identifier recognized as a macro name has been found; this function
@@ -1029,11 +1329,14 @@ int substitute_macro(struct lexer_state *ls, struct macro *m,
 {
 	char *mname = HASH_ITEM_NAME(m);
 	struct token_fifo *atl, etl;
-	struct token t, *ct;
+	struct token t, pt, *ct;
 	int i, save_nest = m->nest;
 	size_t save_art, save_tfi, etl_limit;
 	int ltwds, ntwds, ltwws;
 	int pragma_op = 0;
+	int memo = 0;
+	size_t memo_start = 0;
+	struct arg_expansion *axl = 0;
 
 	/*
 	 * Reject the replacement, if we are already inside the macro.
@@ -1046,6 +1349,20 @@ int substitute_macro(struct lexer_state *ls, struct macro *m,
 		return 0;
 	}
 
+	/*
+	 * A toplevel object-like macro may reuse its memoized expansion.
+	 */
+	if (!tfi && !reject_nested && m->narg < 0 && (ls->flags & LEXER)
+		&& l == ls->line) {
+		if (m->memo_gen == macro_generation) {
+			memo_splice(ls, m, l);
+			return 0;
+		}
+		memo = 1;
+		memo_start = ls->output_fifo->nt;
+		expansion_volatile = 0;
+	}
+
 	/*
 	 * put a separation from preceeding tokens
 	 */
@@ -1056,6 +1373,9 @@ int substitute_macro(struct lexer_state *ls, struct macro *m,
 	 */
 	if ((i = check_special_macro(mname)) >= MAC_SPECIAL) {
 		/* we have a special macro */
+		expansion_volatile = 1;
+		if (i == MAC_FILE || i == MAC_DATE || i == MAC_TIME)
+			spoil_header_module();
 		switch (i) {
 			char buf[30], *bbuf, *cfn;
 
@@ -1284,7 +1604,7 @@ collect_args:
 
 #define ZAP_LINE(t)	do { \
 		if ((t).type == NAME) { \
-			struct macro *zlm = HTT_get(&macros, (t).name); \
+			struct macro *zlm = lookup_macro((t).name); \
 			if (zlm && zlm->nest > reject_nested) \
 				(t).line = -1 - (t).line; \
 		} \
@@ -1368,7 +1688,8 @@ collect_args:
 			z = ct->line;	/* the argument number is there */
 			if (ltwds && atl[z].nt != 0 && etl.nt) {
 				if (concat_token(etl.t + (-- etl.nt),
-					atl[z].t)) {
+					atl[z].t, &pt)) {
+					expansion_volatile = 1;
 					warning(ls->line, "operator '##' "
 						"produced the invalid token "
 						"'%s%s'",
@@ -1398,11 +1719,10 @@ collect_args:
 						aol(etl.t, etl.nt, t,
 							TOKEN_LIST_MEMG);
 					}
-					t.type = dsharp_lexer.ctok->type;
+					t.type = pt.type;
 					t.line = ls->line;
 					if (S_TOKEN(t.type)) {
-						t.name = sdup(dsharp_lexer
-							.ctok->name);
+						t.name = pt.name;
 						throw_away(ls->gf, t.name);
 					}
 					ZAP_LINE(t);
@@ -1427,11 +1747,21 @@ collect_args:
 					ZAP_LINE(t);
 					aol(etl.t, etl.nt, t, TOKEN_LIST_MEMG);
 				}
+			} else if (axl && axl[z].state == AX_SHARED
+				&& axl[z].end <= etl.nt) {
+				size_t u;
+
+				for (u = axl[z].start; u < axl[z].end; u ++) {
+					t = etl.t[u];
+					aol(etl.t, etl.nt, t, TOKEN_LIST_MEMG);
+				}
 			} else {
 				struct token_fifo *save_tf;
 				unsigned long save_flags;
-				int ret = 0;
+				int ret = 0, save_volatile = expansion_volatile;
+				size_t start = etl.nt;
 
+				expansion_volatile = 0;
 				atl[z].art = 0;
 				save_tf = ls->output_fifo;
 				ls->output_fifo = &etl;
@@ -1444,7 +1774,7 @@ collect_args:
 					cct = atl[z].t + (atl[z].art ++);
 					if (cct->type == NAME
 						&& cct->line >= 0
-						&& (nm = HTT_get(&macros,
+						&& (nm = lookup_macro(
 						    cct->name))
 						&& nm->nest <=
 						    (reject_nested + 1)) {
@@ -1467,6 +1797,20 @@ collect_args:
 #endif
 					goto exit_error_2;
 				}
+				if (!axl) {
+					size_t u, n = m->narg + m->vaarg;
+
+					axl = getmem(n * sizeof *axl);
+					for (u = 0; u < n; u ++)
+						axl[u].state = AX_NONE;
+				}
+				if (axl[z].state == AX_NONE) {
+					axl[z].state = expansion_volatile
+						? AX_VOLATILE : AX_SHARED;
+					axl[z].start = start;
+					axl[z].end = etl.nt;
+				}
+				expansion_volatile |= save_volatile;
 			}
 			if (!ntwds && (!etl.nt
 				|| !ttWHI(etl.t[etl.nt - 1].type))) {
@@ -1510,7 +1854,8 @@ collect_args:
 			ltwds = 1;
 			continue;
 		} else if (ltwds && etl.nt != 0) {
-			if (concat_token(etl.t + (-- etl.nt), ct)) {
+			if (concat_token(etl.t + (-- etl.nt), ct, &pt)) {
+				expansion_volatile = 1;
 				warning(ls->line, "operator '##' produced "
 					"the invalid token '%s%s'",
 					token_name(etl.t + etl.nt),
@@ -1528,10 +1873,10 @@ collect_args:
 				etl.nt ++;
 			} else {
 				if (etl.nt == 0) freemem(etl.t);
-				t.type = dsharp_lexer.ctok->type;
+				t.type = pt.type;
 				t.line = ls->line;
 				if (S_TOKEN(t.type)) {
-					t.name = sdup(dsharp_lexer.ctok->name);
+					t.name = pt.name;
 					throw_away(ls->gf, t.name);
 				}
 				ct = &t;
@@ -1615,7 +1960,7 @@ collect_args:
 
 		ct = etl.t + (etl.art ++);
 		if (ct->type == NAME && ct->line >= 0
-			&& (nm = HTT_get(&macros, ct->name))) {
+			&& (nm = lookup_macro(ct->name))) {
 			if (substitute_macro(ls, nm, &etl,
 				penury, reject_nested, l)) {
 				m->nest = save_nest;
@@ -1646,7 +1991,9 @@ exit_macro_2:
 	for (i = 0; i < (m->narg + m->vaarg); i ++)
 		if (atl[i].nt) freemem(atl[i].t);
 	if (m->narg > 0 || m->vaarg) freemem(atl);
+	if (axl) freemem(axl);
 	m->nest = save_nest;
+	if (memo && !expansion_volatile) memo_store(ls, m, memo_start, l);
 	return 0;
 
 exit_error_2:
@@ -1655,6 +2002,7 @@ exit_error_1:
 	for (i = 0; i < (m->narg + m->vaarg); i ++)
 		if (atl[i].nt) freemem(atl[i].t);
 	if (m->narg > 0 || m->vaarg) freemem(atl);
+	if (axl) freemem(axl);
 	m->nest = save_nest;
 exit_error:
 	return 1;
@@ -1711,7 +2059,7 @@ int define_macro(struct lexer_state *ls, char *def)
 		if (!*c) {
 			error(-1, "void macro name");
 			ret = 1;
-		} else if ((m = HTT_get(&macros, c))
+		} else if ((m = lookup_macro(c))
 #ifdef LOW_MEM
 			&& (m->cval.length != 3
 			|| m->cval.t[0] != NUMBER
@@ -1740,7 +2088,7 @@ int define_macro(struct lexer_state *ls, char *def)
 			t.name = sdup("1");
 			aol(m->val.t, m->val.nt, t, TOKEN_LIST_MEMG);
 #endif
-			HTT_put(&macros, m, c);
+			put_macro(m, c);
 		}
 	}
 	freemem(c);
@@ -1764,11 +2112,11 @@ int undef_macro(struct lexer_state *ls, char *def)
 		error(-1, "void macro name");
 		return 1;
 	}
-	if (HTT_get(&macros, c)) {
+	if (lookup_macro(c)) {
 		if (check_special_macro(c)) {
 			error(-1, "trying to undef special macro %s", c);
 			return 1;
-		} else HTT_del(&macros, c);
+		} else del_macro_name(c);
 	}
 	return 0;
 }
@@ -1785,7 +2133,7 @@ int handle_ifdef(struct lexer_state *ls)
 		if (ls->ctok->type == NEWLINE) break;
 		if (ttMWS(ls->ctok->type)) continue;
 		if (ls->ctok->type == NAME) {
-			int x = (HTT_get(&macros, ls->ctok->name) != 0);
+			int x = (lookup_macro(ls->ctok->name) != 0);
 			while (!next_token(ls) && ls->ctok->type != NEWLINE)
 				if (tgd && !ttWHI(ls->ctok->type)
 					&& (ls->flags & WARN_STANDARD)) {
@@ -1820,9 +2168,12 @@ int handle_undef(struct lexer_state *ls)
 		if (ls->ctok->type == NEWLINE) break;
 		if (ttMWS(ls->ctok->type)) continue;
 		if (ls->ctok->type == NAME) {
-			struct macro *m = HTT_get(&macros, ls->ctok->name);
+			struct macro *m;
 			int tgd = 1;
 
+			if (recording_uses) note_macro_set(ls->ctok->name);
+			m = find_macro(ls->ctok->name);
+
 			if (m != 0) {
 				if (check_special_macro(ls->ctok->name)) {
 					error(ls->line, "trying to undef "
@@ -1833,7 +2184,7 @@ int handle_undef(struct lexer_state *ls)
 				if (emit_defines)
 					fprintf(emit_output, "#undef %s\n",
 						ls->ctok->name);
-				HTT_del(&macros, ls->ctok->name);
+				del_macro_name(ls->ctok->name);
 			}
 			while (!next_token(ls) && ls->ctok->type != NEWLINE)
 				if (tgd && !ttWHI(ls->ctok->type)
@@ -1865,7 +2216,7 @@ int handle_ifndef(struct lexer_state *ls)
 		if (ls->ctok->type == NEWLINE) break;
 		if (ttMWS(ls->ctok->type)) continue;
 		if (ls->ctok->type == NAME) {
-			int x = (HTT_get(&macros, ls->ctok->name) == 0);
+			int x = (lookup_macro(ls->ctok->name) == 0);
 
 			while (!next_token(ls) && ls->ctok->type != NEWLINE)
 				if (tgd && !ttWHI(ls->ctok->type)
@@ -1901,6 +2252,7 @@ void wipe_macros(void)
 {
 	if (macros_init_done) HTT_kill(&macros);
 	macros_init_done = 0;
+	macro_filter_clear();
 }
 
 /*
@@ -1914,10 +2266,411 @@ void init_macros(void)
 	if (!no_special_macros) add_special_macros();
 }
 
+/*
+ * The macro table saved by save_macros(), with the matching filter.
+ * Its macros are shared with each table copied by restore_macros();
+ * they are never modified, except for the fields that are restored
+ * after each use (nest, the val.art and cval.rp cursors), and for the
+ * memo, which is bound to macro_generation.
+ */
+static HTT saved_macros;
+static int saved_macros_done = 0;
+static unsigned char saved_macro_filter[sizeof macro_filter];
+static size_t saved_macro_filter_names, saved_macro_filter_stale;
+
+/*
+ * save the current macro table
+ */
+void save_macros(void)
+{
+	if (!macros_init_done) return;
+	HTT_freeze(&macros);
+	HTT_copy(&saved_macros, &macros);
+	mmv(saved_macro_filter, macro_filter, sizeof macro_filter);
+	saved_macro_filter_names = macro_filter_names;
+	saved_macro_filter_stale = macro_filter_stale;
+	saved_macros_done = 1;
+}
+
+/*
+ * replace the macro table with a copy of the saved one; this returns 0
+ * if there is none
+ */
+int restore_macros(void)
+{
+	if (!saved_macros_done) return 0;
+	if (macros_init_done) HTT_kill(&macros);
+	HTT_copy(&macros, &saved_macros);
+	macros_init_done = 1;
+	mmv(macro_filter, saved_macro_filter, sizeof macro_filter);
+	macro_filter_names = saved_macro_filter_names;
+	macro_filter_stale = saved_macro_filter_stale;
+	macro_generation ++;
+	return 1;
+}
+
+/*
+ * release the saved macro table
+ */
+void free_saved_macros(void)
+{
+	if (saved_macros_done) HTT_release(&saved_macros);
+	saved_macros_done = 0;
+}
+
+/*
+ * macro table image, see write_cpp_state() in cpp.c
+ */
+static FILE *state_output;
+
+static void write_macro(void *vm)
+{
+	struct macro *m = vm;
+	size_t i;
+
+	put_state_string(state_output, HASH_ITEM_NAME(m));
+	put_state_word(state_output, (unsigned long)(m->narg + 1));
+	put_state_word(state_output, (unsigned long)m->vaarg);
+	for (i = 0; (int)i < m->narg; i ++)
+		put_state_string(state_output, m->arg[i]);
+#ifdef LOW_MEM
+	put_state_word(state_output, (unsigned long)m->cval.length);
+	fwrite(m->cval.t, 1, m->cval.length, state_output);
+#else
+	put_state_word(state_output, (unsigned long)m->val.nt);
+	for (i = 0; i < m->val.nt; i ++) {
+		struct token *t = m->val.t + i;
+
+		put_state_word(state_output, (unsigned long)t->type);
+		put_state_word(state_output, (unsigned long)t->line);
+		if (S_TOKEN(t->type)) put_state_string(state_output, t->name);
+	}
+#endif
+}
+
+void write_macros(FILE *f)
+{
+	state_output = f;
+	put_state_word(f, macros_init_done ? (unsigned long)macros.count : 0);
+	if (macros_init_done) HTT_scan(&macros, write_macro);
+}
+
+#ifdef LOW_MEM
+/*
+ * check a compressed replacement list read from an image: token types
+ * are known, names are terminated and arguments are in range
+ */
+static int check_macro_value(unsigned char *t, size_t n, unsigned long nargs)
+{
+	size_t i = 0;
+
+	while (i < n) {
+		int tt = t[i ++];
+
+		if (tt > MACROARG) return -1;
+		if (tt == MACROARG) {
+			unsigned anum;
+
+			if (i >= n) return -1;
+			anum = t[i ++];
+			if (anum >= 128U) {
+				if (i >= n) return -1;
+				anum = ((anum & 127U) << 8) | t[i ++];
+			}
+			if (anum >= nargs) return -1;
+		} else if (S_TOKEN(tt)) {
+			unsigned char *z = memchr(t + i, 0, n - i);
+
+			if (!z) return -1;
+			i = (size_t)(z - t) + 1;
+		}
+	}
+	return 0;
+}
+#endif
+
+/*
+ * read the macros written by write_macros(); they replace the current
+ * macros if apply is non-zero, and are only checked otherwise
+ */
+void read_macros(struct state_reader *r, int apply)
+{
+	unsigned long n = get_state_word(r), i, j;
+
+	if (apply) {
+		wipe_macros();
+		HTT_init(&macros, del_macro);
+		macros_init_done = 1;
+	}
+	for (i = 0; i < n && !r->failed; i ++) {
+		char *name = get_state_string(r);
+		unsigned long narg = get_state_word(r);
+		int vaarg = (int)get_state_word(r);
+		struct macro *m = 0;
+		unsigned long nt, nargs;
+
+		/* narg is 0 for an object-like macro, __VA_ARGS__ is last */
+		if (narg > (unsigned long)(r->end - r->p) || vaarg < 0
+			|| vaarg > 1 || (vaarg && narg == 0))
+			r->failed = 1;
+		if (r->failed) break;
+		nargs = narg ? narg - 1 + vaarg : 0;
+		if (apply) {
+			m = new_macro();
+			m->narg = (int)narg - 1;
+			m->vaarg = vaarg;
+			if (narg > 1) m->arg = getmem((narg - 1) * sizeof(char *));
+		}
+		for (j = 0; j + 1 < narg; j ++) {
+			char *a = get_state_string(r);
+
+			if (apply) m->arg[j] = sdup(a);
+		}
+		nt = get_state_word(r);
+#ifdef LOW_MEM
+		if (nt > (unsigned long)(r->end - r->p)
+			|| check_macro_value(r->p, nt, nargs))
+			r->failed = 1;
+		if (apply && !r->failed && nt) {
+			m->cval.t = getmem(nt);
+			mmv(m->cval.t, r->p, nt);
+			m->cval.length = nt;
+		}
+		if (!r->failed) r->p += nt;
+#else
+		for (j = 0; j < nt && !r->failed; j ++) {
+			struct token t;
+			unsigned long type = get_state_word(r);
+
+			t.line = (long)get_state_word(r);
+			if (type > MACROARG || (type == MACROARG
+				&& (unsigned long)t.line >= nargs)) {
+				r->failed = 1;
+				break;
+			}
+			t.type = (int)type;
+			if (S_TOKEN(t.type)) {
+				char *tn = get_state_string(r);
+
+				if (apply) t.name = sdup(tn);
+			}
+			if (apply) aol(m->val.t, m->val.nt, t, TOKEN_LIST_MEMG);
+		}
+#endif
+		if (apply) put_macro(m, name);
+	}
+}
+
+/*
+ * Macros of a header module, see cpp.c. While a header is recorded, the
+ * first use of a name notes the definition it had then (none if it was
+ * no macro), unless the header defined or undefined it before; these
+ * definitions are the key of the module. A #define is such a use, since
+ * a redefinition must be identical. The names the header defines or
+ * undefines are noted too, and their definitions at the end of the
+ * header are the delta of the module.
+ */
+struct macro_use {
+	hash_item_header head;    /* first field */
+	int used, set;
+	struct macro *def;
+};
+
+static HTT macro_uses;
+static struct macro_set *uses_key, *uses_delta;
+
+static struct macro *copy_macro(struct macro *m)
+{
+	struct macro *n = new_macro();
+	size_t i;
+
+	n->narg = m->narg;
+	n->vaarg = m->vaarg;
+	if (m->narg > 0) {
+		n->arg = getmem(m->narg * sizeof(char *));
+		for (i = 0; (int)i < m->narg; i ++) n->arg[i] = sdup(m->arg[i]);
+	}
+#ifdef LOW_MEM
+	if (m->cval.length) {
+		n->cval.t = getmem(m->cval.length);
+		mmv(n->cval.t, m->cval.t, m->cval.length);
+		n->cval.length = m->cval.length;
+	}
+#else
+	for (i = 0; i < m->val.nt; i ++) {
+		struct token t = m->val.t[i];
+
+		if (S_TOKEN(t.type)) t.name = sdup(t.name);
+		aol(n->val.t, n->val.nt, t, TOKEN_LIST_MEMG);
+	}
+#endif
+	return n;
+}
+
+static int same_macro(struct macro *a, struct macro *b)
+{
+	size_t i;
+
+	if (a->narg != b->narg || a->vaarg != b->vaarg) return 0;
+	for (i = 0; (int)i < a->narg; i ++)
+		if (strcmp(a->arg[i], b->arg[i])) return 0;
+#ifdef LOW_MEM
+	return a->cval.length == b->cval.length && (a->cval.length == 0
+		|| !memcmp(a->cval.t, b->cval.t, a->cval.length));
+#else
+	if (a->val.nt != b->val.nt) return 0;
+	for (i = 0; i < a->val.nt; i ++) {
+		struct token *x = a->val.t + i, *y = b->val.t + i;
+
+		if (x->type != y->type
+			|| (x->type == MACROARG && x->line != y->line)
+			|| (S_TOKEN(x->type) && strcmp(x->name, y->name)))
+			return 0;
+	}
+	return 1;
+#endif
+}
+
+static void del_macro_use(void *vu)
+{
+	struct macro_use *u = vu;
+
+	if (u->def) del_macro(u->def);
+	freemem(u);
+}
+
+static void note_macro_use(char *name)
+{
+	struct macro_use *u = HTT_get(&macro_uses, name);
+	struct macro *m;
+
+	if (u) return;
+	u = getmem(sizeof(struct macro_use));
+	u->used = 1;
+	u->set = 0;
+	m = find_macro(name);
+	u->def = m ? copy_macro(m) : 0;
+	HTT_put(&macro_uses, u, name);
+}
+
+static void note_macro_set(char *name)
+{
+	struct macro_use *u = HTT_get(&macro_uses, name);
+
+	if (!u) {
+		u = getmem(sizeof(struct macro_use));
+		u->used = 0;
+		u->def = 0;
+		HTT_put(&macro_uses, u, name);
+	}
+	u->set = 1;
+}
+
+/*
+ * Start noting the macros used and set. The memoized expansions are
+ * discarded: one computed during the recording has had its macros
+ * noted, an older one has not.
+ */
+void record_macro_uses(void)
+{
+	HTT_init(&macro_uses, del_macro_use);
+	recording_uses = 1;
+	macro_generation ++;
+}
+
+static void take_macro_use(void *vu)
+{
+	struct macro_use *u = vu;
+	char *name = HASH_ITEM_NAME(u);
+
+	if (u->used) {
+		uses_key->name[uses_key->nb] = sdup(name);
+		uses_key->def[uses_key->nb ++] = u->def;
+		u->def = 0;
+	}
+	if (u->set) {
+		struct macro *m = find_macro(name);
+
+		uses_delta->name[uses_delta->nb] = sdup(name);
+		uses_delta->def[uses_delta->nb ++] = m ? copy_macro(m) : 0;
+	}
+}
+
+/*
+ * stop noting the macros; the key and delta are filled in, unless they
+ * are 0 (the recording is dropped)
+ */
+void end_macro_uses(struct macro_set *key, struct macro_set *delta)
+{
+	if (!recording_uses) return;
+	recording_uses = 0;
+	if (key) {
+		size_t n = macro_uses.count;
+
+		key->nb = delta->nb = 0;
+		key->name = getmem((n + 1) * sizeof(char *));
+		key->def = getmem((n + 1) * sizeof(struct macro *));
+		delta->name = getmem((n + 1) * sizeof(char *));
+		delta->def = getmem((n + 1) * sizeof(struct macro *));
+		uses_key = key;
+		uses_delta = delta;
+		HTT_scan(&macro_uses, take_macro_use);
+	}
+	HTT_kill(&macro_uses);
+}
+
+/*
+ * tell whether the names of a key have the same definitions now
+ */
+int check_macro_set(struct macro_set *ms)
+{
+	size_t i;
+
+	for (i = 0; i < ms->nb; i ++) {
+		struct macro *m = lookup_macro(ms->name[i]);
+
+		if (m ? !ms->def[i] || !same_macro(m, ms->def[i])
+			: ms->def[i] != 0)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * define and undefine the macros of a delta
+ */
+void apply_macro_set(struct macro_set *ms)
+{
+	size_t i;
+
+	for (i = 0; i < ms->nb; i ++) {
+		char *name = ms->name[i];
+		struct macro *m;
+
+		if (recording_uses) note_macro_set(name);
+		m = find_macro(name);
+		if (m && ms->def[i] && same_macro(m, ms->def[i])) continue;
+		if (m) del_macro_name(name);
+		if (ms->def[i]) put_macro(copy_macro(ms->def[i]), name);
+	}
+}
+
+void free_macro_set(struct macro_set *ms)
+{
+	size_t i;
+
+	for (i = 0; i < ms->nb; i ++) {
+		freemem(ms->name[i]);
+		if (ms->def[i]) del_macro(ms->def[i]);
+	}
+	freemem(ms->name);
+	freemem(ms->def);
+}
+
 /*
  * find a macro from its name
  */
 struct macro *get_macro(char *name)
 {
-	return HTT_get(&macros, name);
+	return lookup_macro(name);
 }
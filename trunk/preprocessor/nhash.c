@@ -1,5 +1,5 @@
 /*
- * Mixed hash table / binary tree code.
+ * Hash tables with open addressing (linear probing).
  * (c) Thomas Pornin 2002
  *
  * Redistribution and use in source and binary forms, with or without
@@ -30,452 +30,264 @@
 
 #include <stddef.h>
 #include <string.h>
-#include <limits.h>
 #include "nhash.h"
 #include "mem.h"
 
 /*
- * Hash a string into an `unsigned' value. This function is derived
- * from the hash function used in the ELF binary object file format
- * hash tables. The result size is a 32-bit number if the `unsigned'
- * type is big enough to hold 32-bit arbitrary numbers, a 16-bit number
- * otherwise.
+ * Hash a string into an `unsigned long' value: FNV-1a on the characters,
+ * then a final avalanche (from MurmurHash3) so that the low bits, which
+ * select the slot, depend on all the characters. Only the 32 low bits
+ * are used.
  */
-static unsigned hash_string(char *name)
+static unsigned long hash_string(char *name)
 {
-	unsigned h = 0;
-
-	for (h = 0; *name; name ++) {
-		unsigned g;
-
-		h = (h << 4) + *(unsigned char *)name;
-#if UINT_MAX >= 0xffffffffU
-		g = h & 0xF0000000U;
-		h ^= (g >> 24);
-#else
-		g = h & 0xF000U;
-		h ^= (g >> 12);
-#endif
-		h &= ~g;
+	unsigned long h = 2166136261UL;
+
+	for (; *name; name ++) {
+		h ^= *(unsigned char *)name;
+		h = (h * 16777619UL) & 0xFFFFFFFFUL;
 	}
+	h ^= h >> 16;
+	h = (h * 0x85EBCA6BUL) & 0xFFFFFFFFUL;
+	h ^= h >> 13;
+	h = (h * 0xC2B2AE35UL) & 0xFFFFFFFFUL;
+	h ^= h >> 16;
 	return h;
 }
 
 /*
- * Each item in the table is a structure beginning with a `hash_item_header'
- * structure. Those headers define binary trees such that all left-descendants
- * (respectively right-descendants) of a given tree node have an associated
- * hash value strictly smaller (respectively greater) than the hash value
- * associated with this node.
- *
- * The `ident' field points to an array of char. The `sizeof(unsigned)'
- * first `char' contain a copy of an `unsigned' value which is the hashed
- * string, except the least significant bit. When this bit is set to 0,
- * the node contains the unique item using that hash value. If the bit
- * is set to 1, then there are several items with that hash value.
- *
- * When several items share the same hash value, they are linked together
- * in a linked list by their `left' field. The node contains no data;
- * it is a "fake item".
+ * The table is an array of slots, each holding the hash value of the
+ * item name and a pointer to the item; an empty slot has a NULL item.
+ * An item lives in the first free slot found by linear probing from
+ * its home slot, given by the low bits of its hash value. The table is
+ * grown (doubled) so that it is never more than half full, hence each
+ * probe sequence ends on an empty slot.
  *
- * The `char' following the hash value encode the item name for true items.
- * For fake items, they contain the pointer to the first true item of the
- * corresponding link list (suitably aligned).
+ * The stored hash values avoid most name comparisons on a probe, and
+ * make growing the table cheap. Deletion moves back the following items
+ * of the probe sequence instead of leaving a tombstone, so that lookups
+ * never get slower as macros are defined and undefined.
  *
- * There are HTT_NUM_TREES trees; the items are sorted among trees by the
- * lest significant bits of their hash value.
+ * The `ident' field of the item header points to a copy of the name.
+ * Items marked `shared' belong to another table, whose slot array was
+ * copied: they are dropped from this one but never released.
  */
-
-static void internal_init(HTT *htt, void (*deldata)(void *), int reduced)
-{
-	htt->deldata = deldata;
-	if (reduced) {
-		HTT2 *htt2 = (HTT2 *)htt;
-
-		htt2->tree[0] = htt2->tree[1] = NULL;
-	} else {
-		unsigned u;
-
-		for (u = 0; u < HTT_NUM_TREES; u ++) htt->tree[u] = NULL;
-	}
-}
+#define HTT_MIN_SIZE	16
 
 /* see nhash.h */
 void HTT_init(HTT *htt, void (*deldata)(void *))
 {
-	internal_init(htt, deldata, 0);
+	htt->deldata = deldata;
+	htt->slot = NULL;
+	htt->size = 0;
+	htt->count = 0;
 }
 
 /* see nhash.h */
 void HTT2_init(HTT2 *htt, void (*deldata)(void *))
 {
-	internal_init((HTT *)htt, deldata, 1);
+	HTT_init(htt, deldata);
 }
 
-#define PTR_SHIFT    (sizeof(hash_item_header *) * \
-                      ((sizeof(unsigned) + sizeof(hash_item_header *) - 1) / \
-                       sizeof(hash_item_header *)))
-
-#define TREE(u)    (*(reduced ? ((HTT2 *)htt)->tree + ((u) & 1) \
-                              : htt->tree + ((u) & (HTT_NUM_TREES - 1))))
-
 /*
- * Find a node for the given hash value. If `father' is not NULL, fill
- * `*father' with a pointer to the node's father.
- * If the return value is NULL, then no existing node was found; if `*father'
- * is also  NULL, the tree is empty. If the return value is not NULL but
- * `*father' is NULL, then the found node is the tree root.
- *
- * If `father' is not NULL, then `*leftson' is filled with 1 if the node
- * was looked for as the father left son, 0 otherwise.
+ * Find the slot of the given name, or the empty slot where it would be
+ * inserted. The table must have been allocated.
  */
-static hash_item_header *find_node(HTT *htt, unsigned u,
-	hash_item_header **father, int *leftson, int reduced)
+static hash_slot *find_slot(HTT *htt, char *name, unsigned long h)
 {
-	hash_item_header *node = TREE(u);
-	hash_item_header *nodef = NULL;
-	int ls = 0;
-
-	u &= ~1U;
-	while (node != NULL) {
-		unsigned v = *(unsigned *)(node->ident);
-		unsigned w = v & ~1U;
-
-		if (u == w) break;
-		nodef = node;
-		if (u < w) {
-			node = node->left;
-			ls = 1;
-		} else {
-			node = node->right;
-			ls = 0;
-		}
-	}
-	if (father != NULL) {
-		*father = nodef;
-		*leftson = ls;
+	size_t m = htt->size - 1, i = h & m;
+
+	for (;;) {
+		hash_slot *s = htt->slot + i;
+
+		if (s->item == NULL) return s;
+		if (s->hash == h && strcmp(s->item->ident, name) == 0)
+			return s;
+		i = (i + 1) & m;
 	}
-	return node;
 }
 
-static void *internal_get(HTT *htt, char *name, int reduced)
+/*
+ * Allocate a new array of n slots and move all items into it.
+ */
+static void resize(HTT *htt, size_t n)
 {
-	unsigned u = hash_string(name), v;
-	hash_item_header *node = find_node(htt, u, NULL, NULL, reduced);
+	hash_slot *old = htt->slot;
+	size_t u, os = htt->size;
 
-	if (node == NULL) return NULL;
-	v = *(unsigned *)(node->ident);
-	if ((v & 1U) == 0) {
-		return (strcmp(HASH_ITEM_NAME(node), name) == 0) ? node : NULL;
-	}
-	node = *(hash_item_header **)(node->ident + PTR_SHIFT);
-	while (node != NULL) {
-		if (strcmp(HASH_ITEM_NAME(node), name) == 0) return node;
-		node = node->left;
+	htt->slot = getmem(n * sizeof(hash_slot));
+	htt->size = n;
+	for (u = 0; u < n; u ++) htt->slot[u].item = NULL;
+	for (u = 0; u < os; u ++) if (old[u].item != NULL) {
+		size_t i = old[u].hash & (n - 1);
+
+		while (htt->slot[i].item != NULL) i = (i + 1) & (n - 1);
+		htt->slot[i] = old[u];
 	}
-	return NULL;
+	if (old != NULL) freemem(old);
 }
 
 /* see nhash.h */
 void *HTT_get(HTT *htt, char *name)
 {
-	return internal_get(htt, name, 0);
+	if (htt->count == 0) return NULL;
+	return find_slot(htt, name, hash_string(name))->item;
 }
 
 /* see nhash.h */
 void *HTT2_get(HTT2 *htt, char *name)
 {
-	return internal_get((HTT *)htt, name, 1);
-}
-
-/*
- * Make an item identifier from its name and its hash value.
- */
-static char *make_ident(char *name, unsigned u)
-{
-	size_t n = strlen(name) + 1;
-	char *ident = getmem(n + sizeof(unsigned));
-
-	*(unsigned *)ident = u & ~1U;
-	memcpy(ident + sizeof(unsigned), name, n);
-	return ident;
-}
-
-/*
- * Make an identifier for a fake item, pointing to a true item.
- */
-static char *make_fake_ident(unsigned u, hash_item_header *next)
-{
-	char *ident = getmem(PTR_SHIFT + sizeof(hash_item_header *));
-
-	*(unsigned *)ident = u | 1U;
-	*(hash_item_header **)(ident + PTR_SHIFT) = next;
-	return ident;
-}
-
-/*
- * Adding an item is straightforward:
- *  1. look for its emplacement
- *  2. if no node is found, use the item as a new node and link it to the tree
- *  3. if a node is found:
- *     3.1. if the node is real, check for name inequality, then create a
- *          fake node and assemble the two-element linked list
- *     3.2. if the node is fake, look for the name in the list; if not found,
- *          add the node at the list end
- */
-static void *internal_put(HTT *htt, void *item, char *name, int reduced)
-{
-	unsigned u = hash_string(name), v;
-	int ls;
-	hash_item_header *father;
-	hash_item_header *node = find_node(htt, u, &father, &ls, reduced);
-	hash_item_header *itemg = item, *pnode;
-
-	if (node == NULL) {
-		itemg->left = itemg->right = NULL;
-		itemg->ident = make_ident(name, u);
-		if (father == NULL) {
-			TREE(u) = itemg;
-		} else if (ls) {
-			father->left = itemg;
-		} else {
-			father->right = itemg;
-		}
-		return NULL;
-	}
-	v = *(unsigned *)(node->ident);
-	if ((v & 1U) == 0) {
-		if (strcmp(HASH_ITEM_NAME(node), name) == 0)
-			return node;
-		pnode = getmem(sizeof *pnode);
-		pnode->left = node->left;
-		pnode->right = node->right;
-		pnode->ident = make_fake_ident(u, node);
-		node->left = itemg;
-		node->right = NULL;
-		itemg->left = itemg->right = NULL;
-		itemg->ident = make_ident(name, u);
-		if (father == NULL) {
-			TREE(u) = pnode;
-		} else if (ls) {
-			father->left = pnode;
-		} else {
-			father->right = pnode;
-		}
-		return NULL;
-	}
-	node = *(hash_item_header **)(node->ident + PTR_SHIFT);
-	while (node != NULL) {
-		if (strcmp(HASH_ITEM_NAME(node), name) == 0) return node;
-		pnode = node;
-		node = node->left;
-	}
-	itemg->left = itemg->right = NULL;
-	itemg->ident = make_ident(name, u);
-	pnode->left = itemg;
-	return NULL;
+	return HTT_get(htt, name);
 }
 
 /* see nhash.h */
 void *HTT_put(HTT *htt, void *item, char *name)
 {
-	return internal_put(htt, item, name, 0);
+	unsigned long h = hash_string(name);
+	hash_item_header *itemg = item;
+	hash_slot *s;
+	size_t n;
+
+	if (htt->size == 0) resize(htt, HTT_MIN_SIZE);
+	s = find_slot(htt, name, h);
+	if (s->item != NULL) return s->item;
+	if (2 * (htt->count + 1) > htt->size) {
+		resize(htt, 2 * htt->size);
+		s = find_slot(htt, name, h);
+	}
+	n = strlen(name) + 1;
+	itemg->ident = getmem(n);
+	memcpy(itemg->ident, name, n);
+	itemg->shared = 0;
+	s->hash = h;
+	s->item = itemg;
+	htt->count ++;
+	return NULL;
 }
 
 /* see nhash.h */
 void *HTT2_put(HTT2 *htt, void *item, char *name)
 {
-	return internal_put((HTT *)htt, item, name, 1);
+	return HTT_put(htt, item, name);
 }
 
 /*
- * A fake node subnode list has shrunk to one item only; make the
- * node real again.
- *   fnode    the fake node
- *   node     the last remaining node
- *   father   the fake node father (NULL if the fake node is root)
- *   leftson  1 if the fake node is a left son, 0 otehrwise
- *   u        the hash value for this node
+ * See nhash.h. Deletion empties the slot, then walks the rest of the
+ * probe sequence; an item whose home slot is not between the hole and
+ * itself (circularly) moves back into the hole, which then moves to the
+ * former slot of that item.
  */
-static void shrink_node(HTT *htt, hash_item_header *fnode,
-	hash_item_header *node, hash_item_header *father, int leftson,
-	unsigned u, int reduced)
-{
-	node->left = fnode->left;
-	node->right = fnode->right;
-	if (father == NULL) {
-		TREE(u) = node;
-	} else if (leftson) {
-		father->left = node;
-	} else {
-		father->right = node;
-	}
-	freemem(fnode->ident);
-	freemem(fnode);
-}
-
-/*
- * Deletion algorithm:
- *  1. look for the node; if not found, exit
- *  2. if the node is real:
- *     2.1. check for equality; exit otherwise
- *     2.2. delete the node
- *     2.3. promote the leftest of right descendants or rightest of left
- *          descendants
- *  3. if the node is fake:
- *     3.1. check the list items for equality; exit otherwise
- *     3.2. delete the correct item
- *     3.3. if there remains only one item, supress the fake node
- */
-static int internal_del(HTT *htt, char *name, int reduced)
+int HTT_del(HTT *htt, char *name)
 {
-	unsigned u = hash_string(name), v;
-	int ls;
-	hash_item_header *father;
-	hash_item_header *node = find_node(htt, u, &father, &ls, reduced);
-	hash_item_header *pnode, *fnode, *znode;
+	hash_item_header *item;
+	hash_slot *s;
+	size_t m, i, j;
 	char *tmp;
 
-	if (node == NULL) return 0;
-	v = *(unsigned *)(node->ident);
-	if ((v & 1U) != 0) {
-		fnode = node;
-		node = znode = *(hash_item_header **)(node->ident + PTR_SHIFT);
-		pnode = NULL;
-		while (node != NULL) {
-			if (strcmp(HASH_ITEM_NAME(node), name) == 0) break;
-			pnode = node;
-			node = node->left;
-		}
-		if (node == NULL) return 0;
-		if (pnode == NULL) {
-			/*
-			 * We supress the first item in the list.
-			 */
-			*(hash_item_header **)(fnode->ident + PTR_SHIFT) =
-				node->left;
-			if (node->left->left == NULL) {
-				shrink_node(htt, fnode, node->left,
-					father, ls, u, reduced);
-			}
-		} else {
-			pnode->left = node->left;
-			if (pnode->left == NULL && znode == pnode) {
-				shrink_node(htt, fnode, pnode,
-					father, ls, u, reduced);
-			}
-		}
-	} else {
-		if (strcmp(HASH_ITEM_NAME(node), name) != 0) return 0;
-		if (node->left != NULL) {
-			for (znode = node, pnode = node->left; pnode->right;
-				znode = pnode, pnode = pnode->right);
-			if (znode != node) {
-				znode->right = pnode->left;
-				pnode->left = node->left;
-			}
-			pnode->right = node->right;
-		} else if (node->right != NULL) {
-			for (znode = node, pnode = node->right; pnode->left;
-				znode = pnode, pnode = pnode->left);
-			if (znode != node) {
-				znode->left = pnode->right;
-				pnode->right = node->right;
-			}
-			pnode->left = node->left;
-		} else pnode = NULL;
-		if (father == NULL) {
-			TREE(u) = pnode;
-		} else if (ls) {
-			father->left = pnode;
-		} else {
-			father->right = pnode;
+	if (htt->count == 0) return 0;
+	s = find_slot(htt, name, hash_string(name));
+	if (s->item == NULL) return 0;
+	item = s->item;
+	m = htt->size - 1;
+	i = j = s - htt->slot;
+	for (;;) {
+		size_t k;
+
+		j = (j + 1) & m;
+		if (htt->slot[j].item == NULL) break;
+		k = htt->slot[j].hash & m;
+		if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+			htt->slot[i] = htt->slot[j];
+			i = j;
 		}
 	}
-	tmp = node->ident;
-	htt->deldata(node);
+	htt->slot[i].item = NULL;
+	htt->count --;
+	if (item->shared) return 1;
+	tmp = item->ident;
+	htt->deldata(item);
 	freemem(tmp);
 	return 1;
 }
 
 /* see nhash.h */
-int HTT_del(HTT *htt, char *name)
+int HTT2_del(HTT2 *htt, char *name)
 {
-	return internal_del(htt, name, 0);
+	return HTT_del(htt, name);
 }
 
 /* see nhash.h */
-int HTT2_del(HTT2 *htt, char *name)
+void HTT_scan(HTT *htt, void (*action)(void *))
 {
-	return internal_del((HTT *)htt, name, 1);
+	size_t u;
+
+	for (u = 0; u < htt->size; u ++)
+		if (htt->slot[u].item != NULL) action(htt->slot[u].item);
+}
+
+/* see nhash.h */
+void HTT2_scan(HTT2 *htt, void (*action)(void *))
+{
+	HTT_scan(htt, action);
 }
 
 /*
- * Apply `action()' on all nodes of the tree whose root is given as
- * parameter `node'. If `wipe' is non-zero, the nodes are removed
- * from memory.
+ * Release the items (the shared ones too if `all' is non-zero) and
+ * the slot array.
  */
-static void scan_node(hash_item_header *node, void (*action)(void *), int wipe)
+static void kill_table(HTT *htt, int all)
 {
-	unsigned v;
-
-	if (node == NULL) return;
-	scan_node(node->left, action, wipe);
-	scan_node(node->right, action, wipe);
-	v = *(unsigned *)(node->ident);
-	if ((v & 1U) != 0) {
-		hash_item_header *pnode, *nnode;
-
-		for (pnode = *(hash_item_header **)(node->ident + PTR_SHIFT);
-			pnode != NULL; pnode = nnode) {
-			char *tmp = pnode->ident;
-
-			nnode = pnode->left;
-			action(pnode);
-			if (wipe) freemem(tmp);
-		}
-		if (wipe) {
-			freemem(node->ident);
-			freemem(node);
-		}
-	} else {
-		char *tmp = node->ident;
+	size_t u;
+
+	for (u = 0; u < htt->size; u ++) if (htt->slot[u].item != NULL
+		&& (all || !htt->slot[u].item->shared)) {
+		char *tmp = htt->slot[u].item->ident;
 
-		action(node);
-		if (wipe) freemem(tmp);
+		htt->deldata(htt->slot[u].item);
+		freemem(tmp);
 	}
+	if (htt->slot != NULL) freemem(htt->slot);
+	htt->slot = NULL;
+	htt->size = 0;
+	htt->count = 0;
 }
 
 /* see nhash.h */
-void HTT_scan(HTT *htt, void (*action)(void *))
+void HTT_kill(HTT *htt)
 {
-	unsigned u;
-
-	for (u = 0; u < HTT_NUM_TREES; u ++) {
-		scan_node(htt->tree[u], action, 0);
-	}
+	kill_table(htt, 0);
 }
 
 /* see nhash.h */
-void HTT2_scan(HTT2 *htt, void (*action)(void *))
+void HTT_freeze(HTT *htt)
 {
-	scan_node(htt->tree[0], action, 0);
-	scan_node(htt->tree[1], action, 0);
+	size_t u;
+
+	for (u = 0; u < htt->size; u ++)
+		if (htt->slot[u].item != NULL) htt->slot[u].item->shared = 1;
 }
 
 /* see nhash.h */
-void HTT_kill(HTT *htt)
+void HTT_copy(HTT *dst, HTT *src)
 {
-	unsigned u;
-
-	for (u = 0; u < HTT_NUM_TREES; u ++) {
-		scan_node(htt->tree[u], htt->deldata, 1);
+	dst->deldata = src->deldata;
+	dst->size = src->size;
+	dst->count = src->count;
+	dst->slot = NULL;
+	if (src->size) {
+		dst->slot = getmem(src->size * sizeof(hash_slot));
+		memcpy(dst->slot, src->slot, src->size * sizeof(hash_slot));
 	}
 }
 
+/* see nhash.h */
+void HTT_release(HTT *htt)
+{
+	kill_table(htt, 1);
+}
+
 /* see nhash.h */
 void HTT2_kill(HTT2 *htt)
 {
-	scan_node(htt->tree[0], htt->deldata, 1);
-	scan_node(htt->tree[1], htt->deldata, 1);
+	HTT_kill(htt);
 }
@@ -30,49 +30,58 @@
 #ifndef UCPP__NHASH__
 #define UCPP__NHASH__
 
+#include <stddef.h>
+
 /*
  * Each item stored in the hash table should be a structure beginning
  * with the following header.
  */
 typedef struct hash_item_header_ {
 	char *ident;
-	struct hash_item_header_ *left, *right;
+	int shared;
 } hash_item_header;
 
 /*
  * This macro takes as argument a pointer to a hash table item (a
  * structure beginning with `hash_item_header') and returns a pointer to
  * the item name. This name should be considered as read-only. The
- * retrieved pointer can become invalid whenever a new item is inserted
- * in or removed from the table.
+ * pointer remains valid as long as the item is in the table.
  */
-#define HASH_ITEM_NAME(s) (((hash_item_header *)(s))->ident + sizeof(unsigned))
+#define HASH_ITEM_NAME(s) (((hash_item_header *)(s))->ident)
 
 /*
- * Number of lists for the primary hash step. Can be reduced to save more
- * memory, or increased to speed things up. It should be a power of 2
- * greater or equal than 2 and smaller than UINT_MAX.
+ * This macro is non-zero for an item frozen by HTT_freeze(); such an
+ * item must not be modified.
  */
-#define HTT_NUM_TREES   128
+#define HASH_ITEM_SHARED(s) (((hash_item_header *)(s))->shared)
 
 /*
- * Type for a hash table.
+ * A slot of the table: the full hash value of the item name, and the
+ * item itself (NULL for an empty slot).
  */
 typedef struct {
-	void (*deldata)(void *);
-	hash_item_header *tree[HTT_NUM_TREES];
-} HTT;
+	unsigned long hash;
+	hash_item_header *item;
+} hash_slot;
 
 /*
- * Type for a reduced version of HTT with only two binary trees. That
- * version has a lower initialization time and is suitable for situation
- * where only a limited number of elements will be stored, but new tables
- * need frequent initializations.
+ * Type for a hash table: an array of slots, searched by linear probing
+ * and kept at most half full. The array is allocated on the first
+ * insertion, so that an unused table costs nothing.
  */
 typedef struct {
 	void (*deldata)(void *);
-	hash_item_header *tree[2];
-} HTT2;
+	hash_slot *slot;
+	size_t size;		/* number of slots: 0 or a power of 2 */
+	size_t count;		/* number of items */
+} HTT;
+
+/*
+ * HTT2 used to be a reduced version of HTT, cheaper to initialize, for
+ * small and short-lived tables. Since tables now grow on demand, both
+ * are the same.
+ */
+typedef HTT HTT2;
 
 /*
  * Initialize a hash table. The `deldata' parameter should point to a
@@ -108,7 +117,7 @@ int HTT_del(HTT *htt, char *name);
  * For all items stored within the hash table, invoke the provided
  * function with the item as parameter. The function may abort the
  * scan by performing a longjmp() to a context encapsulating the
- * call to that function.
+ * call to that function; it should not modify the table.
  */
 void HTT_scan(HTT *htt, void (*action)(void *));
 
@@ -119,8 +128,27 @@ void HTT_scan(HTT *htt, void (*action)(void *));
 void HTT_kill(HTT *htt);
 
 /*
- * The following functions are identical to the HTT_*() functions, except
- * that they operate on the reduced HTT2 tables.
+ * Mark all the items of the table as shared. A shared item is not
+ * released when it is removed from a table (by HTT_del() or HTT_kill());
+ * it remains owned by the table it was frozen in.
+ */
+void HTT_freeze(HTT *htt);
+
+/*
+ * Make `dst' a table holding the same (frozen) items as `src'; only the
+ * slot array is copied. Any previous contents of `dst' are lost.
+ */
+void HTT_copy(HTT *dst, HTT *src);
+
+/*
+ * Release the whole table contents, shared items included. This should
+ * be called only when no copy of the table holds these items anymore.
+ */
+void HTT_release(HTT *htt);
+
+/*
+ * The following functions are identical to the HTT_*() functions; they
+ * are kept for the HTT2 users.
  */
 void HTT2_init(HTT2 *htt, void (*deldata)(void *));
 void *HTT2_put(HTT2 *htt, void *item, char *name);
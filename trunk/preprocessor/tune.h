@@ -90,7 +90,17 @@
  */
 
 // Michael han - comment it out as this one has no windows mmp impl.
-//#define UCPP_MMAP 
+// hcc - POSIX hosts map their input, windows keeps the fread() path.
+#if defined(__unix__) || defined(__APPLE__)
+#define UCPP_MMAP
+#endif
+
+/*
+ * With UCPP_MMAP, regular files smaller than this many bytes are not
+ * mapped but read whole with a single read(): for the typical small
+ * header, setting up and tearing down a mapping costs more than the copy.
+ */
+#define UCPP_MMAP_MIN		32768
 
 /*
  * Performance issues:
@@ -104,6 +114,22 @@
  * achieved when libc buffering is activated and/or UCPP_MMAP is on.
  */
 
+/*
+ * Define UCPP_SWAR to let the lexer check eight input bytes at a time,
+ * in a 64-bit integer, when it steps over identifiers and whitespace.
+ * This needs unsigned long long and cheap unaligned loads.
+ */
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) \
+	|| defined(__x86_64__) || defined(__aarch64__)
+#define UCPP_SWAR
+#endif
+
+/*
+ * Number of header modules (see cpp.c) kept for a header, recorded under
+ * different macro states; the least recently used one is dropped.
+ */
+#define HEADER_MODULE_VARIANTS	4
+
 /* ====================================================================== */
 /*
  * Define this if you want ucpp to generate tokenized PRAGMA tokens;
@@ -376,6 +402,7 @@
 #define GARBAGE_LIST_MEMG	32
 #define LS_STACK_MEMG		4
 #define FNAME_MEMG		32
+#define MODULE_LIST_MEMG	16
 
 /* ====================================================================== */
 
@@ -385,8 +412,8 @@
 #endif
 
 #if defined(UCPP_MMAP) || defined(POSIX_JMP)
-#ifndef _POSIX_SOURCE
-#define _POSIX_SOURCE	1
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE	200809L	/* posix_madvise(), st_mtim */
 #endif
 #endif
 
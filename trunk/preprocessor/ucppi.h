@@ -58,6 +58,14 @@ struct comp_token_fifo {
 #define ttMWS(x)	((x) == NONE || (x) == COMMENT || (x) == OPT_NONE)
 #define ttWHI(x)	(ttMWS(x) || (x) == NEWLINE)
 
+/*
+ * reading a preprocessor state image, see read_cpp_state()
+ */
+struct state_reader {
+	unsigned char *p, *end;
+	int failed;
+};
+
 /*
  * Function prototypes
  */
@@ -70,6 +78,7 @@ struct comp_token_fifo {
 #define next_token	ucpp_next_token
 #define grap_char	ucpp_grap_char
 #define space_char	ucpp_space_char
+#define skip_false_code	ucpp_skip_false_code
 
 void init_cppm(void);
 void put_char(struct lexer_state *, unsigned char);
@@ -77,6 +86,7 @@ void discard_char(struct lexer_state *);
 int next_token(struct lexer_state *);
 int grap_char(struct lexer_state *);
 int space_char(int);
+void skip_false_code(struct lexer_state *, int);
 
 /*
  * from assert.c
@@ -92,12 +102,22 @@ struct assert {
 #define handle_unassert		ucpp_handle_unassert
 #define get_assertion		ucpp_get_assertion
 #define wipe_assertions		ucpp_wipe_assertions
+#define save_assertions		ucpp_save_assertions
+#define restore_assertions	ucpp_restore_assertions
+#define free_saved_assertions	ucpp_free_saved_assertions
+#define write_assertions	ucpp_write_assertions
+#define read_assertions		ucpp_read_assertions
 
 int cmp_token_list(struct token_fifo *, struct token_fifo *);
 int handle_assert(struct lexer_state *);
 int handle_unassert(struct lexer_state *);
 struct assert *get_assertion(char *);
 void wipe_assertions(void);
+void save_assertions(void);
+int restore_assertions(void);
+void free_saved_assertions(void);
+void write_assertions(FILE *);
+void read_assertions(struct state_reader *, int);
 
 /*
  * from macro.c
@@ -113,6 +133,18 @@ struct macro {
 #else
 	struct token_fifo val;
 #endif
+	struct token_fifo memo;    /* memoized toplevel expansion */
+	unsigned long memo_gen;
+};
+
+/*
+ * macros that a header module depends on (key) or sets (delta), see
+ * record_macro_uses()
+ */
+struct macro_set {
+	size_t nb;
+	char **name;
+	struct macro **def;	/* 0 where the name is no macro */
 };
 
 #define print_token		ucpp_print_token
@@ -123,6 +155,16 @@ struct macro {
 #define substitute_macro	ucpp_substitute_macro
 #define get_macro		ucpp_get_macro
 #define wipe_macros		ucpp_wipe_macros
+#define save_macros		ucpp_save_macros
+#define restore_macros		ucpp_restore_macros
+#define free_saved_macros	ucpp_free_saved_macros
+#define write_macros		ucpp_write_macros
+#define read_macros		ucpp_read_macros
+#define record_macro_uses	ucpp_record_macro_uses
+#define end_macro_uses		ucpp_end_macro_uses
+#define check_macro_set		ucpp_check_macro_set
+#define apply_macro_set		ucpp_apply_macro_set
+#define free_macro_set		ucpp_free_macro_set
 #define dsharp_lexer		ucpp_dsharp_lexer
 #define compile_time		ucpp_compile_time
 #define compile_date		ucpp_compile_date
@@ -139,6 +181,16 @@ int substitute_macro(struct lexer_state *, struct macro *,
 	struct token_fifo *, int, int, long);
 struct macro *get_macro(char *);
 void wipe_macros(void);
+void save_macros(void);
+int restore_macros(void);
+void free_saved_macros(void);
+void write_macros(FILE *);
+void read_macros(struct state_reader *, int);
+void record_macro_uses(void);
+void end_macro_uses(struct macro_set *, struct macro_set *);
+int check_macro_set(struct macro_set *);
+void apply_macro_set(struct macro_set *);
+void free_macro_set(struct macro_set *);
 
 extern struct lexer_state dsharp_lexer;
 extern char compile_time[], compile_date[];
@@ -189,6 +241,20 @@ void init_buf_lexer_state(struct lexer_state *, int);
 struct comp_token_fifo compress_token_list(struct token_fifo *);
 #endif
 
+#define put_state_word		ucpp_put_state_word
+#define put_state_string	ucpp_put_state_string
+#define get_state_word		ucpp_get_state_word
+#define get_state_string	ucpp_get_state_string
+
+void put_state_word(FILE *, unsigned long);
+void put_state_string(FILE *, char *);
+unsigned long get_state_word(struct state_reader *);
+char *get_state_string(struct state_reader *);
+
+#define spoil_header_module	ucpp_spoil_header_module
+
+void spoil_header_module(void);
+
 #define ouch		ucpp_ouch
 #define error		ucpp_error
 #define warning		ucpp_warning
@@ -30,6 +30,8 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include "ssc.h"
 #include "type.h"
 #include "arena.h"
+#include "hconfig.h"
+#include "layout.h"
 
 /*************************************************************************************************************/
 /******************************Prototypes Goes Here**********************************************************/
@@ -73,8 +75,29 @@ static void ssc_outer_declaration(t_ast_declaration* declr);
 static t_type* ssc_native_type_specifiers(int mask, t_ast_coord* coord, int unsign, int long_long);
 static t_type* ssc_struct_union_specifier(t_ast_struct_or_union_specifier*);
 
+/* construct fields of a struct / union from its struct declaration list */
+static void ssc_struct_declaration_list(t_type* record, t_ast_list* struct_declr_list);
+
+/* whether a member declaration without declarator declares an anonymous struct / union member */
+static int ssc_anonymous_member(t_ast_declaration_specifier* specifier_qualifier_list);
+
+/*
+ * fold an integer constant expression
+ * return 1 with its value, 0 if expression is not an integer constant expression,
+ * or -1 if it has an operand whose value the checker doesn't know (cast, sizeof of an expression
+ * or of a type whose size isn't known, enumerator defined by one of those)
+ */
+static int ssc_integer_constant(t_ast_exp* exp, long* value);
+
+/* type named by a type name, NULL if the checker can't construct it */
+static t_type* ssc_type_name(t_ast_type_name* type_name);
+
 static t_type* ssc_enum_specifier(t_ast_enum_specifier* enum_specifier);
-static int ssc_enumerator(t_ast_enumerator* enumerator, int value, t_type* type, int scope);
+/*
+ * known is cleared once an enumerator has a value the checker can't fold; the enumerators
+ * following it are not defined either
+ */
+static int ssc_enumerator(t_ast_enumerator* enumerator, int value, int* known, t_type* type, int scope);
 
 /*
  * construct the type of a declarator based on the the base_type of the declarator's type spcifier
@@ -172,7 +195,7 @@ static void ssc_declaration_specifiers(t_ast_declaration_specifier* spec)
 					}
 					else if (ntype == AST_NTYPE_LONG)
 					{
-						g &= ~ (1 << AST_NTYPE_LONG);
+						/* keep the long bit - long long is long with long_long flag */
 						if (long_long)
 						{
 							semantic_error("too many long long specifier", &s->coord);
@@ -495,7 +518,27 @@ static t_type* ssc_array_dec(t_ast_suffix_declarator* dec)
 
     CALLOC(type, PERM);
     type->code = TYPE_ARRARY;
-    type->size = 0; /* [IMPORTANT] [TODO] hook up with ssc_const_expression to get real expression value */
+    type->size = 0; /* number of elements; 0 for incomplete array */
+
+    if (dec->u.subscript.const_exp)
+    {
+        long n = 0;
+        int folded = ssc_integer_constant(dec->u.subscript.const_exp, &n);
+
+        if (folded > 0 && n > 0 && n <= INT_MAX)
+        {
+            type->size = (int)n;
+        }
+        else if (folded < 0)
+        {
+            /* number of elements is unknown, so is the layout of a record containing the array */
+            type->size = -1;
+        }
+        else
+        {
+            semantic_error("array size must be a positive integer constant", &dec->coord);
+        }
+    }
 
     return type;
 }
@@ -869,14 +912,362 @@ static t_type* ssc_struct_union_specifier(t_ast_struct_or_union_specifier* speci
 		return type;
 	}
 
+    if (type->code == struct_or_union)
+    {
+        ssc_struct_declaration_list(type, specifier->struct_declr_list);
+        layout_record_type(type);
+
+        /* a record of unknown size is left out of the report rather than reported with wrong offsets */
+        if (g_layout_report_output && type->size >= 0)
+        {
+            layout_report_record(type);
+        }
+    }
+
 	return type;
 }
 
+static void ssc_struct_declaration_list(t_type* record, t_ast_list* struct_declr_list)
+{
+    assert(record && struct_declr_list);
+
+    while (!HCC_AST_LIST_IS_END(struct_declr_list))
+    {
+        t_ast_struct_declaration* struct_declr = struct_declr_list->item;
+        t_ast_list* declarator_list = struct_declr->struct_declarator_list;
+        t_type* base_type = NULL;
+
+        struct_declr_list = struct_declr_list->next;
+
+        ssc_declaration_specifiers(struct_declr->specifier_qualifier_list);
+        base_type = struct_declr->specifier_qualifier_list->type ? struct_declr->specifier_qualifier_list->type : type_int;
+
+        while (!HCC_AST_LIST_IS_END(declarator_list))
+        {
+            t_ast_struct_declarator* struct_declarator = declarator_list->item;
+            t_record_field* field = NULL;
+            t_type* type = base_type;
+            char* id = NULL;
+            int bits = 0;
+
+            declarator_list = declarator_list->next;
+
+            if (struct_declarator->declarator)
+            {
+                ssc_declarator(struct_declarator->declarator, &id);
+                type = ssc_finalize_type(base_type, struct_declarator->declarator->type_list);
+
+                if (!type)
+                {
+                    /* type error is already reported */
+                    continue;
+                }
+            }
+            else if (!struct_declarator->const_exp)
+            {
+                if (!IS_RECORD_TYPE(base_type) || !ssc_anonymous_member(struct_declr->specifier_qualifier_list))
+                {
+                    semantic_warning("declaration does not declare a member", &struct_declarator->coord);
+                    continue;
+                }
+            }
+
+            if (struct_declarator->const_exp)
+            {
+                long width = 0;
+                int folded = ssc_integer_constant(struct_declarator->const_exp, &width);
+
+                if (!IS_INTEGER_TYPE(type))
+                {
+                    semantic_error("bit field must have integer type", &struct_declarator->coord);
+                    continue;
+                }
+
+                if (folded < 0)
+                {
+                    /* width is unknown, so is the layout of the record */
+                    bits = -1;
+                }
+                else if (!folded || width < 0 || width > type->size * 8 || (width == 0 && id))
+                {
+                    semantic_error("illegal bit field width", &struct_declarator->coord);
+                    continue;
+                }
+                else
+                {
+                    bits = (int)width;
+                }
+            }
+
+            field = make_field_type(type, id, record);
+            field->bits = bits;
+        }
+    }
+}
+
+static int ssc_anonymous_member(t_ast_declaration_specifier* specifier_qualifier_list)
+{
+    t_ast_list* list = specifier_qualifier_list->type_specifier_list;
+
+    /* only a struct / union defined without tag makes an anonymous member, not a typedef name of one */
+    while (!HCC_AST_LIST_IS_END(list))
+    {
+        t_ast_type_specifier* s = list->item;
+        list = list->next;
+
+        if (s->kind == AST_TYPE_SPECIFIER_STRUCT_OR_UNION && !s->u.struct_union_specifier->name)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int ssc_integer_constant(t_ast_exp* exp, long* value)
+{
+    long l = 0, r = 0;
+    int folded = 0;
+
+    assert(value);
+
+    if (!exp)
+    {
+        return 0;
+    }
+
+    /*
+     * operands are folded from the expression as parsed; the expression checker doesn't fold
+     * binary operators yet
+     */
+    switch (exp->kind)
+    {
+    case AST_EXP_CONST_INTEGER_KIND :
+        *value = exp->u.ast_const_exp.val.i;
+        return 1;
+    case AST_EXP_CONST_LONG_INTEGER_KIND :
+        *value = exp->u.ast_const_exp.val.l;
+        return 1;
+    case AST_EXP_CONST_LONG_LONG_KIND :
+        *value = (long)exp->u.ast_const_exp.val.ll;
+        return 1;
+    case AST_EXP_CONST_UNSIGNED_INTEGER_KIND :
+        *value = (long)exp->u.ast_const_exp.val.ui;
+        return 1;
+    case AST_EXP_CONST_UNSIGNED_LONG_INTEGER_KIND :
+        *value = (long)exp->u.ast_const_exp.val.ul;
+        return 1;
+    case AST_EXP_CONST_UNSIGNED_LONG_LONG_KIND :
+        *value = (long)exp->u.ast_const_exp.val.ull;
+        return 1;
+    case AST_EXP_IDENTIFIER_KIND :
+        {
+            t_symbol* sym = find_symbol(exp->u.ast_id_exp.name, sym_table_identifiers);
+
+            if (!sym)
+            {
+                semantic_error("undeclared identifier", &exp->coord);
+                return 0;
+            }
+
+            if (sym->storage != TK_ENUM)
+            {
+                return 0;
+            }
+
+            /* an enumerator is not defined if its value is not folded */
+            if (!sym->defined)
+            {
+                return -1;
+            }
+
+            *value = sym->value.i;
+            return 1;
+        }
+    case AST_EXP_UNARY_KIND :
+        {
+            folded = ssc_integer_constant(exp->u.ast_unary_exp.exp, &l);
+
+            if (folded <= 0)
+            {
+                return folded;
+            }
+
+            switch (exp->u.ast_unary_exp.op)
+            {
+            case AST_OP_POS :
+                *value = l;
+                return 1;
+            case AST_OP_NEGATE :
+                *value = - l;
+                return 1;
+            case AST_OP_INVERT :
+                *value = ~ l;
+                return 1;
+            case AST_OP_NOT :
+                *value = ! l;
+                return 1;
+            default :
+                return 0;
+            }
+        }
+    case AST_EXP_BINARY_KIND :
+        {
+            int folded_right = 0;
+
+            folded = ssc_integer_constant(exp->u.ast_binary_exp.left, &l);
+            folded_right = ssc_integer_constant(exp->u.ast_binary_exp.right, &r);
+
+            if (folded == 0 || folded_right == 0)
+            {
+                return 0;
+            }
+
+            if (folded < 0 || folded_right < 0)
+            {
+                return -1;
+            }
+
+            switch (exp->u.ast_binary_exp.op)
+            {
+            case AST_OP_ADD :
+                *value = l + r;
+                return 1;
+            case AST_OP_SUB :
+                *value = l - r;
+                return 1;
+            case AST_OP_MUL :
+                *value = l * r;
+                return 1;
+            case AST_OP_BIT_AND :
+                *value = l & r;
+                return 1;
+            case AST_OP_BIT_OR :
+                *value = l | r;
+                return 1;
+            case AST_OP_BIT_XOR :
+                *value = l ^ r;
+                return 1;
+            case AST_OP_LESS :
+                *value = l < r;
+                return 1;
+            case AST_OP_LESS_EQ :
+                *value = l <= r;
+                return 1;
+            case AST_OP_GREAT :
+                *value = l > r;
+                return 1;
+            case AST_OP_GREAT_EQ :
+                *value = l >= r;
+                return 1;
+            case AST_OP_EQUAL :
+                *value = l == r;
+                return 1;
+            case AST_OP_UNEQUAL :
+                *value = l != r;
+                return 1;
+            case AST_OP_AND :
+                *value = l && r;
+                return 1;
+            case AST_OP_OR :
+                *value = l || r;
+                return 1;
+            case AST_OP_DIV :
+            case AST_OP_MOD :
+                {
+                    if (r == 0)
+                    {
+                        return 0;
+                    }
+
+                    *value = exp->u.ast_binary_exp.op == AST_OP_DIV ? l / r : l % r;
+                    return 1;
+                }
+            case AST_OP_LSHIFT :
+            case AST_OP_RSHIFT :
+                {
+                    if (r < 0 || r >= (long)sizeof(long) * 8)
+                    {
+                        return 0;
+                    }
+
+                    *value = exp->u.ast_binary_exp.op == AST_OP_LSHIFT ? l << r : l >> r;
+                    return 1;
+                }
+            default :
+                /* assignment operators */
+                return 0;
+            }
+        }
+    case AST_EXP_CONDITION_KIND :
+        {
+            folded = ssc_integer_constant(exp->u.ast_conditional_exp.cond_exp, &l);
+
+            if (folded <= 0)
+            {
+                return folded;
+            }
+
+            return ssc_integer_constant(l ? exp->u.ast_conditional_exp.true_exp : exp->u.ast_conditional_exp.false_exp, value);
+        }
+    case AST_EXP_SIZEOF_KIND :
+        {
+            t_type* type = NULL;
+
+            if (exp->u.ast_sizeof_exp.type)
+            {
+                type = ssc_type_name(exp->u.ast_sizeof_exp.type);
+            }
+
+            /* incomplete records have no size yet, -1 is an unknown size */
+            if (!type || type->size <= 0)
+            {
+                return -1;
+            }
+
+            *value = type->size;
+            return 1;
+        }
+    case AST_EXP_CAST_KIND :
+        return -1;
+    default :
+        return 0;
+    }
+}
+
+static t_type* ssc_type_name(t_ast_type_name* type_name)
+{
+    t_ast_abstract_declarator* declarator = type_name->abstract_declarator;
+    t_type* type = NULL;
+
+    ssc_declaration_specifiers(type_name->specifier_qualifier_list);
+    type = type_name->specifier_qualifier_list->type ? type_name->specifier_qualifier_list->type : type_int;
+
+    if (!declarator)
+    {
+        return type;
+    }
+
+    /* [TODO] abstract declarators other than pointers */
+    if (!declarator->pointer || declarator->direct_abstract_declarator)
+    {
+        return NULL;
+    }
+
+    if (declarator->suffix_list && !HCC_AST_LIST_IS_END(declarator->suffix_list))
+    {
+        return NULL;
+    }
+
+    return ssc_finalize_type(type, ssc_pointer(declarator->pointer));
+}
+
 static t_type* ssc_enum_specifier(t_ast_enum_specifier* enum_specifier)
 {
     t_type* type = NULL;
 	t_ast_list* enumerator_list = NULL;
 	int value = 0;
+	int known = 1;
     
     assert(enum_specifier && (enum_specifier->id || enum_specifier->enumerator_list));
     
@@ -959,13 +1350,13 @@ static t_type* ssc_enum_specifier(t_ast_enum_specifier* enum_specifier)
 	assert(enumerator_list);
 	while (!HCC_AST_LIST_IS_END(enumerator_list))
 	{
-		value = ssc_enumerator((t_ast_enumerator*)enumerator_list->item, value, type, enum_specifier->scope + 1);
+		value = ssc_enumerator((t_ast_enumerator*)enumerator_list->item, value, &known, type, enum_specifier->scope + 1);
 		enumerator_list = enumerator_list->next;
 	}
     return type;
 }
 
-static int ssc_enumerator(t_ast_enumerator* enumerator, int value, t_type* type, int scope)
+static int ssc_enumerator(t_ast_enumerator* enumerator, int value, int* known, t_type* type, int scope)
 {
 	t_symbol* sym = find_symbol(enumerator->id, sym_table_identifiers);
 	if (sym && sym->scope == scope)
@@ -980,29 +1371,32 @@ static int ssc_enumerator(t_ast_enumerator* enumerator, int value, t_type* type,
 		sym->value.i = value;
 		sym->storage = TK_ENUM;
 		sym->type = type;
-		sym->defined = 1;
+		sym->defined = *known;
 		HCC_ASSIGN_COORDINATE(sym, enumerator);
 
 		return ++ value;
 	}
 	else
 	{
-		enumerator->exp = ssc_const_expression(enumerator->exp);
+		long n = 0;
+		int folded = ssc_integer_constant(enumerator->exp, &n);
 
-		if ( !enumerator->exp )
+		if (!folded)
 		{
 			semantic_error("enumerator must be constant expression", &enumerator->coord);
 			return value;
 		}
 
+		*known = folded > 0;
+
 		sym = add_symbol(enumerator->id, &sym_table_identifiers, scope, PERM);
-		sym->value.i = value; // TODO - expression.value
+		sym->value.i = (int)n;
 		sym->storage = TK_ENUM;
 		sym->type = type;
-		sym->defined = 1;
+		sym->defined = *known;
 		HCC_ASSIGN_COORDINATE(sym, enumerator);
 
-		return value; // TODO - expression.value
+		return (int)n + 1;
 	}
 }
 
@@ -1036,6 +1430,12 @@ t_type* ssc_finalize_type(t_type* base_type, t_ast_list* reverse_type_list)
                 base_type = pointer_type(base_type);
                 break;
             }
+        case TYPE_ARRARY :
+            {
+                /* size of the array type in reverse type list is number of elements */
+                base_type = make_array_type(base_type, type->size);
+                break;
+            }
         /* FIXME - add more case states here like Array type. And assert on reaching default case !*/
         default :
             break;
@@ -158,6 +158,48 @@ static t_ast_exp* ssc_postfix_expression(t_ast_exp* exp)
 				semantic_error("subscript expression type error", &exp->coord);
 			}
 
+			break;
+		}
+	case AST_EXP_INDIR_KIND :
+		{
+			t_ast_exp* main_exp = ssc_expression(exp->u.ast_indir_exp.exp);
+			t_type* type = NULL;
+			t_record_field* field = NULL;
+
+			assert(main_exp);
+
+			if (exp->u.ast_indir_exp.op == AST_OP_PTR)
+			{
+				main_exp = ssc_implicit_conversion(main_exp, 1);
+				type = IS_PTR_TYPE(main_exp->type) ? UNQUALIFY_TYPE(main_exp->type)->link : NULL;
+			}
+			else
+			{
+				assert(exp->u.ast_indir_exp.op == AST_OP_DOT);
+				type = main_exp->type;
+			}
+
+			exp->u.ast_indir_exp.exp = main_exp;
+
+			if (type == NULL || !IS_RECORD_TYPE(type))
+			{
+				/* identifiers don't carry their declared types, so an operand of unknown type is not checked */
+				break;
+			}
+
+			/* large records resolve the member through their field index */
+			field = find_field(UNQUALIFY_TYPE(type), exp->u.ast_indir_exp.id);
+
+			if (field == NULL)
+			{
+				semantic_error("struct or union has no such member", &exp->coord);
+				break;
+			}
+
+			exp->type = field->type;
+			exp->has_lvalue = (exp->u.ast_indir_exp.op == AST_OP_PTR) || main_exp->has_lvalue;
+
+			break;
 		}
 	default:
 		break;
@@ -0,0 +1,203 @@
+/***************************************************************
+
+Copyright (c) 2008-2010 Michael Liang Han
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+#include <stdlib.h>
+
+#include "thread.h"
+
+/*
+ * thread.c is kept apart from the rest of the compiler so that platform headers
+ * (windows.h in particular) don't clash with the lexer and preprocessor names.
+ */
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+typedef struct thread
+{
+    HANDLE handle;
+    t_thread_proc proc;
+    void* arg;
+} t_thread;
+
+static DWORD WINAPI thread_entry(LPVOID p)
+{
+    t_thread* thread = (t_thread*)p;
+
+    thread->proc(thread->arg);
+
+    return 0;
+}
+
+void* hcc_thread_start(t_thread_proc proc, void* arg)
+{
+    t_thread* thread = (t_thread*)malloc(sizeof(t_thread));
+
+    if (!thread)
+    {
+        return NULL;
+    }
+
+    thread->proc = proc;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, thread_entry, thread, 0, NULL);
+
+    if (!thread->handle)
+    {
+        free(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+void hcc_thread_join(void* p)
+{
+    t_thread* thread = (t_thread*)p;
+
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    free(thread);
+}
+
+void hcc_thread_yield()
+{
+    SwitchToThread();
+}
+
+unsigned long hcc_atomic_load(volatile unsigned long* p)
+{
+    unsigned long value = *p;
+
+    MemoryBarrier();
+
+    return value;
+}
+
+void hcc_atomic_store(volatile unsigned long* p, unsigned long value)
+{
+    MemoryBarrier();
+
+    *p = value;
+}
+
+#elif defined(__unix__) || defined(__APPLE__)
+
+#include <pthread.h>
+#include <sched.h>
+
+typedef struct thread
+{
+    pthread_t handle;
+    t_thread_proc proc;
+    void* arg;
+} t_thread;
+
+static void* thread_entry(void* p)
+{
+    t_thread* thread = (t_thread*)p;
+
+    thread->proc(thread->arg);
+
+    return NULL;
+}
+
+void* hcc_thread_start(t_thread_proc proc, void* arg)
+{
+    t_thread* thread = (t_thread*)malloc(sizeof(t_thread));
+
+    if (!thread)
+    {
+        return NULL;
+    }
+
+    thread->proc = proc;
+    thread->arg = arg;
+
+    if (pthread_create(&thread->handle, NULL, thread_entry, thread) != 0)
+    {
+        free(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+void hcc_thread_join(void* p)
+{
+    t_thread* thread = (t_thread*)p;
+
+    pthread_join(thread->handle, NULL);
+    free(thread);
+}
+
+void hcc_thread_yield()
+{
+    sched_yield();
+}
+
+unsigned long hcc_atomic_load(volatile unsigned long* p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void hcc_atomic_store(volatile unsigned long* p, unsigned long value)
+{
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+#else
+
+void* hcc_thread_start(t_thread_proc proc, void* arg)
+{
+    (void)proc;
+    (void)arg;
+
+    return NULL;
+}
+
+void hcc_thread_join(void* thread)
+{
+    (void)thread;
+}
+
+void hcc_thread_yield()
+{
+}
+
+unsigned long hcc_atomic_load(volatile unsigned long* p)
+{
+    return *p;
+}
+
+void hcc_atomic_store(volatile unsigned long* p, unsigned long value)
+{
+    *p = value;
+}
+
+#endif
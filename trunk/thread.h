@@ -0,0 +1,56 @@
+/***************************************************************
+
+Copyright (c) 2008-2010 Michael Liang Han
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+#ifndef __HCC_THREAD_H
+#define __HCC_THREAD_H
+
+/*
+ * minimal thread support (win32 threads or pthreads) for the pipelined lexer.
+ * on platforms without either, hcc_thread_start fails and callers fall back to
+ * running the work synchronously.
+ */
+
+typedef void (*t_thread_proc)(void* arg);
+
+/* start a thread running proc(arg); returns NULL if no thread could be started */
+void* hcc_thread_start(t_thread_proc proc, void* arg);
+
+/* wait for a thread started by hcc_thread_start to finish and release it */
+void hcc_thread_join(void* thread);
+
+/* give up the rest of the time slice of calling thread */
+void hcc_thread_yield();
+
+/*
+ * shared indexes of lock free queues: a load with acquire semantics (memory accesses after it
+ * are not moved before it), and a store with release semantics (memory accesses before it are
+ * not moved after it)
+ */
+unsigned long hcc_atomic_load(volatile unsigned long* p);
+void hcc_atomic_store(volatile unsigned long* p, unsigned long value);
+
+#endif
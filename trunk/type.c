@@ -25,6 +25,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 
 ****************************************************************/
 #include <assert.h>
+#include <string.h>
 
 #include "hcc.h"
 #include "type.h"
@@ -35,6 +36,12 @@ OTHER DEALINGS IN THE SOFTWARE.
 
 #define __HCC_TYPE_TABLE_HASHSIZE 512
 
+/* records with more named fields than this get a field index */
+#define __HCC_FIELD_INDEX_THRESHOLD 16
+
+/* field names are atoms so the address identifies the name */
+#define __HCC_FIELD_HASH(name, size) ((((unsigned long)(name) >> 3) * 2654435761UL) & ((size) - 1))
+
 static int type_system_initialized = 0;
 
 /*
@@ -66,6 +73,16 @@ t_type* type_void;
 t_type* type_int64;
 t_type* type_unsigned_int64;
 
+/*
+ * usual arithmetic conversion and default argument promotion tables, indexed by type code
+ * built from the sizes of the target data model when type system is initialized.
+ * NULL entries are non arithmetic types (for conversion) or types not promoted (for promotion).
+ */
+#define __HCC_ARITH_CODES (TYPE_UNSIGNED_INT64 + 1)
+
+static t_type* conversion_table[__HCC_ARITH_CODES][__HCC_ARITH_CODES];
+static t_type* promotion_table[__HCC_ARITH_CODES];
+
 static t_type* atomic_type(t_type* type, int code, int align, int size, t_symbol* symbol_link)
 {
 	struct type_entry* p;
@@ -74,12 +91,13 @@ static t_type* atomic_type(t_type* type, int code, int align, int size, t_symbol
     */
 	unsigned long h = (code^((unsigned long)type>>3))& (__HCC_TYPE_TABLE_HASHSIZE - 1);
 
-	assert(code >= 0 && align >= 0 && size >= 0);
+	assert(code >= 0 && align >= 0 && (size >= 0 || (code == TYPE_ARRARY && size == -1)));
 
 	/*
 	 * Here function and zero sized (incomplete) array
 	 * can't be identified simply by code, align, size, and sub type.
 	 * So for function and incomplete array always allocate new type for them.
+	 * Neither can an array of unknown size.
 	 */
 	if (code != TYPE_FUNCTION && (code != TYPE_ARRARY || size > 0))
 	{
@@ -122,6 +140,185 @@ static t_type* install_type_symbol(int code, char*name, int size, int align)
 }
 
 
+/*
+ * integer conversion rank: char < short < int < long < long long (int64 ranks as long long)
+ * floating types rank above all integer types
+ */
+static int conversion_rank(int code)
+{
+    switch (code)
+    {
+    case TYPE_CHAR :
+    case TYPE_SIGNED_CHAR :
+    case TYPE_UNSIGNED_CHAR :
+        return 1;
+    case TYPE_SHORT :
+    case TYPE_UNSIGNED_SHORT :
+        return 2;
+    case TYPE_INT :
+    case TYPE_UNSIGNED_INT :
+    case TYPE_ENUM :
+        return 3;
+    case TYPE_LONG :
+    case TYPE_UNSIGNED_LONG :
+        return 4;
+    case TYPE_LONGLONG :
+    case TYPE_UNSIGNED_LONGLONG :
+    case TYPE_INT64 :
+    case TYPE_UNSIGNED_INT64 :
+        return 5;
+    case TYPE_FLOAT :
+        return 6;
+    case TYPE_DOUBLE :
+        return 7;
+    case TYPE_LONGDOUBLE :
+        return 8;
+    default :
+        return 0;
+    }
+}
+
+static int is_unsigned_code(int code)
+{
+    return code == TYPE_UNSIGNED_CHAR || code == TYPE_UNSIGNED_SHORT || code == TYPE_UNSIGNED_INT ||
+        code == TYPE_UNSIGNED_LONG || code == TYPE_UNSIGNED_LONGLONG || code == TYPE_UNSIGNED_INT64;
+}
+
+static t_type* unsigned_type(t_type* type)
+{
+    if (type == type_int) return type_unsigned_int;
+    if (type == type_long) return type_unsigned_long;
+    if (type == type_longlong) return type_unsigned_longlong;
+    if (type == type_int64) return type_unsigned_int64;
+
+    return type;
+}
+
+static t_type* type_of_code(int code)
+{
+    switch (code)
+    {
+    case TYPE_CHAR : return type_char;
+    case TYPE_SIGNED_CHAR : return type_signed_char;
+    case TYPE_UNSIGNED_CHAR : return type_unsigned_char;
+    case TYPE_SHORT : return type_short;
+    case TYPE_UNSIGNED_SHORT : return type_unsigned_short;
+    case TYPE_INT : return type_int;
+    case TYPE_UNSIGNED_INT : return type_unsigned_int;
+    case TYPE_ENUM : return type_int; /* enumerators have type int */
+    case TYPE_LONG : return type_long;
+    case TYPE_UNSIGNED_LONG : return type_unsigned_long;
+    case TYPE_LONGLONG : return type_longlong;
+    case TYPE_UNSIGNED_LONGLONG : return type_unsigned_longlong;
+    case TYPE_INT64 : return type_int64;
+    case TYPE_UNSIGNED_INT64 : return type_unsigned_int64;
+    case TYPE_FLOAT : return type_float;
+    case TYPE_DOUBLE : return type_double;
+    case TYPE_LONGDOUBLE : return type_longdouble;
+    default : return NULL;
+    }
+}
+
+/*
+ * integral promotion: types ranking below int become int if int can represent all their values,
+ * otherwise unsigned int
+ */
+static t_type* integral_promotion(t_type* type)
+{
+    if (conversion_rank(type->code) >= conversion_rank(TYPE_INT))
+    {
+        return type;
+    }
+
+    if (is_unsigned_code(type->code) && type->size >= type_int->size)
+    {
+        return type_unsigned_int;
+    }
+
+    return type_int;
+}
+
+static void build_conversion_tables()
+{
+    int i = 0, j = 0;
+
+    memset(conversion_table, 0, sizeof(conversion_table));
+    memset(promotion_table, 0, sizeof(promotion_table));
+
+    /* default argument promotion */
+    for (i = TYPE_CHAR; i <= TYPE_UNSIGNED_SHORT; i ++)
+    {
+        promotion_table[i] = integral_promotion(type_of_code(i));
+    }
+
+    promotion_table[TYPE_FLOAT] = type_double;
+
+    /* usual arithmetic conversion */
+    for (i = 0; i < __HCC_ARITH_CODES; i ++)
+    {
+        for (j = 0; j < __HCC_ARITH_CODES; j ++)
+        {
+            t_type* t1 = type_of_code(i);
+            t_type* t2 = type_of_code(j);
+            t_type* u = NULL; 
+            t_type* s = NULL;
+
+            if (!t1 || !t2)
+            {
+                continue;
+            }
+
+            /* floating types - the one with higher rank */
+            if (conversion_rank(t1->code) >= conversion_rank(TYPE_FLOAT) ||
+                conversion_rank(t2->code) >= conversion_rank(TYPE_FLOAT))
+            {
+                conversion_table[i][j] = conversion_rank(t1->code) >= conversion_rank(t2->code) ? t1 : t2;
+                continue;
+            }
+
+            t1 = integral_promotion(t1);
+            t2 = integral_promotion(t2);
+
+            if (t1 == t2)
+            {
+                conversion_table[i][j] = t1;
+            }
+            else if (is_unsigned_code(t1->code) == is_unsigned_code(t2->code))
+            {
+                /* same signedness - the one with higher rank; long long wins over int64 */
+                if (conversion_rank(t1->code) != conversion_rank(t2->code))
+                {
+                    conversion_table[i][j] = conversion_rank(t1->code) > conversion_rank(t2->code) ? t1 : t2;
+                }
+                else
+                {
+                    conversion_table[i][j] = is_unsigned_code(t1->code) ? type_unsigned_longlong : type_longlong;
+                }
+            }
+            else
+            {
+                u = is_unsigned_code(t1->code) ? t1 : t2;
+                s = is_unsigned_code(t1->code) ? t2 : t1;
+
+                if (conversion_rank(u->code) >= conversion_rank(s->code))
+                {
+                    conversion_table[i][j] = u;
+                }
+                else if (s->size > u->size)
+                {
+                    /* signed type can represent all values of the unsigned type */
+                    conversion_table[i][j] = s;
+                }
+                else
+                {
+                    conversion_table[i][j] = unsigned_type(s);
+                }
+            }
+        }
+    }
+}
+
+
 void type_system_initialize()
 {
     if (type_system_initialized) return;
@@ -162,6 +359,8 @@ void type_system_initialize()
     type_int64 = install_type_symbol(TYPE_INT64, atom_string("int64"), HCC_LONGLONG_SIZE, HCC_LONGLONG_SIZE);
     type_unsigned_int64 = install_type_symbol(TYPE_UNSIGNED_INT64, atom_string("unsigned int64"), HCC_LONGLONG_SIZE, HCC_LONGLONG_SIZE);
 
+    build_conversion_tables();
+
     type_system_initialized = 1;
 }
 
@@ -229,7 +428,7 @@ t_type* dereference_type(t_type* type)
 t_type* make_array_type(t_type* type, int size)
 {
 	assert(type != NULL);
-	assert(size >= 0);
+	assert(size >= -1);
 	
 	if (IS_FUNCTION_TYPE(type))
 	{
@@ -243,12 +442,18 @@ t_type* make_array_type(t_type* type, int size)
 		return NULL;
 	}
 
-	if (INT_MAX/type->size < size)
+	if (type->size > 0 && INT_MAX/type->size < size)
 	{
 		type_error("illegal array type : too many elements");
 		return NULL;
 	}
 
+	if (size < 0 || type->size < 0)
+	{
+		/* unknown number of elements or element size */
+		return atomic_type(type, TYPE_ARRARY, type->align, -1, NULL);
+	}
+
 	return atomic_type(type, TYPE_ARRARY, type->align, size * type->size, NULL); // array type has no symbolic link to symbol table
 }
 
@@ -381,33 +586,269 @@ t_type* make_record_type(t_type_kind kind, char* tag, int scope)
 }
 
 
+/*
+ * put a named field in the index of a record; the fields of an anonymous member are put instead of the member
+ */
+static void index_field(t_tag* tag, t_record_field* field)
+{
+    t_record_field* member = NULL;
+    unsigned long h = 0;
+
+    if (IS_ANONYMOUS_MEMBER(field))
+    {
+        for (member = UNQUALIFY_TYPE(field->type)->u.tag->fields; member; member = member->next)
+        {
+            index_field(tag, member);
+        }
+
+        return;
+    }
+
+    if (!field->name)
+    {
+        return;
+    }
+
+    for (h = __HCC_FIELD_HASH(field->name, tag->field_index_size); tag->field_index[h]; h = (h + 1) & (tag->field_index_size - 1))
+    {
+        ;
+    }
+
+    tag->field_index[h] = field;
+}
+
+/*
+ * (re)build the index of a large record with twice as many slots as named fields, so the table
+ * stays at most half full and a probe sequence is short
+ */
+static void build_field_index(t_tag* tag)
+{
+    t_record_field* field = NULL;
+    int size = 1;
+
+    while (size < tag->field_count * 2)
+    {
+        size <<= 1;
+    }
+
+    tag->field_index = hcc_alloc(size * sizeof(t_record_field*), PERM);
+    memset(tag->field_index, 0, size * sizeof(t_record_field*));
+    tag->field_index_size = size;
+
+    for (field = tag->fields; field; field = field->next)
+    {
+        index_field(tag, field);
+    }
+}
+
+/*
+ * report the fields of an anonymous member whose names are already taken in the enclosing record
+ */
+static void check_member_names(t_type* record_type, t_record_field* fields)
+{
+    t_record_field* field = NULL;
+
+    for (field = fields; field; field = field->next)
+    {
+        if (IS_ANONYMOUS_MEMBER(field))
+        {
+            check_member_names(record_type, UNQUALIFY_TYPE(field->type)->u.tag->fields);
+        }
+        else if (field->name && find_field(record_type, field->name))
+        {
+            type_error("duplicate field name");
+        }
+    }
+}
+
 t_record_field* make_field_type(t_type* field_type, char* name, t_type* record_type)
 {
+    t_tag* tag = NULL;
     t_record_field* current = NULL;
-    t_record_field** next = NULL;
 
-    /* [TODO] - support unnamed bit field ; at this moment field requires a name */
-    assert(field_type != NULL && name != NULL && record_type != NULL);
+    /* name is NULL for unnamed bit field */
+    assert(field_type != NULL && record_type != NULL);
 
-	next = &record_type->u.tag->fields;
-    current = *next;
+    tag = record_type->u.tag;
 
-    for (; current; next = &current->next, current = *next)
+    /* a large record looks the name up through its index */
+    if (name && find_field(record_type, name))
     {
-        if (current->name == name) type_error("duplicate field name");
+        type_error("duplicate field name");
     }
 
 	CALLOC(current, PERM);
     current->name = name;
     current->type = field_type;
     current->bits = 0;
+    current->bit_offset = 0;
     current->offset = 0;
     current->next = NULL;
 
+    if (IS_ANONYMOUS_MEMBER(current))
+    {
+        check_member_names(record_type, UNQUALIFY_TYPE(field_type)->u.tag->fields);
+        tag->field_count += UNQUALIFY_TYPE(field_type)->u.tag->field_count;
+    }
+    else if (name)
+    {
+        tag->field_count ++;
+    }
+
+    /* fields are kept in declaration order */
+    if (tag->last_field)
+    {
+        tag->last_field->next = current;
+    }
+    else
+    {
+        tag->fields = current;
+    }
+
+    tag->last_field = current;
+
+    if (tag->field_count > __HCC_FIELD_INDEX_THRESHOLD)
+    {
+        if (tag->field_count * 2 > tag->field_index_size)
+        {
+            build_field_index(tag);
+        }
+        else
+        {
+            index_field(tag, current);
+        }
+    }
+
     return current;
 }
 
 
+void layout_record_type(t_type* record_type)
+{
+    t_record_field* field = NULL;
+    int bits = 0; /* bits allocated so far (struct) */
+    int size = 0; /* largest member (union) */
+    int align = 1;
+    int unknown = 0; /* some field has unknown size or width */
+
+    assert(record_type != NULL && record_type->u.tag != NULL &&
+        (record_type->code == TYPE_STRUCT || record_type->code == TYPE_UNION));
+
+    for (field = record_type->u.tag->fields; field; field = field->next)
+    {
+        int field_align = field->type->align > 0 ? field->type->align : 1;
+        int unit = field->type->size * 8; /* bits of the field's storage unit */
+
+        if (field->type->size == 0 && !IS_ARRAY_TYPE(field->type))
+        {
+            type_error("field has incomplete type");
+        }
+
+        if (field->type->size < 0 || field->bits < 0)
+        {
+            /* size of the field depends on an expression which is not folded */
+            unknown = 1;
+        }
+        else if (record_type->code == TYPE_UNION)
+        {
+            field->offset = 0;
+            field->bit_offset = 0;
+
+            if (size < field->type->size)
+            {
+                size = field->type->size;
+            }
+        }
+        else if (field->bits > 0 || (field->name == NULL && !IS_ANONYMOUS_MEMBER(field)))
+        {
+            /*
+             * bit fields are packed into storage units of their declared type; a bit field
+             * never straddles the boundary of its unit, and an unnamed zero width bit field
+             * closes the current unit.
+             */
+            assert(unit > 0);
+
+            if (field->bits == 0 || (bits % unit) + field->bits > unit)
+            {
+                bits = ROUNDUP(bits, unit);
+            }
+
+            field->offset = (bits / unit) * field->type->size;
+            field->bit_offset = bits - field->offset * 8;
+            bits += field->bits;
+        }
+        else
+        {
+            bits = ROUNDUP(bits, field_align * 8);
+            field->offset = bits / 8;
+            field->bit_offset = 0;
+            bits += field->type->size * 8;
+        }
+
+        /* unnamed bit fields don't affect alignment of the record */
+        if ((field->name || IS_ANONYMOUS_MEMBER(field)) && align < field_align)
+        {
+            align = field_align;
+        }
+    }
+
+    if (record_type->code == TYPE_STRUCT)
+    {
+        size = ROUNDUP(bits, 8) / 8;
+    }
+
+    record_type->align = align;
+    record_type->size = unknown ? -1 : ROUNDUP(size, align);
+}
+
+
+t_record_field* find_field(t_type* record_type, char* name)
+{
+    t_tag* tag = NULL;
+    t_record_field* field = NULL;
+
+    assert(record_type != NULL && name != NULL);
+    assert(record_type->code == TYPE_STRUCT || record_type->code == TYPE_UNION);
+
+    tag = record_type->u.tag;
+
+    if (tag->field_index)
+    {
+        unsigned long h = __HCC_FIELD_HASH(name, tag->field_index_size);
+
+        for (; (field = tag->field_index[h]) != NULL; h = (h + 1) & (tag->field_index_size - 1))
+        {
+            if (field->name == name)
+            {
+                return field;
+            }
+        }
+
+        return NULL;
+    }
+
+    for (field = tag->fields; field; field = field->next)
+    {
+        if (field->name == name)
+        {
+            return field;
+        }
+
+        if (IS_ANONYMOUS_MEMBER(field))
+        {
+            t_record_field* member = find_field(UNQUALIFY_TYPE(field->type), name);
+
+            if (member)
+            {
+                return member;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
 static int is_compatible_function(t_type* type1, t_type* type2)
 {
     t_param* p1 = NULL;
@@ -518,14 +959,11 @@ int is_compatible_type(t_type* type1, t_type* type2)
 t_type* promote_type(t_type* type)
 {
     assert(type != NULL);
-    
-    if (type->code <= TYPE_UNSIGNED_SHORT)
-    {
-        return type_int;
-    }
-    else if (type->code == TYPE_FLOAT)
+    assert(type->code >= 0);
+
+    if (type->code < __HCC_ARITH_CODES && promotion_table[type->code])
     {
-        return type_double;
+        return promotion_table[type->code];
     }
 
     return type;
@@ -681,47 +1119,17 @@ t_type* composite_type(t_type* type1, t_type* type2)
 */
 t_type* arithmetic_conversion(t_type* t1, t_type* t2)
 {
-	assert( t1 && t2);
-
-	if (IS_LONGDOUBLE_TYPE(t1) || IS_LONGDOUBLE_TYPE(t2))
-	{
-		return type_longdouble;
-	}
+	t_type* type = NULL;
 
-	if (IS_DOUBLE_TYPE(t1) || IS_DOUBLE_TYPE(t2))
-	{
-		return type_double;
-	}
-
-	if (IS_FLOAT_TYPE(t1) || IS_FLOAT_TYPE(t2))
-	{
-		return type_float;
-	}
+	assert( t1 && t2);
 
-	if (IS_UNSIGNED_LONGLONG_TYPE(t1) || IS_UNSIGNED_LONGLONG_TYPE(t2))
-	{
-		return type_unsigned_longlong;
-	}
+	t1 = UNQUALIFY_TYPE(t1);
+	t2 = UNQUALIFY_TYPE(t2);
 
-	if (IS_LONGLONG_TYPE(t1) || IS_LONGLONG_TYPE(t2))
-	{
-		return type_longlong;
-	}
+	assert(t1->code >= 0 && t1->code < __HCC_ARITH_CODES && t2->code >= 0 && t2->code < __HCC_ARITH_CODES);
 
-	if (IS_UNSIGNED_LONG_TYPE(t1) || IS_UNSIGNED_LONG_TYPE(t2))
-	{
-		return type_unsigned_long;
-	}
-
-	if (IS_LONG_TYPE(t1) || IS_LONG_TYPE(t2))
-	{
-		return type_long;
-	}
-
-	if (IS_UNSIGNED_INT_TYPE(t1) || IS_UNSIGNED_INT_TYPE(t2))
-	{
-		return type_unsigned_int;
-	}
+	type = conversion_table[t1->code][t2->code];
 
-	return type_int;
+	/* non arithmetic operands - semantic check reports the error */
+	return type ? type : type_int;
 }
\ No newline at end of file
@@ -72,7 +72,7 @@ typedef struct type
 {
 	int code; /* type code */
 	int align; /* type alignment */
-	int size; /* type size */
+	int size; /* type size; -1 if it depends on an expression the checker can't fold (sizeof, cast) */
 
 	/* link to other types - for example unsigned long 
 	 * where unsigned in type and long is type->link
@@ -106,7 +106,8 @@ typedef struct field_type
 {
 	char* name; /* field name */
 	int offset; /* field offset relative to start of the record */
-	int bits; /* number of bits if the field is a bit field; otherwise 0 by default */
+	int bits; /* number of bits if the field is a bit field; otherwise 0 by default; -1 if the width is unknown */
+	int bit_offset; /* bit position inside the storage unit at offset if the field is a bit field */
 	t_type* type; /* field type */
 	struct field_type* next; /* link to next field in the same record */
 } t_record_field;
@@ -119,6 +120,16 @@ typedef struct tag_trait
 {
 	char* tag; 
 	t_record_field* fields; 
+
+	t_record_field* last_field; /* fields are appended in declaration order */
+	int field_count; /* named fields, those of anonymous members included */
+
+	/*
+	 * open addressing index from field name to field, built once a record has many fields and kept
+	 * up to date as fields are added; NULL for small records which are searched through the fields list
+	 */
+	t_record_field** field_index;
+	int field_index_size; /* power of 2 */
 } t_tag;
 
 /*
@@ -210,6 +221,15 @@ t_type* remove_type_qualifier(t_type* type);
 
 #define IS_ENUM_TYPE(t) (UNQUALIFY_TYPE(t)->code == TYPE_ENUM)
 
+/* a record declared without tag is named by a generated number */
+#define IS_ANONYMOUS_TAG(tag) ((tag)[0] >= '0' && (tag)[0] <= '9')
+
+/*
+ * anonymous struct / union member - an unnamed field of record type (C11, and a common extension before);
+ * its fields are members of the enclosing record, placed at the offset of the anonymous member
+ */
+#define IS_ANONYMOUS_MEMBER(f) ((f)->name == NULL && (f)->bits == 0 && IS_RECORD_TYPE((f)->type))
+
 #define IS_VOID_TYPE(t) (UNQUALIFY_TYPE(type)->code == TYPE_VOID)
 
 #define IS_SCALAR_TYPE(t) (UNQUALIFY_TYPE(type)->code <= TYPE_PTR)
@@ -254,6 +274,7 @@ t_type* dereference_type(t_type* type);
 
 /*
  * construct an array type with specified element type and array size
+ * size is -1 if the number of elements is unknown
  */
 t_type* make_array_type(t_type* type, int size);
 
@@ -283,9 +304,23 @@ t_type* make_record_type(t_type_kind kind, char* tag, int scope);
 
 /*
  * construct a field type and associate it with specified record type
+ * name could be NULL for unnamed bit fields
  */
 t_record_field* make_field_type(t_type* field_type, char* name, t_type* record_type);
 
+/*
+ * lay out a struct / union once all its fields are constructed
+ * assign field offsets (and bit positions of bit fields) and calculate size and alignment of the record
+ * the record size is -1 if a field has unknown size or width; its field offsets are not meaningful then
+ */
+void layout_record_type(t_type* record_type);
+
+/*
+ * find a field by name (an atom) in a struct / union; return NULL if the record has no such field
+ * a field of an anonymous member is found too; its offset is relative to the anonymous member
+ */
+t_record_field* find_field(t_type* record_type, char* name);
+
 /*
  * Check type compatibility
  *
@@ -330,6 +365,8 @@ int has_same_type_qualifier(t_type* type1, t_type* type2);
 /*
  * usual arithmetic converstion
  * calculate the result type based on two operator types (more operators can be recursively apply this)
+ * the result is looked up in a table built from the target type sizes at type system initialization,
+ * so that mixed signedness cases (e.g. long and unsigned int) follow the configured data model.
  * ANSI type conversion rules:
  *
  * (in the order of "precedence")
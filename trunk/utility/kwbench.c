@@ -0,0 +1,218 @@
+/***************************************************************
+
+Copyright (c) 2008-2010 Michael Liang Han
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/*
+ * kwbench - keyword recognition microbenchmark
+ *
+ * extracts the identifier stream of the given C sources and classifies it repeatedly with
+ * the former first-letter bucket search of keywords.h and with the generated perfect hash
+ * of keyhash.h, reporting the time per identifier of each.
+ *
+ *     gcc -O2 -I. -o kwbench utility/kwbench.c && ./kwbench test_files/jill.c torture/jillvalentine.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+enum TOKEN
+{
+#define TK(a, b) a,
+#include "tokendef.h"
+#undef TK
+};
+
+#include "keywords.h"
+#include "keyhash.h"
+
+#define KW_BENCH_ROUNDS 200
+
+static char** identifiers = NULL;
+static int number_of_identifiers = 0;
+static int capacity = 0;
+
+/*
+ * the keyword search the lexer used before the perfect hash was introduced
+ */
+static int bucket_lookup(char* id)
+{
+    tKW* p = NULL;
+    int index = 0;
+
+    if (*id == '_')
+    {
+        p = kwExt;
+    }
+    else
+    {
+        index = (*id &~0x20) - 'A';
+        if (index < 0 || index >= 26)
+        {
+            return TK_ID;
+        }
+
+        p = kw_table[index];
+    }
+
+    for (; p->name; p++)
+    {
+        if ((size_t)p->len == strlen(id) && strncmp(id, p->name, strlen(id)) == 0)
+        {
+            return p->token;
+        }
+    }
+
+    return TK_ID;
+}
+
+static void add_identifier(char* start, int length)
+{
+    if (number_of_identifiers == capacity)
+    {
+        capacity = capacity ? capacity * 2 : 1024;
+        identifiers = realloc(identifiers, capacity * sizeof(char*));
+    }
+
+    identifiers[number_of_identifiers] = malloc(length + 1);
+    memcpy(identifiers[number_of_identifiers], start, length);
+    identifiers[number_of_identifiers][length] = '\0';
+    number_of_identifiers ++;
+}
+
+static void scan_file(char* filename)
+{
+    FILE* file = fopen(filename, "rb");
+    char* buffer = NULL;
+    char* p = NULL;
+    long size = 0;
+
+    if (!file)
+    {
+        fprintf(stderr, "kwbench: cannot open %s\n", filename);
+        exit(1);
+    }
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    buffer = malloc(size + 1);
+    size = (long)fread(buffer, 1, size, file);
+    buffer[size] = '\0';
+    fclose(file);
+
+    for (p = buffer; *p; )
+    {
+        if (isalpha((unsigned char)*p) || *p == '_')
+        {
+            char* start = p;
+
+            while (isalnum((unsigned char)*p) || *p == '_')
+            {
+                p ++;
+            }
+
+            add_identifier(start, (int)(p - start));
+        }
+        else if (isdigit((unsigned char)*p))
+        {
+            while (isalnum((unsigned char)*p) || *p == '.')
+            {
+                p ++;
+            }
+        }
+        else
+        {
+            p ++;
+        }
+    }
+
+    free(buffer);
+}
+
+static double run(int (*lookup)(char*), long* keywords)
+{
+    clock_t start = clock();
+    int round = 0, i = 0;
+
+    *keywords = 0;
+
+    for (round = 0; round < KW_BENCH_ROUNDS; round ++)
+    {
+        for (i = 0; i < number_of_identifiers; i ++)
+        {
+            *keywords += lookup(identifiers[i]) != TK_ID;
+        }
+    }
+
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static int hash_lookup(char* id)
+{
+    return kw_lookup(id);
+}
+
+int main(int argc, char** argv)
+{
+    long bucket_keywords = 0, hash_keywords = 0;
+    double bucket_time = 0, hash_time = 0;
+    double count = 0;
+    int i = 0;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: kwbench file.c ...\n");
+        return 1;
+    }
+
+    for (i = 1; i < argc; i ++)
+    {
+        scan_file(argv[i]);
+    }
+
+    for (i = 0; i < number_of_identifiers; i ++)
+    {
+        if (bucket_lookup(identifiers[i]) != kw_lookup(identifiers[i]))
+        {
+            fprintf(stderr, "kwbench: mismatch on %s\n", identifiers[i]);
+            return 1;
+        }
+    }
+
+    bucket_time = run(bucket_lookup, &bucket_keywords);
+    hash_time = run(hash_lookup, &hash_keywords);
+    count = (double)number_of_identifiers * KW_BENCH_ROUNDS;
+
+    printf("identifiers: %d (%ld keywords) x %d rounds\n", number_of_identifiers, hash_keywords / KW_BENCH_ROUNDS, KW_BENCH_ROUNDS);
+    printf("bucket search: %.2f ns/identifier\n", bucket_time * 1e9 / count);
+    printf("perfect hash:  %.2f ns/identifier\n", hash_time * 1e9 / count);
+
+    return 0;
+}
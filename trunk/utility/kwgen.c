@@ -0,0 +1,226 @@
+/***************************************************************
+
+Copyright (c) 2008-2010 Michael Liang Han
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+/*
+ * kwgen - generate a perfect hash for keyword recognition
+ *
+ * reads the keyword list of keywords.h (letter buckets plus extension keywords) and
+ * searches association values for the hash
+ *
+ *     (length + asso[id[0]] + asso[id[1]] + asso[id[length - 1]]) & (KW_HASH_SIZE - 1)
+ *
+ * so that every keyword lands in its own slot. the result is written to stdout as
+ * keyhash.h, which the lexer includes. regenerate it whenever keywords.h changes:
+ *
+ *     gcc -I. -o kwgen utility/kwgen.c && ./kwgen > keyhash.h
+ *
+ * the search is seeded with a constant, so the output is reproducible.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum TOKEN
+{
+#define TK(a, b) a,
+#include "tokendef.h"
+#undef TK
+};
+
+static char* token_names[] =
+{
+#define TK(a, b) #a,
+#include "tokendef.h"
+#undef TK
+};
+
+#include "keywords.h"
+
+#define KW_MAX_KEYWORDS 64
+#define KW_MAX_ATTEMPTS 1000000
+
+static tKW* keywords[KW_MAX_KEYWORDS];
+static int number_of_keywords = 0;
+static int max_length = 0;
+
+static int asso[256];
+static int used[256];
+static tKW* slots[KW_MAX_KEYWORDS * 4];
+
+static unsigned long seed = 20100101UL;
+
+static int next_random(int range)
+{
+    seed = seed * 1103515245UL + 12345UL;
+    return (int)((seed >> 16) & 0x7fff) % range;
+}
+
+static void collect_keywords(tKW* bucket)
+{
+    tKW* p = bucket;
+
+    for (; p->name; p++)
+    {
+        if (number_of_keywords == KW_MAX_KEYWORDS)
+        {
+            fprintf(stderr, "kwgen: too many keywords\n");
+            exit(1);
+        }
+
+        keywords[number_of_keywords++] = p;
+
+        if (p->len > max_length)
+        {
+            max_length = p->len;
+        }
+
+        used[(unsigned char)p->name[0]] = 1;
+        used[(unsigned char)p->name[1]] = 1;
+        used[(unsigned char)p->name[p->len - 1]] = 1;
+    }
+}
+
+static int hash(tKW* p, int size)
+{
+    return (p->len + asso[(unsigned char)p->name[0]] + asso[(unsigned char)p->name[1]] +
+        asso[(unsigned char)p->name[p->len - 1]]) & (size - 1);
+}
+
+/*
+ * try random association values until all keywords hash to distinct slots
+ */
+static int search(int size)
+{
+    int attempt = 0, i = 0, collision = 0;
+
+    for (attempt = 0; attempt < KW_MAX_ATTEMPTS; attempt ++)
+    {
+        for (i = 0; i < 256; i ++)
+        {
+            asso[i] = used[i] ? next_random(size) : 0;
+        }
+
+        /* NUL terminates one letter identifiers, keep it neutral */
+        asso[0] = 0;
+
+        memset(slots, 0, sizeof(slots));
+        collision = 0;
+
+        for (i = 0; i < number_of_keywords && !collision; i ++)
+        {
+            int h = hash(keywords[i], size);
+
+            collision = slots[h] != NULL;
+            slots[h] = keywords[i];
+        }
+
+        if (!collision)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void emit(int size)
+{
+    int i = 0;
+
+    printf("/* generated by utility/kwgen.c from keywords.h - do not edit */\n\n");
+    printf("#ifndef __HCC_KEYHASH_H\n#define __HCC_KEYHASH_H\n\n");
+    printf("#include <string.h>\n\n");
+    printf("typedef struct keyword_slot\n{\n    char* name;\n    int len;\n    int token;\n} t_keyword_slot;\n\n");
+    printf("#define KW_MAX_LENGTH %d\n", max_length);
+    printf("#define KW_HASH_SIZE %d\n\n", size);
+
+    printf("static const unsigned char kw_asso[256] =\n{");
+    for (i = 0; i < 256; i ++)
+    {
+        printf("%s%3d%s", i % 16 ? " " : "\n    ", asso[i], i < 255 ? "," : "\n");
+    }
+    printf("};\n\n");
+
+    printf("static const t_keyword_slot kw_hash_table[KW_HASH_SIZE] =\n{\n");
+    for (i = 0; i < size; i ++)
+    {
+        if (slots[i])
+        {
+            printf("    {\"%s\", %d, %s},\n", slots[i]->name, slots[i]->len, token_names[slots[i]->token]);
+        }
+        else
+        {
+            printf("    {NULL, 0, TK_ID},\n");
+        }
+    }
+    printf("};\n\n");
+
+    printf("/*\n");
+    printf(" * map an identifier to its keyword token, or TK_ID\n");
+    printf(" * the length is measured only up to the longest keyword, so no strlen is needed\n");
+    printf(" */\n");
+    printf("static int kw_lookup(const char* id)\n{\n");
+    printf("    const t_keyword_slot* p = NULL;\n");
+    printf("    int len = 0;\n\n");
+    printf("    while (id[len])\n    {\n");
+    printf("        if (++len > KW_MAX_LENGTH)\n        {\n            return TK_ID;\n        }\n    }\n\n");
+    printf("    if (len == 0)\n    {\n        return TK_ID;\n    }\n\n");
+    printf("    p = &kw_hash_table[(len + kw_asso[(unsigned char)id[0]] + kw_asso[(unsigned char)id[1]] +\n");
+    printf("        kw_asso[(unsigned char)id[len - 1]]) & (KW_HASH_SIZE - 1)];\n\n");
+    printf("    if (p->len == len && p->name[0] == id[0] && memcmp(p->name, id, len) == 0)\n    {\n");
+    printf("        return p->token;\n    }\n\n");
+    printf("    return TK_ID;\n}\n\n");
+    printf("#endif\n");
+}
+
+int main()
+{
+    int i = 0, size = 0;
+
+    for (i = 0; i < sizeof(kw_table) / sizeof(kw_table[0]); i ++)
+    {
+        collect_keywords(kw_table[i]);
+    }
+
+    collect_keywords(kwExt);
+
+    /* smallest power of two table with load factor no more than one half */
+    for (size = 1; size < number_of_keywords * 2; size <<= 1);
+
+    for (; size <= KW_MAX_KEYWORDS * 4; size <<= 1)
+    {
+        if (search(size))
+        {
+            emit(size);
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "kwgen: no perfect hash found\n");
+    return 1;
+}
@@ -0,0 +1,214 @@
+/***************************************************************
+
+Copyright (c) 2008-2010 Michael Liang Han
+
+Permission is hereby granted, free of charge, to any person
+obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without
+restriction, including without limitation the rights to use,
+copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following
+conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+****************************************************************/
+
+
+/*
+ * macbench - macro table microbenchmark
+ *
+ * preprocesses the given C sources with ucpp, which fills the macro table with the
+ * definitions of the real headers they include, then looks up every identifier of those
+ * sources and headers with get_macro() repeatedly, as cpp() does for each NAME token,
+ * reporting the time per lookup.
+ *
+ *     make macbench && ./macbench -I/usr/include test_files/jill.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "preprocessor/ucppi.h"
+
+#define MAC_BENCH_ROUNDS 20
+
+static char** identifiers = NULL;
+static int number_of_identifiers = 0;
+static int capacity = 0;
+
+static void add_identifier(char* start, int length)
+{
+    if (number_of_identifiers == capacity)
+    {
+        capacity = capacity ? capacity * 2 : 1024;
+        identifiers = realloc(identifiers, capacity * sizeof(char*));
+    }
+
+    identifiers[number_of_identifiers] = malloc(length + 1);
+    memcpy(identifiers[number_of_identifiers], start, length);
+    identifiers[number_of_identifiers][length] = '\0';
+    number_of_identifiers ++;
+}
+
+/*
+ * collect the identifiers of a file, skipping over numbers
+ */
+static void scan_file(char* filename)
+{
+    FILE* file = fopen(filename, "rb");
+    char* buffer = NULL;
+    char* p = NULL;
+    long size = 0;
+
+    if (!file)
+    {
+        fprintf(stderr, "macbench: cannot open %s\n", filename);
+        exit(1);
+    }
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    buffer = malloc(size + 1);
+    size = (long)fread(buffer, 1, size, file);
+    buffer[size] = '\0';
+    fclose(file);
+
+    for (p = buffer; *p; )
+    {
+        if (isalpha((unsigned char)*p) || *p == '_')
+        {
+            char* start = p;
+
+            while (isalnum((unsigned char)*p) || *p == '_')
+            {
+                p ++;
+            }
+
+            add_identifier(start, (int)(p - start));
+        }
+        else if (isdigit((unsigned char)*p))
+        {
+            while (isalnum((unsigned char)*p) || *p == '.')
+            {
+                p ++;
+            }
+        }
+        else
+        {
+            p ++;
+        }
+    }
+
+    free(buffer);
+}
+
+/*
+ * run ucpp over a file; the macro table keeps its definitions, and the names of the
+ * included files are written to the dependency stream.
+ */
+static void preprocess(char* filename)
+{
+    struct lexer_state ls;
+
+    set_init_filename(filename, 1);
+    init_lexer_state(&ls);
+    init_lexer_mode(&ls);
+    ls.flags |= HANDLE_ASSERTIONS | HANDLE_PRAGMA | CPLUSPLUS_COMMENTS;
+    ls.input = fopen(filename, "r");
+    if (!ls.input)
+    {
+        fprintf(stderr, "macbench: cannot open %s\n", filename);
+        exit(1);
+    }
+
+    while (lex(&ls) < CPPERR_EOF)
+    {
+    }
+
+    free_lexer_state(&ls);
+}
+
+int main(int argc, char** argv)
+{
+    FILE* dependencies = tmpfile();
+    char name[4096];
+    long found = 0;
+    double elapsed = 0, count = 0;
+    clock_t start;
+    int round = 0, i = 0, files = 0;
+
+    if (argc < 2 || !dependencies)
+    {
+        fprintf(stderr, "usage: macbench [-Idir ...] file.c ...\n");
+        return 1;
+    }
+
+    init_cpp();
+    no_special_macros = 0;
+    emit_defines = emit_assertions = 0;
+    emit_dependencies = 2;
+    emit_output = dependencies;
+    init_tables(1);
+    init_include_path(0);
+
+    for (i = 1; i < argc; i ++)
+    {
+        if (strncmp(argv[i], "-I", 2) == 0)
+        {
+            add_incpath(argv[i] + 2);
+        }
+    }
+
+    for (i = 1; i < argc; i ++)
+    {
+        if (strncmp(argv[i], "-I", 2) != 0)
+        {
+            preprocess(argv[i]);
+            scan_file(argv[i]);
+            files ++;
+        }
+    }
+
+    rewind(dependencies);
+    while (fscanf(dependencies, "%4095s", name) == 1)
+    {
+        scan_file(name);
+        files ++;
+    }
+    fclose(dependencies);
+
+    start = clock();
+    for (round = 0; round < MAC_BENCH_ROUNDS; round ++)
+    {
+        for (i = 0; i < number_of_identifiers; i ++)
+        {
+            found += get_macro(identifiers[i]) != NULL;
+        }
+    }
+    elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+    count = (double)number_of_identifiers * MAC_BENCH_ROUNDS;
+
+    printf("files: %d, identifiers: %d (%ld macro hits) x %d rounds\n", files, number_of_identifiers, found / MAC_BENCH_ROUNDS, MAC_BENCH_ROUNDS);
+    printf("get_macro: %.2f ns/lookup\n", elapsed * 1e9 / count);
+    printf("lookups: %lu, ruled out by the name filter: %lu\n", macro_lookups, macro_lookups_filtered);
+
+    wipeout();
+    return 0;
+}